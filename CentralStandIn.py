@@ -0,0 +1,636 @@
+# Local stand-in for CENTRAL and a load generator for satellites (ESP32s or native builds).
+#
+# Speaks the satellite protocol: every message is null terminated, the satellite opens with a device_info message and
+# then sends state_update and event JSON. Commands go to the satellite as '\b' + JSON. OTA images go as binary frames
+# (0x0E, kind, uint32 length, raw payload), or with --ota-escaped as '\t' + escaped bytes like older CENTRALs did.
+# The binary begin frame carries the image size and SHA-256, the satellite answers with an "ota" message holding the
+# offset it has already written and the image is sent from there, so a transfer cut off (--ota-cut) resumes.
+# --ota-patch sends a delta patch (OtaDelta.py, frame kind 3) instead to satellites whose device_info image_sha256 is
+# the patch's base, and falls back to the --ota image if there is none or the satellite refuses or fails the patch.
+#
+# Each probe is a radiator_temp_update with a unique temperature followed by set_on(false), which always pushes an
+# exclusive state update. The probe is echoed when a state_update carries its temperature back, the time in between
+# is the command-to-state-echo latency. Probes without an echo within --timeout count as dropped. A probe is two
+# commands to one device, so above COMMAND_RATE_DEVICE / PROBE_COMMANDS probes/s the satellite's command limiter
+# rejects probes: with --acks they are counted as rejected, without they can't be told apart from dropped ones.
+#
+# With --acks every command carries a "req_id" and the satellite answers with an ack or nack (with an error code) once
+# it executed the command. At most cmd_window (from device_info) commands are kept in flight, probes that would go
+# over it are skipped and counted as throttled, as are the probes while backing off after a rate_limited nack (for the
+# nack's retry_ms).
+#
+# --subscribe device:fields:interval_ms[:change] (repeatable) subscribes to a device after the handshake, the fields
+# are separated by '+' (e.g. Radiator:state.radiator_temp:0:change), state updates then only carry the subscriptions.
+#
+# --rule id:source (repeatable) installs a local automation rule after the handshake and lists the rules, e.g.
+# --rule '1:MotionDetector.motion_detected if arg0 -> Radiator.set_on(true)'.
+#
+# Urgent events (motion, faults) may also arrive as UDP datagrams on --udp-port (default --port + 1): an 8 byte header
+# (magic 0xD6, type, name length, reserved, uint32 sequence), the satellite name and the JSON. Every DATA datagram is
+# acked with the same header, the JSON carries the sequence as "seq" so a copy retransmitted over TCP is dropped.
+#
+# Examples:
+#   python CentralStandIn.py --rate 3 --duration 30
+#   python CentralStandIn.py --satellites 4 --ramp 0.5:4:0.5 --step-duration 10 --acks --json results.json
+#   python CentralStandIn.py --ota .pio/build/nodemcu-32s2/firmware.bin
+#   python CentralStandIn.py --ota firmware.bin --ota-cut 500000 --serve
+#   python CentralStandIn.py --ota firmware.bin --ota-patch firmware.otad
+#   python CentralStandIn.py --rate 3 --duration 10 --trace trace.jsonl && python TraceConverter.py trace.jsonl
+
+import argparse
+import asyncio
+import collections
+import hashlib
+import json
+import math
+import struct
+import time
+
+import OtaDelta
+
+NULL_TERM_ESCAPE = 0x08
+NULL_TERM_REPLACE = 0x01
+NULL_TERM_ESCAPE_REPLACE = 0x02
+
+OTA_CHUNK_SIZE = 1000  # Unescaped bytes per escaped OTA message
+OTA_FRAME = 0x0E
+OTA_FRAME_HEADER = struct.Struct('<BBI')  # OTA_FRAME, kind, payload length
+OTA_FRAME_BEGIN = 1
+OTA_FRAME_DATA = 2
+OTA_FRAME_PATCH = 3
+OTA_FRAME_CHUNK = 64 * 1024  # Payload per binary frame, the satellite streams it into its flash buffers
+OTA_BEGIN_TIMEOUT = 10.0  # (s) For the satellite to answer a begin frame with its offset
+HEARTBEAT_INTERVAL = 30  # (s)
+PROBE_TEMP_BASE = 60.0  # (F) Probe temperatures stay below the radiator's cooldown threshold
+PROBE_TEMP_SLOTS = 10000  # Probes are tagged PROBE_TEMP_BASE + (sequence % slots) / 1000
+PROBE_COMMANDS = 2  # radiator_temp_update and set_on, both to the radiator
+COMMAND_RATE_DEVICE = 8  # (commands/s) The satellite's per device limit (CommandLimiter.h)
+
+DATAGRAM_HEADER = struct.Struct('<BBBBI')
+DATAGRAM_MAGIC = 0xD6
+DATAGRAM_DATA = 1
+DATAGRAM_ACK = 2
+DATAGRAM_SEEN = 256  # Sequence numbers remembered per satellite for dropping duplicates
+
+
+def escape(data):
+    # Nulls would end the frame, so they are escaped like the satellite's UpdateHandler expects
+    escaped = bytearray()
+    for byte in data:
+        if byte == 0:
+            escaped += bytes([NULL_TERM_ESCAPE, NULL_TERM_REPLACE])
+        elif byte == NULL_TERM_ESCAPE:
+            escaped += bytes([NULL_TERM_ESCAPE, NULL_TERM_ESCAPE_REPLACE])
+        else:
+            escaped.append(byte)
+    return bytes(escaped)
+
+
+def command_frame(device, event, args, request_id=None):
+    command = {'sub_device_id': device, 'event_name': event, 'args': args}
+    if request_id is not None:
+        command['req_id'] = request_id
+    return b'\b' + json.dumps(command).encode() + b'\0'
+
+
+def percentile(values, fraction):
+    if not values:
+        return None
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(len(ordered) * fraction))]
+
+
+class Stats:
+
+    def __init__(self):
+        self.sent = 0
+        self.echoed = 0
+        self.dropped = 0
+        self.rejected = 0  # Probes nacked by the satellite (--acks), never counted as dropped
+        self.latencies = []  # (ms)
+        self.messages = 0
+        self.bytes = 0
+        self.acked = 0
+        self.nacked = {}  # Error status -> count
+        self.throttled = 0  # Probes skipped because the command window was full
+        self.ack_latencies = []  # (ms)
+
+    def summary(self, seconds):
+        return {
+            'sent': self.sent,
+            'echoed': self.echoed,
+            'dropped': self.dropped,
+            'drop_rate': self.dropped / self.sent if self.sent else 0.0,
+            'rejected': self.rejected,
+            'reject_rate': self.rejected / self.sent if self.sent else 0.0,
+            'echo_throughput': self.echoed / seconds if seconds else 0.0,
+            'messages_per_s': self.messages / seconds if seconds else 0.0,
+            'kbytes_per_s': self.bytes / 1024 / seconds if seconds else 0.0,
+            'latency_ms': {
+                'p50': percentile(self.latencies, 0.50),
+                'p95': percentile(self.latencies, 0.95),
+                'p99': percentile(self.latencies, 0.99),
+                'max': max(self.latencies) if self.latencies else None,
+            },
+            'acks': {
+                'acked': self.acked,
+                'nacked': self.nacked,
+                'throttled': self.throttled,
+                'p50_ms': percentile(self.ack_latencies, 0.50),
+                'p99_ms': percentile(self.ack_latencies, 0.99),
+            },
+        }
+
+
+class Satellite:
+
+    def __init__(self, reader, writer, options):
+        self.reader = reader
+        self.writer = writer
+        self.options = options
+        self.peer = writer.get_extra_info('peername')
+        self.name = None
+        self.sub_devices = {}
+        self.radiator = None
+        self.ready = asyncio.Event()
+        self.closed = asyncio.Event()
+        self.sequence = 0
+        self.pending = {}  # Probe tag -> send time
+        self.window = 1  # Commands in flight the satellite accepts, from device_info
+        self.image_sha256 = None  # Image the satellite runs, from device_info
+        self.backoff_until = 0.0  # monotonic() until which the satellite's command rate limiter wants a pause
+        self.next_request = 1
+        self.requests = {}  # Request id -> send time, commands not yet acked
+        self.request_probes = {}  # Request id -> tag of the probe the command belongs to
+        self.stats = Stats()
+        self.trace = []  # Trace dump messages (firmware built with -DTRACE)
+        self.trace_done = asyncio.Event()
+        self.seen = collections.deque(maxlen=DATAGRAM_SEEN)  # Sequence numbers of the urgent messages received
+        self.ota_offset = None  # Where the satellite's OTA transfer continues, from its last "ota" message
+        self.ota_status = None
+        self.ota_answered = asyncio.Event()
+
+    def log(self, message):
+        if self.options.verbose:
+            print(f'[{self.name or self.peer}] {message}')
+
+    async def send(self, frame):
+        if self.closed.is_set():
+            return
+        try:
+            self.writer.write(frame)
+            await self.writer.drain()
+        except ConnectionError:
+            self.closed.set()
+
+    async def receive_loop(self):
+        buffer = b''
+        try:
+            while True:
+                data = await self.reader.read(65536)
+                if not data:
+                    break
+                buffer += data
+                while b'\0' in buffer:
+                    message, buffer = buffer.split(b'\0', 1)
+                    if message:
+                        self.handle_message(message)
+        except ConnectionError:
+            pass
+        self.closed.set()
+        self.ready.set()  # Anyone still waiting for the handshake gives up
+
+    def handle_message(self, message, via='tcp'):
+        received_us = time.time_ns() // 1000
+        self.stats.messages += 1
+        self.stats.bytes += len(message) + 1
+        try:
+            document = json.loads(message)
+        except ValueError:
+            self.log(f'Unparseable message: {message[:80]!r}')
+            return
+        msg_type = document.get('msg_type')
+        if msg_type != 'trace' and 'seq' in document:  # Urgent messages can arrive over UDP and TCP
+            if document['seq'] in self.seen:
+                self.log(f'Dropped duplicate {msg_type} {document["seq"]} over {via}')
+                return
+            self.seen.append(document['seq'])
+        if msg_type == 'device_info':
+            self.name = document.get('name')
+            self.sub_devices = document.get('sub_devices', {})
+            self.radiator = next((name for name, kind in self.sub_devices.items() if kind == 'Radiator'), None)
+            self.window = document.get('cmd_window', 1)
+            self.image_sha256 = document.get('image_sha256')
+            print(f'{self.peer} connected as "{self.name}" {document.get("version")} with {self.sub_devices}')
+            self.ready.set()
+        elif msg_type == 'state_update':
+            radiator = document.get('objects', {}).get(self.radiator or '', {})
+            temperature = radiator.get('state', {}).get('radiator_temp')
+            if isinstance(temperature, (int, float)) and math.isfinite(temperature):
+                self.match_echo(temperature)
+            if 'ota' in document:
+                ota = document['ota']
+                self.log(f'ota {ota.get("state")} {ota.get("offset")} of {ota.get("size")} bytes')
+        elif msg_type == 'event':
+            latency = ''
+            if 'ts_us' in document and 'clock_offset_us' in document:
+                latency = f' ({(received_us - document["ts_us"] - document["clock_offset_us"]) / 1000:.1f} ms ago)'
+            self.log(f'event {document.get("object")}.{document.get("event")} {document.get("args")}{latency}'
+                     f'{" over udp" if via == "udp" else ""}')
+        elif msg_type == 'clock_sync':
+            # NTP style, the satellite works out the offset from t0 (its send time) and these two
+            reply = command_frame('Clock', 'sync', [document.get('t0', 0), received_us, time.time_ns() // 1000])
+            asyncio.get_running_loop().create_task(self.send(reply))
+        elif msg_type in ('ack', 'nack'):
+            request_id = document.get('req_id')
+            sent_at = self.requests.pop(request_id, None)
+            tag = self.request_probes.pop(request_id, None)
+            if sent_at is None:
+                return  # Already expired
+            if msg_type == 'nack' and self.pending.pop(tag, None) is not None:
+                self.stats.rejected += 1  # It will never echo, the other command's nack finds it gone
+            if msg_type == 'ack':
+                self.stats.acked += 1
+                self.stats.ack_latencies.append((time.monotonic() - sent_at) * 1000)
+            else:
+                status = document.get('status')
+                self.stats.nacked[status] = self.stats.nacked.get(status, 0) + 1
+                if status == 'rate_limited':
+                    self.backoff_until = time.monotonic() + document.get('retry_ms', 0) / 1000
+                self.log(f'nack {document.get("req_id")}: {status} ({document.get("code")})')
+        elif msg_type == 'overload':
+            self.log(f'overload: {document.get("global_limited")} global, {document.get("device_limited")} device, '
+                     f'{document.get("queue_full")} queue full rejections, {document.get("admitted")} admitted '
+                     f'({document.get("priority")} priority)')
+        elif msg_type == 'ota':
+            error = f' ({document["error"]})' if 'error' in document else ''
+            print(f'[{self.name}] ota {document.get("status")} at {document.get("offset")} of {document.get("size")} '
+                  f'bytes{error}')
+            self.ota_status = document.get('status')
+            self.ota_offset = document.get('offset') if self.ota_status == 'receiving' else None
+            self.ota_answered.set()
+        elif msg_type == 'trace':
+            self.trace.append({**document, 'satellite': self.name})
+            if document.get('seq') == document.get('chunks', 0) - 1:
+                self.trace_done.set()
+        elif msg_type == 'boot':
+            phases = document.get('phases_us', {})
+            start = phases.get('setup', 0)
+            self.log('boot ' + ', '.join(f'{name} +{(time_us - start) / 1000:.1f} ms' for name, time_us in phases.items()))
+        elif msg_type == 'wifi':
+            self.log(f'wifi {document.get("join")} join in {document.get("connect_ms")} ms, '
+                     f'channel {document.get("channel")}, RSSI {document.get("rssi")} dBm, '
+                     f'lease reused {document.get("lease_reuse")} times, {document.get("lease_left_s")} s left')
+        elif msg_type == 'power':
+            residency = ', '.join(f'{state} {ms} ms' for state, ms in document.get('residency_ms', {}).items())
+            locks = ', '.join(f'{name} {lock.get("count")}x {lock.get("held_ms")} ms'
+                              for name, lock in document.get('locks', {}).items())
+            self.log(f'power ({document.get("mode")}) {residency}; locks {locks}')
+        elif msg_type == 'rules':
+            for rule in document.get('rules', []):
+                self.log(f'rule {rule.get("id")}: {rule.get("source")} (fired {rule.get("fired")}, '
+                         f'failed {rule.get("failed")})')
+        elif msg_type == 'diagnostics':
+            self.log_diagnostics(document)
+
+    def log_diagnostics(self, document):
+        """Prints the profiling zones of a diagnostics message (firmware built with -DPROFILE) in microseconds."""
+        clock = document.get('clock_hz') or 1
+        self.log(f'diagnostics over {document.get("interval_ms", 0) / 1000:.0f} s')
+        for zone in document.get('zones', []):
+            count = zone['count']
+            mean = zone['total'] / count if count else 0
+            self.log(f'  {zone["name"]:<28} {count:>7} calls  mean {mean * 1e6 / clock:9.1f} us  '
+                     f'min {zone["min"] * 1e6 / clock:9.1f}  p99 {zone["p99"] * 1e6 / clock:9.1f}  '
+                     f'max {zone["max"] * 1e6 / clock:9.1f} us')
+
+    def match_echo(self, temperature):
+        tag = round((temperature - PROBE_TEMP_BASE) * 1000)
+        sent_at = self.pending.pop(tag, None)
+        if sent_at is None:
+            return  # Periodic update or an echo that already timed out
+        self.stats.echoed += 1
+        self.stats.latencies.append((time.monotonic() - sent_at) * 1000)
+
+    def expire_probes(self):
+        now = time.monotonic()
+        for tag, sent_at in list(self.pending.items()):
+            if now - sent_at > self.options.timeout:
+                del self.pending[tag]
+                self.stats.dropped += 1
+        for request_id, sent_at in list(self.requests.items()):
+            if now - sent_at > self.options.timeout:  # Lost, don't let it hold the window
+                del self.requests[request_id]
+                self.request_probes.pop(request_id, None)
+
+    def command(self, device, event, args, probe=None):
+        if not self.options.acks:
+            return command_frame(device, event, args)
+        request_id = self.next_request
+        self.next_request += 1
+        self.requests[request_id] = time.monotonic()
+        if probe is not None:
+            self.request_probes[request_id] = probe
+        return command_frame(device, event, args, request_id)
+
+    async def probe(self):
+        if self.options.acks and (len(self.requests) + PROBE_COMMANDS > self.window or
+                                  time.monotonic() < self.backoff_until):
+            self.stats.throttled += 1
+            return
+        tag = self.sequence % PROBE_TEMP_SLOTS
+        self.sequence += 1
+        if tag in self.pending:  # Wrapped around onto a probe that never came back
+            del self.pending[tag]
+            self.stats.dropped += 1
+        temperature = PROBE_TEMP_BASE + tag / 1000
+        self.pending[tag] = time.monotonic()
+        self.stats.sent += 1
+        await self.send(self.command(self.radiator, 'radiator_temp_update', [temperature], tag) +
+                        self.command(self.radiator, 'set_on', [False], tag))
+
+    async def heartbeat_loop(self):
+        while not self.closed.is_set():
+            if self.radiator is not None:
+                await self.send(command_frame(self.radiator, 'heartbeat', []))
+            await asyncio.sleep(HEARTBEAT_INTERVAL)
+
+    async def send_ota(self):
+        """Sends --ota-patch if the satellite runs its base, the full --ota image otherwise or if the patch is refused
+        or fails."""
+        if self.options.ota_patch:
+            with open(self.options.ota_patch, 'rb') as f:
+                base_digest, size, digest, operations = OtaDelta.read_header(f.read())
+            if base_digest == self.image_sha256:
+                begin = (struct.pack('<I', size) + digest + struct.pack('<I', len(operations)) +
+                         bytes.fromhex(base_digest))
+                status = await self.send_transfer(OTA_FRAME_PATCH, begin, operations, 'patch')
+                if status == 'receiving':
+                    status = await self.ota_outcome()
+                if status not in ('refused', 'failed'):
+                    return
+            else:
+                print(f'[{self.name}] Runs {(self.image_sha256 or "?")[:8]}, the patch is against {base_digest[:8]}')
+            if not self.options.ota:
+                return
+            print(f'[{self.name}] Falling back to the full image')
+        with open(self.options.ota, 'rb') as f:
+            image = f.read()
+        if self.options.ota_escaped:
+            print(f'[{self.name}] Sending {len(image)} byte OTA image')
+            start = time.monotonic()
+            await self.send(b'\t' + escape(struct.pack('<I', len(image))) + b'\0')
+            for chunk_start in range(0, len(image), OTA_CHUNK_SIZE):
+                await self.send(b'\t' + escape(image[chunk_start:chunk_start + OTA_CHUNK_SIZE]) + b'\0')
+            elapsed = time.monotonic() - start
+            print(f'[{self.name}] OTA image queued in {elapsed:.1f} s [{len(image) / 1024 / elapsed:.1f} KB/s]')
+        else:
+            begin = struct.pack('<I', len(image)) + hashlib.sha256(image).digest()
+            await self.send_transfer(OTA_FRAME_BEGIN, begin, image, 'image')
+
+    async def send_transfer(self, kind, begin, data, what):
+        """Sends a begin frame, then data in frames from the offset the satellite answers with.
+        Returns the satellite's answer to the begin, 'receiving' once the data is sent."""
+        self.ota_answered.clear()
+        await self.send(OTA_FRAME_HEADER.pack(OTA_FRAME, kind, len(begin)) + begin)
+        try:
+            await asyncio.wait_for(self.ota_answered.wait(), OTA_BEGIN_TIMEOUT)
+        except asyncio.TimeoutError:
+            print(f'[{self.name}] No answer to the OTA begin, not sending the {what}')
+            return None
+        if self.ota_offset is None:
+            return self.ota_status  # The satellite said why
+        offset = self.ota_offset
+        self.ota_answered.clear()  # The next answer is the outcome, see ota_outcome()
+        print(f'[{self.name}] Sending {len(data) - offset} of {len(data)} byte OTA {what} from {offset}')
+        start = time.monotonic()
+        cut = self.options.ota_cut
+        for chunk_start in range(offset, len(data), OTA_FRAME_CHUNK):
+            chunk = data[chunk_start:chunk_start + OTA_FRAME_CHUNK]
+            frame = OTA_FRAME_HEADER.pack(OTA_FRAME, OTA_FRAME_DATA, len(chunk)) + chunk
+            if cut is not None and chunk_start + len(chunk) > cut:
+                self.options.ota_cut = None  # Only the first transfer is cut
+                await self.send(frame[:OTA_FRAME_HEADER.size + cut - chunk_start])
+                print(f'[{self.name}] Cutting the connection {cut} bytes into the OTA {what}')
+                self.writer.close()
+                return 'cut'
+            await self.send(frame)
+        elapsed = time.monotonic() - start
+        print(f'[{self.name}] OTA {what} queued in {elapsed:.1f} s '
+              f'[{(len(data) - offset) / 1024 / max(elapsed, 1e-6):.1f} KB/s]')
+        return 'receiving'
+
+    async def ota_outcome(self):
+        """Waits until the satellite restarts into the new image or reports that writing it failed.
+        Returns 'failed', or None once the connection closed."""
+        while not self.closed.is_set():
+            try:
+                await asyncio.wait_for(self.ota_answered.wait(), 1.0)
+            except asyncio.TimeoutError:
+                continue
+            self.ota_answered.clear()
+            if self.ota_status == 'failed':
+                return 'failed'
+        return None
+
+
+class DatagramListener(asyncio.DatagramProtocol):
+
+    def __init__(self, central):
+        self.central = central
+        self.transport = None
+
+    def connection_made(self, transport):
+        self.transport = transport
+
+    def datagram_received(self, data, address):
+        if len(data) < DATAGRAM_HEADER.size:
+            return
+        magic, kind, name_length, _, sequence = DATAGRAM_HEADER.unpack_from(data)
+        if magic != DATAGRAM_MAGIC or kind != DATAGRAM_DATA:
+            return
+        name = data[DATAGRAM_HEADER.size:DATAGRAM_HEADER.size + name_length].decode(errors='replace')
+        satellite = next((satellite for satellite in reversed(self.central.satellites)
+                          if satellite.name == name and not satellite.closed.is_set()), None)
+        if satellite is None:
+            return  # Not acked, the satellite sends it over TCP once it is connected
+        self.transport.sendto(DATAGRAM_HEADER.pack(DATAGRAM_MAGIC, DATAGRAM_ACK, 0, 0, sequence), address)
+        satellite.handle_message(data[DATAGRAM_HEADER.size + name_length:], via='udp')
+
+
+class CentralStandIn:
+
+    def __init__(self, options):
+        self.options = options
+        self.satellites = []
+        self.enough = asyncio.Event()
+
+    async def on_connect(self, reader, writer):
+        satellite = Satellite(reader, writer, self.options)
+        receiving = asyncio.create_task(satellite.receive_loop())
+        await satellite.ready.wait()
+        if satellite.closed.is_set():
+            return
+        self.satellites.append(satellite)
+        heartbeat = asyncio.create_task(satellite.heartbeat_loop())
+        if len(self.satellites) >= self.options.satellites:
+            self.enough.set()
+        for subscription in self.options.subscribe or []:
+            device, fields, interval, *change = subscription.split(':')
+            await satellite.send(satellite.command('Subscriptions', 'subscribe',
+                                                   [device, fields.replace('+', ','), int(interval), change == ['change']]))
+        for rule in self.options.rule or []:
+            rule_id, source = rule.split(':', 1)
+            await satellite.send(satellite.command('Rules', 'add', [int(rule_id), source]))
+        if self.options.rule:
+            await satellite.send(satellite.command('Rules', 'list', []))
+        if self.options.ota or self.options.ota_patch:
+            await satellite.send_ota()
+        await receiving
+        heartbeat.cancel()
+        print(f'[{satellite.name}] disconnected')
+
+    def connected(self):
+        return [satellite for satellite in self.satellites
+                if not satellite.closed.is_set() and satellite.radiator is not None]
+
+    async def run_step(self, rate, duration):
+        satellites = self.connected()
+        for satellite in satellites:
+            satellite.stats = Stats()
+            satellite.pending.clear()
+        start = time.monotonic()
+        next_probe = start
+        while time.monotonic() - start < duration:
+            for satellite in satellites:
+                if not satellite.closed.is_set():
+                    await satellite.probe()
+                satellite.expire_probes()
+            next_probe += 1 / rate
+            await asyncio.sleep(max(0.0, next_probe - time.monotonic()))
+        await asyncio.sleep(self.options.timeout)  # Let the last probes come back
+        for satellite in satellites:
+            satellite.expire_probes()
+            satellite.stats.dropped += len(satellite.pending)
+            satellite.pending.clear()
+            satellite.requests.clear()
+            satellite.request_probes.clear()
+        elapsed = time.monotonic() - start
+        return {satellite.name: satellite.stats.summary(elapsed) for satellite in satellites}
+
+    def print_step(self, rate, results):
+        for name, summary in results.items():
+            latency = summary['latency_ms']
+            p50 = f"{latency['p50']:.1f}" if latency['p50'] is not None else '-'
+            p99 = f"{latency['p99']:.1f}" if latency['p99'] is not None else '-'
+            print(f"{rate:>8.1f} {name:<20} {summary['sent']:>6} {summary['echoed']:>6} "
+                  f"{summary['drop_rate'] * 100:>6.1f}% {p50:>8} {p99:>8} {summary['echo_throughput']:>8.1f} "
+                  f"{summary['kbytes_per_s']:>8.1f}")
+            if self.options.acks:
+                acks = summary['acks']
+                ack_p50 = f"{acks['p50_ms']:.1f}" if acks['p50_ms'] is not None else '-'
+                ack_p99 = f"{acks['p99_ms']:.1f}" if acks['p99_ms'] is not None else '-'
+                print(f"{'':>8} {'':<20} acked {acks['acked']}, nacked {acks['nacked'] or 0}, "
+                      f"throttled {acks['throttled']}, rejected probes {summary['rejected']}, "
+                      f"ack p50 {ack_p50} ms, p99 {ack_p99} ms")
+
+    def saturated(self, results):
+        return any(summary['drop_rate'] > self.options.max_drop_rate or
+                   summary['reject_rate'] > self.options.max_drop_rate or
+                   (summary['latency_ms']['p99'] or 0) > self.options.max_p99
+                   for summary in results.values())
+
+    async def collect_traces(self):
+        satellites = [satellite for satellite in self.satellites if not satellite.closed.is_set()]
+        for satellite in satellites:
+            await satellite.send(command_frame('trace', 'dump', []))
+        try:
+            await asyncio.wait_for(asyncio.gather(*(satellite.trace_done.wait() for satellite in satellites)),
+                                   self.options.timeout * 5)
+        except asyncio.TimeoutError:
+            print('Not every satellite sent a complete trace, is the firmware built with -DTRACE?')
+        with open(self.options.trace, 'w') as f:
+            for satellite in satellites:
+                for message in satellite.trace:
+                    f.write(json.dumps(message) + '\n')
+        print(f'Wrote the traces of {sum(1 for s in satellites if s.trace)} satellite(s) to {self.options.trace}, '
+              f'convert them with TraceConverter.py')
+
+    async def run(self):
+        server = await asyncio.start_server(self.on_connect, self.options.host, self.options.port)
+        udp_port = self.options.udp_port or self.options.port + 1
+        datagrams, _ = await asyncio.get_running_loop().create_datagram_endpoint(
+            lambda: DatagramListener(self), local_addr=(self.options.host, udp_port))
+        print(f'Listening on {self.options.host}:{self.options.port}, '
+              f'waiting for {self.options.satellites} satellite(s)')
+        async with server:
+            await self.enough.wait()
+            await asyncio.sleep(1)  # Let the boot time state updates settle
+            if self.options.ramp:
+                start, stop, step = (float(value) for value in self.options.ramp.split(':'))
+                rates = []
+                while start <= stop:
+                    rates.append(start)
+                    start += step
+                duration = self.options.step_duration
+            else:
+                rates = [self.options.rate]
+                duration = self.options.duration
+            if max(rates) * PROBE_COMMANDS > COMMAND_RATE_DEVICE:
+                print(f'Above {COMMAND_RATE_DEVICE / PROBE_COMMANDS:g} probes/s the satellites rate limit the probes'
+                      f'{"" if self.options.acks else ", use --acks to count them as rejected instead of dropped"}')
+            print(f"{'rate/s':>8} {'satellite':<20} {'sent':>6} {'echoed':>6} {'drop':>7} "
+                  f"{'p50 ms':>8} {'p99 ms':>8} {'echo/s':>8} {'KB/s in':>8}")
+            steps = []
+            for rate in rates:
+                if not self.connected():
+                    print('No satellites left')
+                    break
+                results = await self.run_step(rate, duration)
+                self.print_step(rate, results)
+                steps.append({'rate': rate, 'satellites': results})
+                if self.options.ramp and self.saturated(results):
+                    print(f'Saturated at {rate} probes/s per satellite')
+                    break
+            if self.options.json:
+                with open(self.options.json, 'w') as f:
+                    json.dump({'steps': steps}, f, indent=2)
+            if self.options.trace:
+                await self.collect_traces()
+            if self.options.serve:
+                await asyncio.Event().wait()  # Keep serving until interrupted
+            for satellite in self.satellites:
+                satellite.writer.close()
+            await asyncio.gather(*(satellite.closed.wait() for satellite in self.satellites))
+        datagrams.close()
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Local CENTRAL stand-in and load generator')
+    parser.add_argument('--host', default='0.0.0.0')
+    parser.add_argument('--port', type=int, default=47670)
+    parser.add_argument('--udp-port', type=int, help='Urgent event datagrams, --port + 1 by default')
+    parser.add_argument('--satellites', type=int, default=1, help='Wait for this many satellites before starting')
+    parser.add_argument('--rate', type=float, default=1.0, help='Probes per second per satellite')
+    parser.add_argument('--duration', type=float, default=30.0, help='(s) Length of a fixed rate run')
+    parser.add_argument('--ramp', help='start:stop:step probe rates, stops at the first saturated step')
+    parser.add_argument('--step-duration', type=float, default=10.0, help='(s) Length of each ramp step')
+    parser.add_argument('--timeout', type=float, default=2.0, help='(s) A probe without an echo by then is dropped')
+    parser.add_argument('--max-drop-rate', type=float, default=0.01, help='Saturation threshold for the ramp')
+    parser.add_argument('--max-p99', type=float, default=500.0, help='(ms) Saturation threshold for the ramp')
+    parser.add_argument('--ota', help='Firmware image to send to each satellite after the handshake')
+    parser.add_argument('--ota-escaped', action='store_true', help='Send the OTA image the old way, escaped in messages')
+    parser.add_argument('--ota-patch', help='Delta patch (OtaDelta.py) to send to satellites running its base, '
+                                            'the --ota image goes to the rest')
+    parser.add_argument('--ota-cut', type=int, help='Drop the connection this many bytes into the first OTA transfer')
+    parser.add_argument('--json', help='Write the results to this file')
+    parser.add_argument('--trace', help='Request a trace dump after the load run and write it to this file')
+    parser.add_argument('--serve', action='store_true', help='Keep serving after the load run')
+    parser.add_argument('--subscribe', action='append', help='device:fields:interval_ms[:change], repeatable')
+    parser.add_argument('--rule', action='append', help='id:source of a local automation rule, repeatable')
+    parser.add_argument('--acks', action='store_true', help='Send commands with request ids and track the acks')
+    parser.add_argument('--verbose', action='store_true')
+    try:
+        asyncio.run(CentralStandIn(parser.parse_args()).run())
+    except KeyboardInterrupt:
+        pass
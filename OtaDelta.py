@@ -0,0 +1,120 @@
+# Makes delta OTA patches: a new firmware image as copies from the image a satellite is running (the base) and
+# inserted bytes, which UpdateHandler rebuilds into the next partition while the patch streams in (see
+# OTA_FRAME_PATCH in src/ControllerInterface/UpdateHandler.h). There is no compression, the satellite applies the
+# patch with a 4 KB buffer. The SHA-256 of the new image is checked on the satellite before it boots it.
+#
+# Patch file: magic 'OTAD', version, base image SHA-256, image size (uint32), image SHA-256, then the operations:
+# 1 + base offset (uint32) + length (uint32) copies from the base, 2 + length (uint32) + bytes inserts. The base is
+# named by the hash the satellite reports as image_sha256 in device_info (see image_digest), a git hash is not enough
+# as two builds of one commit differ.
+# Usage: python OtaDelta.py base.bin firmware.bin firmware.otad
+
+import argparse
+import hashlib
+import struct
+import sys
+
+HEADER = struct.Struct('<4sB32sI32s')  # Magic, version, base image SHA-256, image size, image SHA-256
+MAGIC = b'OTAD'
+VERSION = 2
+OP_COPY = 1
+OP_INSERT = 2
+COPY = struct.Struct('<BII')
+INSERT = struct.Struct('<BI')
+KEY = 32  # (bytes) Shortest copy looked for, shorter runs are cheaper inserted than copied
+STRIDE = 8  # Base offsets indexed, a match is found within this many target bytes of where it starts
+IMAGE_MAGIC = 0xE9  # First byte of an ESP32 app image
+HASH_APPENDED = 23  # Offset of the image header flag set when esptool appended the image's SHA-256
+
+
+def image_digest(image):
+    """The SHA-256 esp_partition_get_sha256 returns for the image: the appended one if esptool added it."""
+    if len(image) > HASH_APPENDED + 32 and image[0] == IMAGE_MAGIC and image[HASH_APPENDED] == 1:
+        return hashlib.sha256(image[:-32]).digest()
+    return hashlib.sha256(image).digest()
+
+
+def make_patch(base, target):
+    """Returns the patch rebuilding target from base."""
+    index = {}
+    for offset in range(0, len(base) - KEY + 1, STRIDE):
+        index.setdefault(base[offset:offset + KEY], offset)
+    operations = bytearray()
+    literal_start = 0
+    position = 0
+    while position + KEY <= len(target):
+        source = index.get(target[position:position + KEY])
+        if source is None:
+            position += 1
+            continue
+        start, source_start = position, source
+        while start > literal_start and source_start > 0 and base[source_start - 1] == target[start - 1]:
+            start -= 1
+            source_start -= 1
+        end, source_end = position + KEY, source + KEY
+        while end < len(target) and source_end < len(base):
+            step = min(256, len(target) - end, len(base) - source_end)
+            if target[end:end + step] == base[source_end:source_end + step]:
+                end += step
+                source_end += step
+                continue
+            while target[end] == base[source_end]:
+                end += 1
+                source_end += 1
+            break
+        if start > literal_start:
+            operations += INSERT.pack(OP_INSERT, start - literal_start) + target[literal_start:start]
+        operations += COPY.pack(OP_COPY, source_start, end - start)
+        literal_start = position = end
+    if literal_start < len(target):
+        operations += INSERT.pack(OP_INSERT, len(target) - literal_start) + target[literal_start:]
+    header = HEADER.pack(MAGIC, VERSION, image_digest(base), len(target), hashlib.sha256(target).digest())
+    return header + operations
+
+
+def read_header(patch):
+    """Returns (base image SHA-256 as hex, image size, image SHA-256, operations) of a patch."""
+    magic, version, base_digest, size, digest = HEADER.unpack_from(patch)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError('Not an OTA patch')
+    return base_digest.hex(), size, digest, patch[HEADER.size:]
+
+
+def apply_patch(base, patch):
+    """Rebuilds the image the way the satellite does, to check a patch."""
+    _, size, digest, operations = read_header(patch)
+    image = bytearray()
+    position = 0
+    while position < len(operations):
+        if operations[position] == OP_COPY:
+            _, offset, length = COPY.unpack_from(operations, position)
+            image += base[offset:offset + length]
+            position += COPY.size
+        elif operations[position] == OP_INSERT:
+            _, length = INSERT.unpack_from(operations, position)
+            position += INSERT.size
+            image += operations[position:position + length]
+            position += length
+        else:
+            raise ValueError(f'Invalid operation {operations[position]} at {position}')
+    if len(image) != size or hashlib.sha256(image).digest() != digest:
+        raise ValueError('The patch does not rebuild the image')
+    return bytes(image)
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Make a delta OTA patch between two firmware images')
+    parser.add_argument('base', help='The image the satellites are running')
+    parser.add_argument('target', help='The new image')
+    parser.add_argument('output', help='Where to write the patch')
+    options = parser.parse_args()
+    with open(options.base, 'rb') as f:
+        base_image = f.read()
+    with open(options.target, 'rb') as f:
+        target_image = f.read()
+    patch_data = make_patch(base_image, target_image)
+    apply_patch(base_image, patch_data)
+    with open(options.output, 'wb') as f:
+        f.write(patch_data)
+    print(f'{len(patch_data)} byte patch for a {len(target_image)} byte image '
+          f'({100 * len(patch_data) / max(1, len(target_image)):.1f}%)', file=sys.stderr)
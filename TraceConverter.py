@@ -0,0 +1,139 @@
+# Converts trace dumps (firmware built with -DTRACE, see src/Trace/Trace.h) to the Chrome trace format,
+# open the result in https://ui.perfetto.dev or chrome://tracing.
+# Input is a serial log with "TRACE {json}" lines or the capture CentralStandIn.py --trace writes, several
+# satellites in one capture end up as separate processes.
+# Usage: python TraceConverter.py serial.log [more.log ...] [-o trace.json]
+
+import argparse
+import json
+import struct
+import sys
+
+RECORD = struct.Struct('<IBBHII')  # TraceRecord: timestamp, type, task, object, id, value
+
+TYPES = {
+    1: 'wait_begin', 2: 'wait_end', 3: 'queue_send', 4: 'queue_receive', 5: 'msg_queued',
+    6: 'msg_sent', 7: 'msg_received', 8: 'msg_parsed', 9: 'msg_executed', 10: 'ota_chunk',
+}
+
+OBJECTS = {
+    0: '', 1: 'downlink_queue', 2: 'uplink_queue', 3: 'update_queue', 4: 'downlink_buffer_mutex',
+    5: 'exclusive_downlink_mutex', 6: 'downlink_semaphore',
+}
+
+
+def load_dumps(paths):
+    """Collects the trace messages of every input, keyed by satellite."""
+    dumps = {}
+    for path in paths:
+        with open(path, errors='replace') as f:
+            for line in f:
+                start = line.find('{')
+                if start < 0 or '"trace"' not in line:
+                    continue
+                try:
+                    message = json.loads(line[start:])
+                except ValueError:
+                    continue
+                if message.get('msg_type') != 'trace':
+                    continue
+                satellite = message.get('satellite', path)
+                if message['seq'] == 0:
+                    dumps[satellite] = {'tasks': message.get('tasks', []), 'recorded': message.get('recorded', 0),
+                                        'chunks': {}}
+                elif satellite in dumps:
+                    dumps[satellite]['chunks'][message['seq']] = bytes.fromhex(message['data'])
+    return dumps
+
+
+def decode(dump):
+    """Yields the records of a dump with the timestamps unwrapped to 64 bit microseconds."""
+    data = b''.join(dump['chunks'][seq] for seq in sorted(dump['chunks']))
+    now = None
+    last = 0
+    for offset in range(0, len(data) - RECORD.size + 1, RECORD.size):
+        timestamp, kind, task, obj, message_id, value = RECORD.unpack_from(data, offset)
+        if kind not in TYPES:
+            continue  # Slot that was never written
+        if now is None:
+            now = timestamp
+        else:
+            delta = (timestamp - last) & 0xffffffff
+            now += delta - (1 << 32) if delta >= 1 << 31 else delta  # Records of different tasks can be out of order
+        last = timestamp
+        yield now, TYPES[kind], task, OBJECTS.get(obj, str(obj)), message_id, value
+
+
+def convert(pid, name, dump, events, latencies):
+    tasks = dump['tasks']
+    events.append({'name': 'process_name', 'ph': 'M', 'pid': pid, 'args': {'name': name}})
+    for index, task in enumerate(tasks):
+        events.append({'name': 'thread_name', 'ph': 'M', 'pid': pid, 'tid': index, 'args': {'name': task}})
+    open_waits = {}
+    messages = {}  # Message id -> (start time, direction)
+    end = 0
+    for now, kind, task, obj, message_id, value in decode(dump):
+        end = now
+        base = {'pid': pid, 'tid': task, 'ts': now}
+        if kind == 'wait_begin':
+            open_waits.setdefault(task, []).append(obj)
+            events.append({**base, 'name': f'wait {obj}', 'ph': 'B'})
+        elif kind == 'wait_end':
+            if not open_waits.get(task):
+                continue  # The matching begin was overwritten
+            open_waits[task].pop()
+            events.append({**base, 'name': f'wait {obj}', 'ph': 'E', 'args': {'acquired': bool(value)}})
+        elif kind in ('msg_queued', 'msg_received'):
+            direction = 'downlink' if kind == 'msg_queued' else 'uplink'
+            messages[message_id] = (now, direction)
+            events.append({**base, 'name': f'{direction} #{message_id}', 'cat': direction, 'ph': 'b',
+                           'id': message_id, 'args': {'bytes': value}})
+        elif kind in ('msg_sent', 'msg_executed'):
+            if message_id not in messages:
+                continue
+            start, direction = messages.pop(message_id)
+            latencies.setdefault(direction, []).append(now - start)
+            events.append({**base, 'name': f'{direction} #{message_id}', 'cat': direction, 'ph': 'e',
+                           'id': message_id, 'args': {'write_us': value} if kind == 'msg_sent' else {}})
+        elif kind in ('queue_receive', 'msg_parsed') and message_id in messages:
+            direction = messages[message_id][1]
+            events.append({**base, 'name': kind, 'cat': direction, 'ph': 'n', 'id': message_id,
+                           'args': {'queue': obj} if obj else {}})
+        else:
+            args = {'id': message_id} if message_id else {}
+            if kind == 'queue_send':
+                args['queued'] = bool(value)
+            elif kind == 'ota_chunk':
+                args['bytes'] = value
+            events.append({**base, 'name': f'{kind} {obj}'.strip(), 'ph': 'i', 's': 't', 'args': args})
+    for task, waits in open_waits.items():  # Still blocked when the dump was taken
+        for obj in waits:
+            events.append({'pid': pid, 'tid': task, 'ts': end, 'name': f'wait {obj}', 'ph': 'E'})
+
+
+def percentile(values, fraction):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * fraction))]
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Convert trace dumps to the Chrome/Perfetto trace format')
+    parser.add_argument('inputs', nargs='+')
+    parser.add_argument('-o', '--output', default='trace.json')
+    args = parser.parse_args()
+    dumps = load_dumps(args.inputs)
+    if not dumps:
+        print('No trace dumps found')
+        sys.exit(1)
+    events = []
+    latencies = {}
+    for pid, (name, dump) in enumerate(sorted(dumps.items()), start=1):
+        convert(pid, name, dump, events, latencies)
+        print(f'{name}: {dump["recorded"]} records since boot, {len(dump["chunks"])} chunks, '
+              f'{len(dump["tasks"])} tasks')
+    for direction, values in sorted(latencies.items()):
+        print(f'{direction}: {len(values)} messages, p50 {percentile(values, 0.5)} us, '
+              f'p99 {percentile(values, 0.99)} us, max {max(values)} us')
+    with open(args.output, 'w') as f:
+        json.dump({'traceEvents': events, 'displayTimeUnit': 'ms'}, f)
+    print(f'Wrote {len(events)} events to {args.output}')
@@ -0,0 +1,164 @@
+//
+// Created by Jay on 10/18/2026.
+//
+// Allocations are counted by wrapping malloc/calloc/realloc at link time (-Wl,--wrap=malloc ..., see the bench envs
+// in platformio.ini), operator new is routed through malloc so C++ allocations are counted too.
+//
+
+#include "BenchHarness.h"
+
+#include <atomic>
+#include <cstdarg>
+#include <new>
+
+#include "build_info.h"
+
+#ifdef NATIVE_BUILD
+#include <chrono>
+#define BENCH_TARGET "native"
+#else
+#include <esp_timer.h>
+#define BENCH_TARGET "esp32"
+#endif
+
+namespace {
+
+std::atomic<bool> counting{false};
+std::atomic<uint32_t> allocations{0};
+std::atomic<uint64_t> allocated_bytes{0};
+
+void countAllocation(const size_t size) {
+    if (!counting.load(std::memory_order_relaxed)) return;
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+uint64_t nowNs() {
+#ifdef NATIVE_BUILD
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+    return static_cast<uint64_t>(esp_timer_get_time()) * 1000;
+#endif
+}
+
+struct BenchTask {
+    const BenchCase* bench_case;
+    BenchResult result;
+    SemaphoreHandle_t done;
+};
+
+void benchTask(void* pvParameters) {
+    auto* task = static_cast<BenchTask*>(pvParameters);
+    const auto op = task->bench_case->op;
+    const auto prepare = task->bench_case->batch;
+    if (prepare != nullptr) prepare();
+    for (uint16_t i = 0; i < BENCH_WARMUP_ITERATIONS; i++) op();
+    uint32_t iterations = 0;
+    allocations = 0;
+    allocated_bytes = 0;
+    counting = true;
+    const auto minimum = static_cast<uint64_t>(BENCH_MIN_TIME_MS) * 1000000;
+    uint64_t elapsed = 0;
+    // Check the clock in batches so reading it isn't a large part of a short op
+    for (uint32_t batch = 1; elapsed < minimum && iterations < BENCH_MAX_ITERATIONS; batch *= 2) {
+        if (prepare != nullptr) {
+            counting = false;
+            prepare();
+            counting = true;
+        }
+        const auto start = nowNs();
+        for (uint32_t i = 0; i < batch; i++) op();
+        iterations += batch;
+        elapsed += nowNs() - start;
+    }
+    counting = false;
+    task->result.iterations = iterations;
+    task->result.elapsed_ns = elapsed;
+    task->result.allocations = allocations;
+    task->result.allocated_bytes = allocated_bytes;
+    task->result.peak_stack = BENCH_STACK_SIZE - uxTaskGetStackHighWaterMark(nullptr);
+    xSemaphoreGive(task->done);
+    vTaskDelete(nullptr);
+}
+
+}
+
+extern "C" {
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+
+void* __wrap_malloc(const size_t size) {
+    countAllocation(size);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(const size_t count, const size_t size) {
+    countAllocation(count * size);
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, const size_t size) {
+    countAllocation(size);
+    return __real_realloc(pointer, size);
+}
+
+}
+
+void* operator new(const size_t size) {
+    auto* pointer = malloc(size);
+    if (pointer == nullptr) abort();
+    return pointer;
+}
+
+void* operator new[](const size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
+void benchPrint(const char* format, ...) {
+    char line[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+#ifdef NATIVE_BUILD
+    puts(line); // Serial carries the firmware's debug output, which is silenced on the host
+#else
+    Serial.println(line);
+#endif
+}
+
+BenchResult benchRun(const BenchCase& bench_case) {
+    BenchTask task = {&bench_case, {}, xSemaphoreCreateBinary()};
+    xTaskCreate(benchTask, "bench", BENCH_STACK_SIZE, &task, 1, nullptr);
+    xSemaphoreTake(task.done, portMAX_DELAY);
+    vSemaphoreDelete(task.done);
+    const auto& result = task.result;
+    benchPrint("BENCH {\"name\":\"%s\",\"devices\":%u,\"iterations\":%u,\"ns_per_op\":%.1f,"
+               "\"bytes_per_op\":%.1f,\"allocs_per_op\":%.2f,\"peak_stack\":%u,"
+               "\"target\":\"" BENCH_TARGET "\",\"version\":\"" BUILD_VERSION "\",\"git_hash\":\"" BUILD_GIT_HASH "\"}",
+               bench_case.name, bench_case.devices, result.iterations,
+               static_cast<double>(result.elapsed_ns) / result.iterations,
+               static_cast<double>(result.allocated_bytes) / result.iterations,
+               static_cast<double>(result.allocations) / result.iterations,
+               result.peak_stack);
+    return result;
+}
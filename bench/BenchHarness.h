@@ -0,0 +1,45 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#ifndef BENCHHARNESS_H
+#define BENCHHARNESS_H
+
+#include <Arduino.h>
+
+#define BENCH_STACK_SIZE        16384 // (bytes) Stack of the task each benchmark runs in
+#define BENCH_MIN_TIME_MS       200   // Every benchmark runs for at least this long
+#define BENCH_MAX_ITERATIONS    200000
+#define BENCH_WARMUP_ITERATIONS 16
+
+/**
+ * A single operation to measure, op() is called repeatedly from a dedicated task.
+ */
+struct BenchCase {
+    const char* name;
+    uint16_t devices; // Number of registered devices when the case ran, reported as is
+    void (*op)();
+    void (*batch)() = nullptr; // Optional, called before every batch of op() calls, outside the timing
+};
+
+struct BenchResult {
+    uint32_t iterations;
+    uint64_t elapsed_ns;
+    uint64_t allocated_bytes;
+    uint32_t allocations;
+    uint32_t peak_stack; // (bytes) Deepest stack use of the benchmark task
+};
+
+/**
+ * Runs the case in a fresh task and prints one result line:
+ * BENCH {"name": ..., "devices": ..., "ns_per_op": ..., "bytes_per_op": ..., "allocs_per_op": ..., "peak_stack": ...}
+ * Lines are prefixed with "BENCH " so they can be picked out of the serial log, see bench/compare_bench.py.
+ */
+BenchResult benchRun(const BenchCase& bench_case);
+
+/**
+ * Prints a line to wherever the results go (stdout on the host, Serial on the ESP32).
+ */
+void benchPrint(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+#endif //BENCHHARNESS_H
@@ -0,0 +1,317 @@
+//
+// Created by Jay on 10/18/2026.
+//
+// Microbenchmarks of the code every message goes through. Built in place of main.cpp, by the bench-native env on the
+// host and the bench env on the ESP32, results are printed as "BENCH {json}" lines.
+//
+// Ops that queue a message also take it back off the queue so the queue never fills, the queueRoundTrip case
+// measures that part alone.
+//
+
+#include <Arduino.h>
+#include <ControllerInterface/RoomInterface.h>
+#include <ControllerInterface/RoomDevice.h>
+#include <Power/Power.h>
+
+#include "BenchHarness.h"
+
+#ifdef NATIVE_BUILD
+#include <NativeKernel.h>
+#include <esp_pm.h>
+#endif
+
+#define BENCH_MAX_DEVICES 16
+#define BENCH_OTA_CHUNK   1000 // (bytes) Unescaped OTA payload per frame, what CENTRAL sends
+
+RoomInterface room_interface; // Never started, the benchmarks call into it directly
+
+/**
+ * Friend of RoomInterface, NetworkInterface and UpdateHandler, lets the benchmarks feed and drain the queues
+ * without a connection to CENTRAL or the update task.
+ */
+struct BenchAccess {
+
+    static NetworkInterface* network() {
+        return room_interface.networkInterface;
+    }
+
+    static void createQueues() {
+        auto* network_interface = network();
+        network_interface->downlink_queue = xQueueCreate(5, sizeof(NetworkInterface::downlink_message_t));
+        // Sized like NetworkInterface::begin, CENTRAL's window plus the priority slots
+        network_interface->uplink_queue = xQueueCreate(COMMAND_WINDOW + COMMAND_RESERVED_SLOTS,
+            sizeof(NetworkInterface::uplink_message_t));
+        network_interface->link_up = true; // queue_message drops everything while the link is down
+    }
+
+    static void handleUplinkData(const uint8_t* data, const size_t length) {
+        network()->handle_uplink_data(data, length);
+    }
+
+    /**
+     * Refills every bucket and widens it to the largest burst, enough for a whole batch of the admitted command case,
+     * which would otherwise run into the rate limit after a few calls. Called between batches, outside the timing.
+     */
+    /**
+     * Puts the firmware's buckets back, so the rejected command case runs into the rate limit.
+     */
+    static void resetLimiter() {
+        network()->command_limiter = CommandLimiter();
+    }
+
+    static void openLimiter(const char* command) {
+        auto& limiter = network()->command_limiter;
+        limiter = CommandLimiter();
+        bool is_priority = false;
+        uint32_t retry_ms = 0;
+        limiter.admit(command, &is_priority, &retry_ms); // Starts the limiter and gives the command's device a bucket
+        const auto now = millis();
+        for (auto* bucket : {&limiter.global, &limiter.priority, &limiter.shared}) {
+            bucket->reset(UINT16_MAX, UINT16_MAX, now);
+        }
+        for (auto& device : limiter.devices) {
+            if (device.device != 0) device.bucket.reset(UINT16_MAX, UINT16_MAX, now);
+        }
+    }
+
+    static void passData(const uint8_t* data, const size_t length) {
+        network()->update_handler->passData(data, length);
+    }
+
+    static void drainDownlink() {
+        static NetworkInterface::downlink_message_t message;
+        xQueueReceive(network()->downlink_queue, &message, 0);
+    }
+
+    static void drainUplink() {
+        static NetworkInterface::uplink_message_t message;
+        network()->uplink_queue_receive(&message, 0);
+    }
+
+    /**
+     * Starts a transfer that never completes, the OTA cases then only measure the receiving side.
+     */
+    static void beginUpdate() {
+        constexpr uint32_t offset = 0; // The update task's answer to the begin
+        xQueueSend(network()->update_handler->resumed, &offset, 0);
+        UpdateHandler::block_t begin{};
+        begin.kind = OTA_FRAME_BEGIN;
+        begin.buffer = -1;
+        begin.length = UINT32_MAX;
+        network()->update_handler->beginTransfer(begin);
+        drainUpdate();
+    }
+
+    /**
+     * Stands in for the update task, hands the filled buffers straight back.
+     */
+    static void drainUpdate() {
+        auto* update_handler = network()->update_handler;
+        UpdateHandler::block_t block;
+        while (xQueueReceive(update_handler->filled, &block, 0) == pdTRUE) {
+            if (block.kind == OTA_FRAME_DATA) xQueueSend(update_handler->empty, &block.buffer, 0);
+        }
+    }
+
+    static void queueRoundTrip() {
+        static NetworkInterface::downlink_message_t message;
+        xQueueSend(network()->downlink_queue, &message, 0);
+        xQueueReceive(network()->downlink_queue, &message, 0);
+    }
+
+};
+
+/**
+ * Stand-in device with roughly the amount of state a real device reports.
+ */
+class BenchDevice final : public RoomDevice {
+
+    char name[16] = {};
+    int32_t value = 0;
+
+public:
+
+    explicit BenchDevice(const uint16_t index) : RoomDevice(&room_interface) {
+        snprintf(name, sizeof(name), "bench_%02u", index);
+        deviceData["state"]["value"] = 0;
+        deviceData["state"]["temperature"] = 21.5f;
+        deviceData["state"]["enabled"] = true;
+        deviceData["state"]["mode"] = "auto";
+        deviceData["health"]["online"] = true;
+        deviceData["health"]["fault"] = false;
+        deviceData["health"]["reason"] = "";
+        deviceData["info"]["last_update"] = 0;
+        deviceData["actions"][0] = "set_value";
+        addEventCallback("set_value", [](RoomDevice* self, const ParsedEvent_t* data) {
+            static_cast<BenchDevice*>(self)->value = data->args[1].value.intVal;
+        });
+    }
+
+    char* getObjectName() override {
+        return name;
+    }
+
+    char* getObjectType() override {
+        return const_cast<char*>("BenchDevice");
+    }
+
+    JsonVariant getDeviceData() override {
+        deviceData["state"]["value"] = value;
+        deviceData["info"]["last_update"] = millis();
+        return deviceData;
+    }
+
+    ParsedEvent_t* fillEvent() {
+        auto* event = getScratchSpace();
+        event->objectName = writeStringToScratchSpace(name, event);
+        event->eventName = writeStringToScratchSpace("value_changed", event);
+        event->args[0].type = ParsedArg::INT;
+        event->args[0].value.intVal = value;
+        event->args[1].type = ParsedArg::FLOAT;
+        event->args[1].value.floatVal = 21.5f;
+        event->numArgs = 2;
+        return event;
+    }
+
+};
+
+namespace {
+
+const char COMMAND[] = R"({"sub_device_id": "bench_00", "event_name": "set_value", "args": [true, 42, 21.5, "text"]})";
+
+BenchDevice* devices[BENCH_MAX_DEVICES] = {};
+uint16_t device_count = 0;
+
+ParsedEvent_t* parsed_command = nullptr;
+uint8_t parsed_command_args = 0;
+
+uint8_t command_frame[sizeof(COMMAND) + 1];
+uint8_t ota_frame[1 + 2 * BENCH_OTA_CHUNK + 1];
+size_t ota_frame_length = 0;
+char device_info[1024];
+
+void addDevices(const uint16_t count) {
+    while (device_count < count) {
+        devices[device_count] = new BenchDevice(device_count);
+        device_count++;
+    }
+}
+
+/**
+ * Builds the frames the way CENTRAL sends them, OTA payloads escaped like the network interface expects.
+ */
+void buildFrames() {
+    command_frame[0] = '\b';
+    memcpy(command_frame + 1, COMMAND, sizeof(COMMAND)); // Includes the null terminator
+    ota_frame[ota_frame_length++] = '\t';
+    for (size_t i = 0; i < BENCH_OTA_CHUNK; i++) {
+        const auto byte = static_cast<uint8_t>(i * 37); // Hits both escaped values
+        if (byte == '\0') {
+            ota_frame[ota_frame_length++] = NULL_TERM_ESCAPE;
+            ota_frame[ota_frame_length++] = NULL_TERM_REPLACE;
+        } else if (byte == NULL_TERM_ESCAPE) {
+            ota_frame[ota_frame_length++] = NULL_TERM_ESCAPE;
+            ota_frame[ota_frame_length++] = NULL_TERM_ESCAPE_REPLACE;
+        } else {
+            ota_frame[ota_frame_length++] = byte;
+        }
+    }
+    ota_frame[ota_frame_length++] = '\0';
+}
+
+void eventParse() {
+    auto* event = room_interface.eventParse(COMMAND);
+    RoomInterface::cleanup_scratch_space(event);
+}
+
+void eventExecute() {
+    // cleanup_scratch_space only resets the counts, the strings are still in the scratch space
+    parsed_command->numArgs = parsed_command_args;
+    parsed_command->finished = false;
+    room_interface.eventExecute(parsed_command);
+}
+
+void sendEvent() {
+    room_interface.sendEvent(devices[0]->fillEvent());
+    BenchAccess::drainDownlink();
+}
+
+void sendDownlink() {
+    room_interface.sendDownlink();
+    BenchAccess::drainDownlink();
+}
+
+void getDeviceInfo() {
+    room_interface.getDeviceInfo(device_info);
+}
+
+void openLimiter() {
+    BenchAccess::openLimiter(COMMAND);
+}
+
+void handleCommandFrame() {
+    BenchAccess::handleUplinkData(command_frame, sizeof(command_frame));
+    BenchAccess::drainUplink();
+}
+
+void rejectCommandFrame() {
+    // Past the burst nearly every call is rejected, the few the refill lets through are drained like the nacks
+    BenchAccess::handleUplinkData(command_frame, sizeof(command_frame));
+    BenchAccess::drainUplink();
+    BenchAccess::drainDownlink();
+}
+
+void handleOtaFrame() {
+    BenchAccess::handleUplinkData(ota_frame, ota_frame_length);
+    BenchAccess::drainUpdate();
+}
+
+void passData() {
+    BenchAccess::passData(ota_frame + 1, ota_frame_length - 2); // Same slice handle_uplink_data passes
+    BenchAccess::drainUpdate();
+}
+
+}
+
+void setup() {
+#ifdef NATIVE_BUILD
+    native::setSerialOutput(nullptr); // Only the results go to stdout
+#else
+    Serial.begin(115200);
+#endif
+    powerBegin(); // The hot paths take power locks, measure them with the locks live like the firmware
+    BenchAccess::createQueues();
+    BenchAccess::beginUpdate();
+    buildFrames();
+    addDevices(1);
+    parsed_command = room_interface.eventParse(COMMAND);
+    parsed_command_args = parsed_command->numArgs;
+
+    benchRun({"queueRoundTrip", 0, BenchAccess::queueRoundTrip});
+    benchRun({"eventParse", device_count, eventParse});
+    benchRun({"eventExecute", device_count, eventExecute});
+    benchRun({"sendEvent", device_count, sendEvent});
+    benchRun({"handle_uplink_data.command", 0, handleCommandFrame, openLimiter});
+    BenchAccess::resetLimiter();
+    benchRun({"handle_uplink_data.command_rejected", 0, rejectCommandFrame});
+    benchRun({"handle_uplink_data.ota", 0, handleOtaFrame});
+    benchRun({"UpdateHandler::passData", 0, passData});
+    for (const uint16_t count : {1, 4, BENCH_MAX_DEVICES}) {
+        addDevices(count);
+        benchRun({"sendDownlink", device_count, sendDownlink});
+        benchRun({"getDeviceInfo", device_count, getDeviceInfo});
+    }
+#ifdef NATIVE_BUILD
+    if (native::pmLocksHeld() != 0) benchPrint("BENCH_ERROR %d power locks left held", native::pmLocksHeld());
+#endif
+    benchPrint("BENCH_DONE");
+}
+
+void loop() {
+#ifdef NATIVE_BUILD
+    fflush(stdout);
+    _Exit(EXIT_SUCCESS); // The firmware never returns from loop(), neither does the native main()
+#else
+    vTaskDelay(portMAX_DELAY);
+#endif
+}
@@ -0,0 +1,58 @@
+# Compares two benchmark runs (stdout of bench-native or the serial log of the bench env).
+# Usage: python bench/compare_bench.py baseline.txt current.txt [--threshold 10]
+# Exits with 1 if any benchmark got slower, allocates more or uses more stack than the threshold allows.
+
+import argparse
+import json
+import sys
+
+
+def load_results(path):
+    results = {}
+    with open(path, errors='replace') as f:
+        for line in f:
+            # Serial logs can have other output in front of the result on the same line
+            start = line.find('BENCH {')
+            if start < 0:
+                continue
+            result = json.loads(line[start + len('BENCH '):])
+            results[(result['name'], result['devices'])] = result
+    return results
+
+
+def change(before, after):
+    if before == 0:
+        return 0.0 if after == 0 else float('inf')
+    return (after - before) / before * 100
+
+
+def compare(baseline, current, threshold):
+    regressions = 0
+    print(f"{'benchmark':<36} {'ns/op':>12} {'change':>8} {'bytes/op':>10} {'change':>8} {'stack':>7} {'change':>8}")
+    for key in sorted(current):
+        name = f'{key[0]} [{key[1]}]' if key[1] else key[0]
+        after = current[key]
+        before = baseline.get(key)
+        if before is None:
+            print(f"{name:<36} {after['ns_per_op']:>12.1f} {'new':>8}")
+            continue
+        changes = [change(before[field], after[field]) for field in ('ns_per_op', 'bytes_per_op', 'peak_stack')]
+        flag = ' <-- regression' if any(c > threshold for c in changes) else ''
+        regressions += 1 if flag else 0
+        print(f"{name:<36} {after['ns_per_op']:>12.1f} {changes[0]:>+7.1f}% {after['bytes_per_op']:>10.1f} "
+              f"{changes[1]:>+7.1f}% {after['peak_stack']:>7} {changes[2]:>+7.1f}%{flag}")
+    for key in sorted(set(baseline) - set(current)):
+        print(f'{key[0]} [{key[1]}] missing from the current run')
+    return regressions
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Compare two benchmark runs')
+    parser.add_argument('baseline')
+    parser.add_argument('current')
+    parser.add_argument('--threshold', type=float, default=10.0, help='Allowed change in percent')
+    args = parser.parse_args()
+    found = compare(load_results(args.baseline), load_results(args.current), args.threshold)
+    if found:
+        print(f'{found} regression(s) over {args.threshold}%')
+    sys.exit(1 if found else 0)
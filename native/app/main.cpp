@@ -0,0 +1,18 @@
+//
+// Created by Jay on 10/18/2026.
+//
+// Entry point of the native build, runs the firmware's setup() and loop() like the Arduino loop task does.
+//
+
+#include <Arduino.h>
+
+void setup();
+
+void loop();
+
+int main() {
+    setup();
+    while (true) {
+        loop();
+    }
+}
@@ -0,0 +1,99 @@
+//
+// Created by Jay on 10/18/2026.
+//
+// Fleet simulation: runs many satellites in one process, each one a RoomInterface with its own Radiator,
+// MotionDetector and EnvironmentSensor and its own connection to CENTRAL_HOST:CENTRAL_PORT. Meant to be pointed at
+// CentralStandIn.py (or a CENTRAL test instance) to load the server side with realistic fan-in.
+//
+// Usage: fleet [--satellites N] [--prefix NAME] [--stagger MS] [--duration S]
+//
+// The satellites share the host's simulated pins and sensor, only their connections and state are separate.
+//
+
+#include <Arduino.h>
+
+#include <ControllerInterface/RoomInterface.h>
+#include <Devices/EnvironmentSensor.h>
+#include <Devices/MotionDetector.h>
+#include <Devices/Radiator.h>
+#include <WifiJoin/WifiJoin.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#define FLEET_DEFAULT_SATELLITES 10
+#define FLEET_MAX_SATELLITES     1000
+#define FLEET_NAME_LENGTH        32
+
+namespace {
+
+struct Options {
+    uint32_t satellites = FLEET_DEFAULT_SATELLITES;
+    const char* prefix = "fleet";
+    uint32_t stagger = 0; // (ms) Between satellite starts, 0 starts them all at once
+    uint32_t duration = 0; // (s) 0 runs until interrupted
+};
+
+/**
+ * One simulated satellite, the interface and its devices live as long as the process.
+ */
+struct Satellite {
+    char name[FLEET_NAME_LENGTH] = {};
+    RoomInterface room_interface;
+    Radiator* radiator = nullptr;
+    MotionDetector* motion_detector = nullptr;
+    EnvironmentSensor* environment_sensor = nullptr;
+};
+
+bool parseOptions(const int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const std::string option = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (option == "--satellites" && has_value) options.satellites = strtoul(argv[++i], nullptr, 10);
+        else if (option == "--prefix" && has_value) options.prefix = argv[++i];
+        else if (option == "--stagger" && has_value) options.stagger = strtoul(argv[++i], nullptr, 10);
+        else if (option == "--duration" && has_value) options.duration = strtoul(argv[++i], nullptr, 10);
+        else return false;
+    }
+    return options.satellites > 0 && options.satellites <= FLEET_MAX_SATELLITES;
+}
+
+}
+
+int main(const int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        fprintf(stderr, "Usage: %s [--satellites 1-%d] [--prefix NAME] [--stagger MS] [--duration S]\n",
+            argv[0], FLEET_MAX_SATELLITES);
+        return EXIT_FAILURE;
+    }
+    native::setSerialOutput(nullptr); // A few hundred satellites logging to one terminal is just noise
+
+    printf("Starting %u satellites against %s:%d\n", options.satellites, CENTRAL_HOST, CENTRAL_PORT);
+    const auto start = std::chrono::steady_clock::now();
+    wifiJoinStart(); // Every satellite shares the one (host) network
+    std::vector<Satellite*> satellites;
+    for (uint32_t i = 0; i < options.satellites; i++) {
+        auto* satellite = new Satellite();
+        satellites.push_back(satellite);
+        snprintf(satellite->name, sizeof(satellite->name), "%s_%03u", options.prefix, i);
+        satellite->radiator = new Radiator(&satellite->room_interface);
+        satellite->motion_detector = new MotionDetector(&satellite->room_interface);
+        satellite->environment_sensor = new EnvironmentSensor(&satellite->room_interface);
+        satellite->room_interface.begin(satellite->name); // Connects in the background
+        if (options.stagger > 0) delay(options.stagger);
+    }
+    for (const auto* satellite : satellites) {
+        while (!satellite->room_interface.linkUp()) delay(1);
+    }
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%u satellites connected in %.2f s\n", options.satellites, elapsed);
+    fflush(stdout);
+
+    if (options.duration == 0) {
+        while (true) vTaskDelay(portMAX_DELAY);
+    }
+    delay(options.duration * 1000);
+    _Exit(EXIT_SUCCESS); // The satellite tasks never return
+}
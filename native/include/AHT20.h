@@ -0,0 +1,33 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#ifndef NATIVE_AHT20_H
+#define NATIVE_AHT20_H
+
+#include "Arduino.h"
+
+/**
+ * Stand-in for the AHT20 sensor, reports whatever was last set with native::setEnvironment.
+ */
+class AHT20 {
+public:
+    bool begin();
+    bool isConnected();
+    bool available();
+    float getTemperature();
+    float getHumidity();
+};
+
+namespace native {
+
+/**
+ * @param temperature (C) Reported by every AHT20.
+ * @param humidity (%RH) Reported by every AHT20.
+ * @param connected False to simulate a missing sensor.
+ */
+void setEnvironment(float temperature, float humidity, bool connected = true);
+
+}
+
+#endif //NATIVE_AHT20_H
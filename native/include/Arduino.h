@@ -0,0 +1,104 @@
+//
+// Created by Jay on 10/18/2026.
+//
+// Host stand-in for the parts of the ESP32 Arduino core the firmware uses.
+//
+
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <math.h>
+#include <ctime>
+#include <string>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+typedef bool boolean;
+
+#define IRAM_ATTR
+#define __NOINIT_ATTR
+#define RTC_NOINIT_ATTR
+
+#define LOW  0x0
+#define HIGH 0x1
+
+#define INPUT        0x01
+#define OUTPUT       0x03
+#define INPUT_PULLUP 0x05
+
+#define RISING  0x01
+#define FALLING 0x02
+#define CHANGE  0x03
+
+#define NATIVE_GPIO_COUNT 40
+
+#define digitalPinToInterrupt(p) (p)
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode);
+void attachInterruptArg(uint8_t pin, void (*isr)(void*), void* arg, int mode);
+
+void ledcSetup(uint8_t channel, double frequency, uint8_t resolution);
+void ledcAttachPin(uint8_t pin, uint8_t channel);
+void ledcDetachPin(uint8_t pin);
+void ledcWrite(uint8_t channel, uint32_t duty);
+
+float temperatureRead();
+uint32_t esp_get_free_heap_size();
+[[noreturn]] void esp_restart();
+void configTime(long gmtOffset_sec, int daylightOffset_sec,
+    const char* server1, const char* server2 = nullptr, const char* server3 = nullptr);
+
+class String {
+    std::string value;
+public:
+    String(const char* string = "") : value(string) {}
+    String(const std::string& string) : value(string) {}
+    const char* c_str() const { return value.c_str(); }
+    size_t length() const { return value.length(); }
+};
+
+class HardwareSerial {
+public:
+    void begin(unsigned long baud) {}
+    int printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    size_t print(const char* string);
+    size_t println(const char* string = "");
+    size_t write(const uint8_t* buffer, size_t size);
+    void flush();
+};
+
+extern HardwareSerial Serial;
+
+namespace native {
+
+/**
+ * Drives an input pin as if the outside world changed it, firing any attached interrupt.
+ */
+void gpioDrive(uint8_t pin, uint8_t value);
+
+/**
+ * @param output Where Serial writes to, nullptr silences it.
+ */
+void setSerialOutput(FILE* output);
+
+}
+
+#endif //NATIVE_ARDUINO_H
@@ -0,0 +1,10 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#ifndef NATIVE_HARDWARESERIAL_H
+#define NATIVE_HARDWARESERIAL_H
+
+#include "Arduino.h"
+
+#endif //NATIVE_HARDWARESERIAL_H
@@ -0,0 +1,28 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#ifndef NATIVE_KERNEL_H
+#define NATIVE_KERNEL_H
+
+#include <cstdint>
+
+namespace native {
+
+/**
+ * Switches the kernel to a simulated clock. Simulated time only moves when every task (including the main thread)
+ * is blocked, it then jumps straight to the nearest timeout. Must be called before any task is created.
+ * @note Tasks must only block through the FreeRTOS calls, blocking in the OS (sockets, sleep) stalls the clock.
+ */
+void useSimulatedClock();
+
+bool simulatedClock();
+
+/**
+ * @return Microseconds since boot on the kernel clock.
+ */
+uint64_t kernelMicros();
+
+}
+
+#endif //NATIVE_KERNEL_H
@@ -0,0 +1,26 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#ifndef NATIVE_PREFERENCES_H
+#define NATIVE_PREFERENCES_H
+
+#include "Arduino.h"
+
+/**
+ * NVS stand-in, the values live in memory for the life of the process and are shared by every instance (like the
+ * NVS partition is).
+ */
+class Preferences {
+    String name;
+    bool read_only = true;
+    bool started = false;
+public:
+    bool begin(const char* name, bool read_only = false, const char* partition_label = nullptr);
+    void end();
+    size_t putBytes(const char* key, const void* value, size_t length);
+    size_t getBytes(const char* key, void* buffer, size_t max_length);
+    bool remove(const char* key);
+};
+
+#endif //NATIVE_PREFERENCES_H
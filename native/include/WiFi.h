@@ -0,0 +1,134 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#ifndef NATIVE_WIFI_H
+#define NATIVE_WIFI_H
+
+#include "Arduino.h"
+
+#include <atomic>
+
+typedef enum {
+    WL_NO_SHIELD = 255,
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_SCAN_COMPLETED = 2,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum {
+    WIFI_MODE_NULL = 0,
+    WIFI_MODE_STA,
+    WIFI_MODE_AP,
+    WIFI_MODE_APSTA
+} wifi_mode_t;
+
+class IPAddress {
+    uint8_t octets[4] = {};
+public:
+    IPAddress() = default;
+    IPAddress(uint8_t first, uint8_t second, uint8_t third, uint8_t fourth) : octets{first, second, third, fourth} {}
+    explicit IPAddress(const uint32_t address) { memcpy(octets, &address, sizeof(octets)); }
+    uint8_t operator[](const int index) const { return octets[index]; }
+    operator uint32_t() const {
+        uint32_t address;
+        memcpy(&address, octets, sizeof(address));
+        return address;
+    }
+    String toString() const;
+};
+
+/**
+ * The host is always "connected", the network stack belongs to the OS. The addressing reported is a made up lease.
+ */
+class WiFiClass {
+    uint8_t bssid[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+public:
+    bool mode(wifi_mode_t mode) { return true; }
+    wl_status_t begin(const char* ssid, const char* password = nullptr, int32_t channel = 0,
+                      const uint8_t* bssid = nullptr, bool connect = true) { return WL_CONNECTED; }
+    bool config(IPAddress local_ip, IPAddress gateway, IPAddress subnet, IPAddress dns1 = IPAddress(),
+                IPAddress dns2 = IPAddress()) { return true; }
+    bool disconnect(bool wifi_off = false, bool erase_ap = false) { return true; }
+    bool setAutoReconnect(bool auto_reconnect) { return true; }
+    bool setHostname(const char* hostname) { return true; }
+    String macAddress() { return String("00:00:00:00:00:00"); }
+    uint8_t waitForConnectResult(unsigned long timeout = 60000) { return WL_CONNECTED; }
+    IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+    IPAddress gatewayIP() { return IPAddress(127, 0, 0, 1); }
+    IPAddress subnetMask() { return IPAddress(255, 0, 0, 0); }
+    IPAddress dnsIP(uint8_t index = 0) { return IPAddress(127, 0, 0, 53); }
+    uint8_t* BSSID() { return bssid; }
+    int32_t channel() { return 1; }
+    int8_t RSSI() { return -40; }
+    int hostByName(const char* host, IPAddress& result);
+    wl_status_t status() { return WL_CONNECTED; }
+};
+
+extern WiFiClass WiFi;
+
+/**
+ * Blocking TCP client on a POSIX socket.
+ * @note Blocks in the OS, so it stalls the simulated clock (see NativeKernel.h), use it with the real time kernel.
+ */
+class WiFiClient {
+    std::atomic<int> fd{-1}; // Replaced by connect() on one task while another task may be reading
+    uint32_t timeout = 1000; // (ms) Read timeout, same default as the Arduino Stream
+    uint8_t rx_buffer[1436] = {}; // Like the ESP32 WiFiClient, reads are served from one TCP segment at a time
+    size_t rx_head = 0;
+    size_t rx_tail = 0;
+
+    bool fillBuffer(int timeout_ms);
+public:
+    WiFiClient() = default;
+    WiFiClient(const WiFiClient&) = delete;
+    WiFiClient& operator=(const WiFiClient&) = delete;
+    ~WiFiClient() { stop(); }
+    int connect(const char* host, uint16_t port);
+    size_t write(const char* buffer, size_t size);
+    size_t write(const uint8_t* buffer, size_t size);
+    uint8_t connected();
+    int available();
+    int read();
+    size_t readBytesUntil(char terminator, uint8_t* buffer, size_t length);
+    size_t readBytes(uint8_t* buffer, size_t length);
+    void setTimeout(uint32_t seconds); // (s) Like the ESP32 WiFiClient, not the millisecond Stream::setTimeout
+    int setNoDelay(bool no_delay);
+    void stop();
+};
+
+/**
+ * Non-blocking IPv4 UDP socket, parsePacket() returns 0 right away when nothing has arrived like on the ESP32.
+ */
+class WiFiUDP {
+    int fd = -1;
+    uint8_t tx_buffer[1460] = {};
+    size_t tx_length = 0;
+    IPAddress tx_ip;
+    uint16_t tx_port = 0;
+    uint8_t rx_buffer[1460] = {};
+    size_t rx_length = 0;
+    size_t rx_position = 0;
+    IPAddress remote_ip;
+    uint16_t remote_port = 0;
+public:
+    WiFiUDP() = default;
+    WiFiUDP(const WiFiUDP&) = delete;
+    WiFiUDP& operator=(const WiFiUDP&) = delete;
+    ~WiFiUDP() { stop(); }
+    uint8_t begin(uint16_t port);
+    void stop();
+    int beginPacket(IPAddress ip, uint16_t port);
+    size_t write(const uint8_t* buffer, size_t size);
+    int endPacket();
+    int parsePacket();
+    int read(uint8_t* buffer, size_t length);
+    IPAddress remoteIP() const { return remote_ip; }
+    uint16_t remotePort() const { return remote_port; }
+};
+
+#endif //NATIVE_WIFI_H
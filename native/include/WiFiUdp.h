@@ -0,0 +1,10 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#ifndef NATIVE_WIFIUDP_H
+#define NATIVE_WIFIUDP_H
+
+#include "WiFi.h" // WiFiUDP lives next to WiFiClient
+
+#endif //NATIVE_WIFIUDP_H
@@ -0,0 +1,17 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#ifndef NATIVE_WIRE_H
+#define NATIVE_WIRE_H
+
+#include "Arduino.h"
+
+class TwoWire {
+public:
+    bool begin() { return true; }
+};
+
+extern TwoWire Wire;
+
+#endif //NATIVE_WIRE_H
@@ -0,0 +1,10 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#ifndef NATIVE_ESP32_HAL_H
+#define NATIVE_ESP32_HAL_H
+
+#include "Arduino.h"
+
+#endif //NATIVE_ESP32_HAL_H
@@ -0,0 +1,56 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#ifndef NATIVE_ESP_OTA_OPS_H
+#define NATIVE_ESP_OTA_OPS_H
+
+#include "Arduino.h"
+
+// The two app partitions are files in $NATIVE_OTA_DIR (default ./native_ota), next to an otadata file holding the
+// boot partition and the image states. Like a bootloader built without rollback support, a new image is never
+// marked invalid at boot. $NATIVE_OTA_WRITE_KBPS, if set, slows esp_ota_write down to that many KB/s like real flash.
+
+#define OTA_SIZE_UNKNOWN 0xffffffff
+
+#define ESP_ERR_OTA_BASE               0x1500
+#define ESP_ERR_OTA_PARTITION_CONFLICT (ESP_ERR_OTA_BASE + 0x01)
+#define ESP_ERR_OTA_VALIDATE_FAILED    (ESP_ERR_OTA_BASE + 0x03)
+#define ESP_ERR_OTA_ROLLBACK_FAILED    (ESP_ERR_OTA_BASE + 0x05)
+
+typedef uint32_t esp_ota_handle_t;
+
+typedef struct {
+    uint32_t address;
+    uint32_t size;
+    char label[17];
+} esp_partition_t;
+
+typedef enum {
+    ESP_OTA_IMG_NEW             = 0x0U,
+    ESP_OTA_IMG_PENDING_VERIFY  = 0x1U,
+    ESP_OTA_IMG_VALID           = 0x2U,
+    ESP_OTA_IMG_INVALID         = 0x3U,
+    ESP_OTA_IMG_ABORTED         = 0x4U,
+    ESP_OTA_IMG_UNDEFINED       = 0xFFFFFFFFU,
+} esp_ota_img_states_t;
+
+const esp_partition_t* esp_ota_get_running_partition();
+
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start_from);
+
+esp_err_t esp_ota_begin(const esp_partition_t* partition, size_t image_size, esp_ota_handle_t* out_handle);
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void* data, size_t size);
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle);
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle);
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition);
+
+esp_err_t esp_ota_get_state_partition(const esp_partition_t* partition, esp_ota_img_states_t* out_state);
+
+esp_err_t esp_ota_mark_app_invalid_rollback_and_reboot();
+
+#endif //NATIVE_ESP_OTA_OPS_H
@@ -0,0 +1,17 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#ifndef NATIVE_ESP_PARTITION_H
+#define NATIVE_ESP_PARTITION_H
+
+#include "esp_ota_ops.h" // esp_partition_t and the partition files live with the OTA stand-ins
+
+// Reads an app partition file (see esp_ota_ops.h), past the end of the image reads erased flash (0xFF).
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst, size_t size);
+
+// SHA-256 of the image in an app partition file: the hash esptool appended if the image carries one, otherwise of the
+// whole file. ESP_ERR_NOT_FOUND if the partition was never written.
+esp_err_t esp_partition_get_sha256(const esp_partition_t* partition, uint8_t* sha_256);
+
+#endif //NATIVE_ESP_PARTITION_H
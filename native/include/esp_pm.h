@@ -0,0 +1,43 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#ifndef NATIVE_ESP_PM_H
+#define NATIVE_ESP_PM_H
+
+#include "Arduino.h"
+
+// The host clock never scales and never sleeps, these keep the lock bookkeeping of ESP-IDF so an unbalanced
+// release is caught (ESP_ERR_INVALID_STATE, and a line on stderr) and native::pmLocksHeld() can check that nothing
+// is left held.
+
+typedef enum {
+    ESP_PM_CPU_FREQ_MAX,
+    ESP_PM_APB_FREQ_MAX,
+    ESP_PM_NO_LIGHT_SLEEP,
+} esp_pm_lock_type_t;
+
+typedef struct {
+    int max_freq_mhz;
+    int min_freq_mhz;
+    bool light_sleep_enable;
+} esp_pm_config_esp32_t;
+
+typedef struct esp_pm_lock* esp_pm_lock_handle_t;
+
+esp_err_t esp_pm_configure(const void* config);
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lock_type, int arg, const char* name, esp_pm_lock_handle_t* out_handle);
+esp_err_t esp_pm_lock_delete(esp_pm_lock_handle_t handle);
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle);
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle);
+
+namespace native {
+
+/**
+ * @return The acquisitions not released yet, over every lock.
+ */
+int pmLocksHeld();
+
+}
+
+#endif //NATIVE_ESP_PM_H
@@ -0,0 +1,50 @@
+//
+// Created by Jay on 10/18/2026.
+//
+// Host stand-in for the FreeRTOS primitives the firmware uses. Tasks are threads, ticks are milliseconds and
+// the clock is either real time or simulated (see NativeKernel.h).
+//
+
+#ifndef NATIVE_FREERTOS_H
+#define NATIVE_FREERTOS_H
+
+#include <cstdint>
+#include <mutex>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+struct NativeTask;
+struct NativeQueue;
+struct NativeSemaphore;
+
+typedef NativeTask* TaskHandle_t;
+typedef NativeQueue* QueueHandle_t;
+typedef NativeSemaphore* SemaphoreHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define pdTRUE  1
+#define pdFALSE 0
+#define pdPASS  pdTRUE
+#define pdFAIL  pdFALSE
+#define errQUEUE_FULL 0
+
+#define portMAX_DELAY      static_cast<TickType_t>(0xffffffffUL)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms)  static_cast<TickType_t>(ms)
+#define configMAX_PRIORITIES 25
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+#define portYIELD_FROM_ISR(woken) (void)(woken)
+
+// A critical section masks interrupts and spins against the other core on the ESP32, a mutex on the host
+struct portMUX_TYPE {
+    std::mutex mutex;
+};
+
+#define portMUX_INITIALIZER_UNLOCKED {}
+#define portENTER_CRITICAL(mux) (mux)->mutex.lock()
+#define portEXIT_CRITICAL(mux)  (mux)->mutex.unlock()
+
+#endif //NATIVE_FREERTOS_H
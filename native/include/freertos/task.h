@@ -0,0 +1,49 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#ifndef NATIVE_TASK_H
+#define NATIVE_TASK_H
+
+#include "FreeRTOS.h"
+
+typedef enum {
+    eRunning = 0,
+    eReady,
+    eBlocked,
+    eSuspended,
+    eDeleted,
+    eInvalid
+} eTaskState;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_depth,
+    void* parameters, UBaseType_t priority, TaskHandle_t* created_task, BaseType_t core_id);
+
+inline BaseType_t xTaskCreate(TaskFunction_t function, const char* name, const uint32_t stack_depth,
+    void* parameters, const UBaseType_t priority, TaskHandle_t* created_task) {
+    return xTaskCreatePinnedToCore(function, name, stack_depth, parameters, priority, created_task, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task);
+
+TickType_t xTaskGetTickCount();
+
+void vTaskDelay(TickType_t ticks);
+
+BaseType_t xTaskDelayUntil(TickType_t* previous_wake_time, TickType_t period);
+
+TaskHandle_t xTaskGetCurrentTaskHandle();
+
+const char* pcTaskGetName(TaskHandle_t task);
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higher_priority_task_woken);
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait);
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+#define taskYIELD() vTaskDelay(0)
+
+#endif //NATIVE_TASK_H
@@ -0,0 +1,31 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#ifndef NATIVE_MBEDTLS_SHA256_H
+#define NATIVE_MBEDTLS_SHA256_H
+
+#include <cstddef>
+#include <cstdint>
+
+// The mbedtls 2.x calls ESP-IDF 4.4 ships, a plain software SHA-256 (native/src/Sha256.cpp). Only SHA-256, is224
+// must be 0.
+
+typedef struct {
+    uint32_t total[2];
+    uint32_t state[8];
+    uint8_t buffer[64];
+    int is224;
+} mbedtls_sha256_context;
+
+void mbedtls_sha256_init(mbedtls_sha256_context* ctx);
+
+void mbedtls_sha256_free(mbedtls_sha256_context* ctx);
+
+int mbedtls_sha256_starts_ret(mbedtls_sha256_context* ctx, int is224);
+
+int mbedtls_sha256_update_ret(mbedtls_sha256_context* ctx, const unsigned char* input, size_t ilen);
+
+int mbedtls_sha256_finish_ret(mbedtls_sha256_context* ctx, unsigned char output[32]);
+
+#endif //NATIVE_MBEDTLS_SHA256_H
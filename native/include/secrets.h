@@ -0,0 +1,30 @@
+//
+// Created by Jay on 10/18/2026.
+//
+// Fallback for host builds, the real secrets.h is used if it is on the include path.
+//
+
+#ifndef NATIVE_SECRETS_H
+#define NATIVE_SECRETS_H
+
+#if __has_include_next(<secrets.h>)
+#include_next <secrets.h>
+#endif
+
+#ifndef WIFI_SSID
+#define WIFI_SSID "native"
+#endif
+#ifndef WIFI_PASSWORD
+#define WIFI_PASSWORD ""
+#endif
+#ifndef CENTRAL_HOST
+#define CENTRAL_HOST "127.0.0.1"
+#endif
+#ifndef CENTRAL_PORT
+#define CENTRAL_PORT 47670
+#endif
+#ifndef CENTRAL_UDP_PORT
+#define CENTRAL_UDP_PORT 47671
+#endif
+
+#endif //NATIVE_SECRETS_H
@@ -0,0 +1,27 @@
+//
+// Created by Jay on 10/18/2026.
+//
+// Replaces NetworkInterface.cpp in the simulator, everything the RoomInterface queues for CENTRAL
+// is handed to the simulator instead of a socket.
+//
+
+#include <ControllerInterface/NetworkInterface.h>
+
+#include "Simulator.h"
+
+void NetworkInterface::begin(const char*, const char* device_info, const size_t device_info_length, SemaphoreHandle_t) {
+    simulatorDownlink(device_info, device_info_length);
+}
+
+void NetworkInterface::queue_message(const char* data, const size_t length) const {
+    simulatorDownlink(data, length);
+}
+
+void NetworkInterface::queue_urgent(const char* data, const size_t length, uint32_t) const {
+    simulatorDownlink(data, length);
+}
+
+BaseType_t NetworkInterface::uplink_queue_receive(uplink_message_t* message, const TickType_t ticks_to_wait) const {
+    vTaskDelay(ticks_to_wait); // Commands are executed directly by the simulator
+    return pdFALSE;
+}
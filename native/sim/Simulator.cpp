@@ -0,0 +1,313 @@
+//
+// Created by Jay on 10/18/2026.
+//
+// Time-warp simulator: runs the real Radiator, MotionDetector and EnvironmentSensor (and the RoomInterface above
+// them) on the simulated kernel clock against a thermal model, with CENTRAL's heartbeats, temperature updates and
+// thermostat commands scripted. Everything the satellite would have sent to CENTRAL is checked here.
+//
+// Usage: simulator [--days N] [--seed N] [--step MS] [--motion PER_HOUR] [--valve-stuck HOURS]
+//                  [--outage START_HOURS:MINUTES]... [--script FILE] [--verbose]
+//
+// Script lines are "<seconds> <command json>", the command is executed at that simulated time, e.g.
+//   3600 {"sub_device_id": "Radiator", "event_name": "set_on", "args": [false]}
+//
+
+#include <Arduino.h>
+#include <NativeKernel.h>
+#include <AHT20.h>
+#include <ArduinoJson.h>
+#include <ControllerInterface/RoomInterface.h>
+#include <Devices/EnvironmentSensor.h>
+#include <Devices/MotionDetector.h>
+#include <Devices/Radiator.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Simulator.h"
+#include "ThermalModel.h"
+
+#define SIM_TEMP_UPDATE_INTERVAL 15   // (s) CENTRAL forwards the radiator temperature
+#define SIM_HEARTBEAT_INTERVAL   30   // (s) CENTRAL heartbeat to the radiator
+#define SIM_THERMOSTAT_INTERVAL  60   // (s) CENTRAL thermostat decision
+#define SIM_THERMOSTAT_LOW       67.0f // (F) Room temperature CENTRAL turns the radiator on at
+#define SIM_THERMOSTAT_HIGH      69.0f // (F) Room temperature CENTRAL turns the radiator off at
+
+namespace {
+
+struct Options {
+    double days = 1;
+    unsigned seed = 1;
+    uint32_t step = 1000; // (ms) Thermal model and script resolution
+    double motion_per_hour = 4;
+    double valve_stuck_hours = -1;
+    std::vector<std::pair<double, double>> outages; // (s) Heartbeat outages, start and end
+    const char* script = nullptr;
+    bool verbose = false;
+};
+
+struct ScriptedCommand {
+    double time; // (s)
+    std::string command;
+};
+
+/**
+ * Collects everything the satellite sends to CENTRAL.
+ */
+struct Recorder {
+    std::mutex mutex;
+    uint32_t state_updates = 0;
+    uint64_t downlink_bytes = 0;
+    std::map<std::string, uint32_t> events;
+    std::string radiator_state = "";
+    double radiator_state_since = 0;
+    std::map<std::string, double> time_in_state;
+    std::map<std::string, uint32_t> transitions;
+    std::vector<std::pair<double, std::string>> faults;
+    bool heartbeat_fault = false;
+    uint32_t heartbeat_faults = 0;
+
+    void downlink(const char* data, const size_t length) {
+        JsonDocument document;
+        if (deserializeJson(document, data, length)) return;
+        const double now = millis() / 1000.0;
+        std::lock_guard<std::mutex> lock(mutex);
+        downlink_bytes += length;
+        const char* type = document["msg_type"] | "";
+        if (strcmp(type, "event") == 0) {
+            events[document["event"] | "unknown"]++;
+        } else if (strcmp(type, "state_update") == 0) {
+            state_updates++;
+            const auto radiator = document["objects"]["Radiator"];
+            const char* state = radiator["state"]["state"] | "";
+            if (!radiator["health"].isNull()) {
+                const bool fault = radiator["health"]["fault"] | false;
+                if (fault && !heartbeat_fault) heartbeat_faults++;
+                heartbeat_fault = fault;
+            }
+            if (state[0] != '\0' && radiator_state != state) {
+                changeState(now, state);
+            }
+        }
+    }
+
+    void changeState(const double now, const std::string& state) {
+        if (!radiator_state.empty()) {
+            time_in_state[radiator_state] += now - radiator_state_since;
+            transitions[radiator_state + " -> " + state]++;
+        }
+        if (state.find("FAULT") != std::string::npos) faults.emplace_back(now, state);
+        radiator_state = state;
+        radiator_state_since = now;
+    }
+
+    void finish(const double now) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!radiator_state.empty()) time_in_state[radiator_state] += now - radiator_state_since;
+        radiator_state_since = now;
+    }
+};
+
+Recorder recorder;
+
+/**
+ * Wall clock cost of delivering an input to the radiator, which evaluates its state machine.
+ */
+struct EvaluationStats {
+    std::vector<uint32_t> samples; // (ns)
+
+    void add(const std::chrono::steady_clock::duration duration) {
+        samples.push_back(static_cast<uint32_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()));
+    }
+
+    void print() {
+        if (samples.empty()) return;
+        std::sort(samples.begin(), samples.end());
+        uint64_t total = 0;
+        for (const auto sample : samples) total += sample;
+        printf("FSM inputs:       %zu, mean %llu ns, p50 %u ns, p99 %u ns, max %u ns\n", samples.size(),
+            static_cast<unsigned long long>(total / samples.size()), samples[samples.size() / 2],
+            samples[samples.size() * 99 / 100], samples.back());
+    }
+};
+
+EvaluationStats evaluation_stats;
+
+RoomInterface room_interface;
+
+void execute(const std::string& command) {
+    auto* parsed = room_interface.eventParse(command.c_str());
+    if (parsed == nullptr) {
+        printf("[%10.1f] Failed to parse command: %s\n", millis() / 1000.0, command.c_str());
+        return;
+    }
+    const bool radiator_input = strcmp(parsed->objectName, Radiator::OBJECT_NAME) == 0;
+    const auto start = std::chrono::steady_clock::now();
+    room_interface.eventExecute(parsed);
+    if (radiator_input) evaluation_stats.add(std::chrono::steady_clock::now() - start);
+}
+
+void radiatorCommand(const char* event, const char* argument) {
+    char command[128];
+    snprintf(command, sizeof(command),
+        R"({"sub_device_id": "%s", "event_name": "%s", "args": [%s]})", Radiator::OBJECT_NAME, event, argument);
+    execute(command);
+}
+
+bool parseOptions(const int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const std::string option = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (option == "--days" && has_value) options.days = atof(argv[++i]);
+        else if (option == "--seed" && has_value) options.seed = strtoul(argv[++i], nullptr, 10);
+        else if (option == "--step" && has_value) options.step = strtoul(argv[++i], nullptr, 10);
+        else if (option == "--motion" && has_value) options.motion_per_hour = atof(argv[++i]);
+        else if (option == "--valve-stuck" && has_value) options.valve_stuck_hours = atof(argv[++i]);
+        else if (option == "--outage" && has_value) {
+            double start_hours = 0, minutes = 0;
+            if (sscanf(argv[++i], "%lf:%lf", &start_hours, &minutes) != 2) return false;
+            options.outages.emplace_back(start_hours * 3600, start_hours * 3600 + minutes * 60);
+        }
+        else if (option == "--script" && has_value) options.script = argv[++i];
+        else if (option == "--verbose") options.verbose = true;
+        else return false;
+    }
+    return options.days > 0 && options.step > 0;
+}
+
+bool loadScript(const char* path, std::vector<ScriptedCommand>& script) {
+    std::ifstream file(path);
+    if (!file) return false;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        const auto split = line.find(' ');
+        if (split == std::string::npos) continue;
+        script.push_back({atof(line.substr(0, split).c_str()), line.substr(split + 1)});
+    }
+    std::stable_sort(script.begin(), script.end(),
+        [](const ScriptedCommand& a, const ScriptedCommand& b) { return a.time < b.time; });
+    return true;
+}
+
+float fahrenheitToCelsius(const float fahrenheit) {
+    return (fahrenheit - 32.0f) * 5.0f / 9.0f;
+}
+
+}
+
+void simulatorDownlink(const char* data, const size_t length) {
+    recorder.downlink(data, length);
+}
+
+int main(const int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        fprintf(stderr, "Usage: %s [--days N] [--seed N] [--step MS] [--motion PER_HOUR] [--valve-stuck HOURS]"
+                        " [--outage START_HOURS:MINUTES]... [--script FILE] [--verbose]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    std::vector<ScriptedCommand> script;
+    if (options.script != nullptr && !loadScript(options.script, script)) {
+        fprintf(stderr, "Failed to read script %s\n", options.script);
+        return EXIT_FAILURE;
+    }
+    native::useSimulatedClock();
+    native::setSerialOutput(options.verbose ? stdout : nullptr);
+    if (options.verbose) logBegin();
+
+    ThermalModel model;
+    std::mt19937 random(options.seed);
+    std::normal_distribution<float> sensor_noise(0.0f, 0.2f);
+    std::exponential_distribution<double> motion_gap(options.motion_per_hour / 3600.0);
+    std::uniform_real_distribution<double> motion_length(10, 90);
+    native::setEnvironment(fahrenheitToCelsius(model.room), 40.0f);
+
+    // Same device setup as main.cpp, then the interface loop starts the device tasks.
+    new Radiator(&room_interface);
+    new MotionDetector(&room_interface);
+    new EnvironmentSensor(&room_interface);
+    xTaskCreate(RoomInterface::interfaceLoop, "interfaceLoop", 8192, &room_interface, 2, nullptr);
+
+    const double end = options.days * 86400.0;
+    const double step = options.step / 1000.0;
+    double next_temp_update = 0, next_heartbeat = 0, next_thermostat = 0;
+    double next_motion = options.motion_per_hour > 0 ? motion_gap(random) : end, motion_end = -1;
+    bool commanded_on = false;
+    size_t next_script = 0;
+
+    const auto wall_start = std::chrono::steady_clock::now();
+    for (double now = 0; now < end; now += step) {
+        vTaskDelay(pdMS_TO_TICKS(options.step)); // Everything else runs while the main thread is blocked
+        const float outside = ThermalModel::outsideTemperature(static_cast<float>(fmod(now / 86400.0, 1.0)));
+        model.valve_stuck = options.valve_stuck_hours >= 0 && now >= options.valve_stuck_hours * 3600;
+        model.step(static_cast<float>(step), digitalRead(RADIATOR_PIN) == LOW, outside);
+        native::setEnvironment(fahrenheitToCelsius(model.room + sensor_noise(random)), 40.0f);
+
+        if (now >= next_temp_update) {
+            char temperature[16];
+            snprintf(temperature, sizeof(temperature), "%.2f", model.radiator + sensor_noise(random));
+            radiatorCommand("radiator_temp_update", temperature);
+            next_temp_update += SIM_TEMP_UPDATE_INTERVAL;
+        }
+        if (now >= next_heartbeat) {
+            const bool outage = std::any_of(options.outages.begin(), options.outages.end(),
+                [now](const std::pair<double, double>& outage) { return outage.first <= now && now < outage.second; });
+            if (!outage) radiatorCommand("heartbeat", "");
+            next_heartbeat += SIM_HEARTBEAT_INTERVAL;
+        }
+        if (now >= next_thermostat) {
+            if (!commanded_on && model.room < SIM_THERMOSTAT_LOW) {
+                commanded_on = true;
+                radiatorCommand("set_on", "true");
+            } else if (commanded_on && model.room > SIM_THERMOSTAT_HIGH) {
+                commanded_on = false;
+                radiatorCommand("set_on", "false");
+            }
+            next_thermostat += SIM_THERMOSTAT_INTERVAL;
+        }
+        if (now >= next_motion) {
+            native::gpioDrive(MOTION_DETECTOR_PIN, HIGH);
+            motion_end = now + motion_length(random);
+            next_motion = motion_end + motion_gap(random);
+        }
+        if (motion_end >= 0 && now >= motion_end) {
+            native::gpioDrive(MOTION_DETECTOR_PIN, LOW);
+            motion_end = -1;
+        }
+        while (next_script < script.size() && script[next_script].time <= now) {
+            execute(script[next_script++].command);
+        }
+    }
+    const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    recorder.finish(millis() / 1000.0);
+
+    std::lock_guard<std::mutex> lock(recorder.mutex);
+    printf("Simulated %.2f days in %.2f s (%.0fx real time)\n", options.days, wall, end / wall);
+    printf("Room:             %.1f F, radiator %.1f F at the end\n", model.room, model.radiator);
+    printf("Downlinks:        %u state updates, %llu bytes total\n", recorder.state_updates,
+        static_cast<unsigned long long>(recorder.downlink_bytes));
+    for (const auto& event : recorder.events) {
+        printf("Event:            %-28s %u\n", event.first.c_str(), event.second);
+    }
+    for (const auto& state : recorder.time_in_state) {
+        printf("Radiator state:   %-28s %6.2f%%\n", state.first.c_str(), 100.0 * state.second / end);
+    }
+    for (const auto& transition : recorder.transitions) {
+        printf("Transition:       %-36s %u\n", transition.first.c_str(), transition.second);
+    }
+    printf("Heartbeat faults: %u\n", recorder.heartbeat_faults);
+    for (const auto& fault : recorder.faults) {
+        printf("Fault:            %-28s at %.1f h\n", fault.second.c_str(), fault.first / 3600.0);
+    }
+    evaluation_stats.print();
+    fflush(stdout);
+    _Exit(recorder.faults.empty() ? EXIT_SUCCESS : 2); // The device tasks never return
+}
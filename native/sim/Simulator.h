@@ -0,0 +1,15 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <cstddef>
+
+/**
+ * Called for every message the RoomInterface would have sent to CENTRAL.
+ */
+void simulatorDownlink(const char* data, size_t length);
+
+#endif //SIMULATOR_H
@@ -0,0 +1,24 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#include "ThermalModel.h"
+
+#include <algorithm>
+#include <cmath>
+
+void ThermalModel::step(const float seconds, const bool valve_commanded_open, const float outside) {
+    if (!valve_stuck) {
+        const float travel = seconds / MODEL_VALVE_TRAVEL;
+        valve = valve_commanded_open ? std::min(1.0f, valve + travel) : std::max(0.0f, valve - travel);
+    }
+    const float radiator_change = valve * MODEL_HEAT_RATE * (MODEL_SUPPLY_TEMP - radiator)
+        - MODEL_RADIATOR_LOSS * (radiator - room);
+    const float room_change = MODEL_ROOM_GAIN * (radiator - room) - MODEL_ROOM_LOSS * (room - outside);
+    radiator += radiator_change * seconds;
+    room += room_change * seconds;
+}
+
+float ThermalModel::outsideTemperature(const float day_fraction) {
+    return 35.0f + 10.0f * std::sin(2.0f * static_cast<float>(M_PI) * (day_fraction - 0.5f));
+}
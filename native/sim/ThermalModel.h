@@ -0,0 +1,44 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#ifndef THERMALMODEL_H
+#define THERMALMODEL_H
+
+#define MODEL_SUPPLY_TEMP     180.0f   // (F) Steam/water supply temperature
+#define MODEL_VALVE_TRAVEL    120.0f   // (s) Time for the valve actuator to fully open or close
+#define MODEL_HEAT_RATE       0.002f   // (1/s) Radiator heating from the supply when fully open
+#define MODEL_RADIATOR_LOSS   0.002f   // (1/s) Radiator losses into the room
+#define MODEL_ROOM_GAIN       0.00005f // (1/s) Room heating from the radiator
+#define MODEL_ROOM_LOSS       0.00002f // (1/s) Room losses to the outside
+
+/**
+ * First order thermal model of a radiator with a slow valve actuator heating a single room.
+ */
+class ThermalModel {
+
+public:
+
+    float valve = 0;         // Valve position, 0 closed and 1 fully open
+    float radiator = 68.0f;  // (F)
+    float room = 66.0f;      // (F)
+    bool valve_stuck = false; // Simulated valve failure, the valve stops moving
+
+    /**
+     * @param seconds Time since the last step.
+     * @param valve_commanded_open State of the valve output.
+     * @param outside (F) Outside temperature.
+     */
+    void step(float seconds, bool valve_commanded_open, float outside);
+
+    /**
+     * @param day_fraction Time of day, 0 is midnight.
+     * @return (F) Outside temperature, coldest at 6 AM.
+     */
+    static float outsideTemperature(float day_fraction);
+
+};
+
+
+
+#endif //THERMALMODEL_H
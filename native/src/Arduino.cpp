@@ -0,0 +1,228 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#include <Arduino.h>
+#include <AHT20.h>
+#include <Wire.h>
+#include <esp_ota_ops.h>
+#include <NativeKernel.h>
+
+#include <cstdarg>
+#include <mutex>
+
+HardwareSerial Serial;
+TwoWire Wire;
+
+namespace {
+
+struct Pin {
+    uint8_t mode = INPUT;
+    uint8_t value = LOW;
+    void (*isr)() = nullptr;
+    void (*isr_with_arg)(void*) = nullptr;
+    void* isr_arg = nullptr;
+    int isr_mode = 0;
+};
+
+Pin pins[NATIVE_GPIO_COUNT];
+std::mutex pin_mutex;
+
+FILE* serial_output = stdout;
+
+struct Environment {
+    float temperature = 20.0f;
+    float humidity = 40.0f;
+    bool connected = true;
+} environment;
+std::mutex environment_mutex;
+
+}
+
+unsigned long millis() {
+    return static_cast<unsigned long>(native::kernelMicros() / 1000);
+}
+
+unsigned long micros() {
+    return static_cast<uint32_t>(native::kernelMicros()); // Wraps like the 32 bit counter on the ESP32
+}
+
+void delay(const uint32_t ms) {
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+void pinMode(const uint8_t pin, const uint8_t mode) {
+    if (pin >= NATIVE_GPIO_COUNT) return;
+    std::lock_guard<std::mutex> lock(pin_mutex);
+    pins[pin].mode = mode;
+    if (mode == INPUT_PULLUP) pins[pin].value = HIGH;
+}
+
+void digitalWrite(const uint8_t pin, const uint8_t value) {
+    if (pin >= NATIVE_GPIO_COUNT) return;
+    std::lock_guard<std::mutex> lock(pin_mutex);
+    pins[pin].value = value ? HIGH : LOW;
+}
+
+int digitalRead(const uint8_t pin) {
+    if (pin >= NATIVE_GPIO_COUNT) return LOW;
+    std::lock_guard<std::mutex> lock(pin_mutex);
+    return pins[pin].value;
+}
+
+void analogWrite(const uint8_t pin, const int value) {
+    digitalWrite(pin, value > 0 ? HIGH : LOW);
+}
+
+void attachInterrupt(const uint8_t pin, void (*isr)(), const int mode) {
+    if (pin >= NATIVE_GPIO_COUNT) return;
+    std::lock_guard<std::mutex> lock(pin_mutex);
+    pins[pin].isr = isr;
+    pins[pin].isr_with_arg = nullptr;
+    pins[pin].isr_mode = mode;
+}
+
+void attachInterruptArg(const uint8_t pin, void (*isr)(void*), void* arg, const int mode) {
+    if (pin >= NATIVE_GPIO_COUNT) return;
+    std::lock_guard<std::mutex> lock(pin_mutex);
+    pins[pin].isr = nullptr;
+    pins[pin].isr_with_arg = isr;
+    pins[pin].isr_arg = arg;
+    pins[pin].isr_mode = mode;
+}
+
+void ledcSetup(uint8_t channel, double frequency, uint8_t resolution) {}
+
+void ledcAttachPin(uint8_t pin, uint8_t channel) {}
+
+void ledcDetachPin(uint8_t pin) {}
+
+void ledcWrite(uint8_t channel, uint32_t duty) {}
+
+float temperatureRead() {
+    return 45.0f;
+}
+
+uint32_t esp_get_free_heap_size() {
+    return 0; // Meaningless on the host
+}
+
+void esp_restart() {
+    Serial.println("esp_restart() called, exiting");
+    fflush(nullptr);
+    _Exit(EXIT_FAILURE);
+}
+
+void configTime(long gmtOffset_sec, int daylightOffset_sec,
+                const char* server1, const char* server2, const char* server3) {
+    // The host clock is already synchronized
+}
+
+const char* esp_err_to_name(const esp_err_t code) {
+    switch (code) {
+        case ESP_OK:                return "ESP_OK";
+        case ESP_FAIL:              return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:        return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:   return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:  return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:     return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_OTA_PARTITION_CONFLICT: return "ESP_ERR_OTA_PARTITION_CONFLICT";
+        case ESP_ERR_OTA_VALIDATE_FAILED:    return "ESP_ERR_OTA_VALIDATE_FAILED";
+        case ESP_ERR_OTA_ROLLBACK_FAILED:    return "ESP_ERR_OTA_ROLLBACK_FAILED";
+        default:                    return "UNKNOWN ERROR";
+    }
+}
+
+int HardwareSerial::printf(const char* format, ...) {
+    if (serial_output == nullptr) return 0;
+    va_list args;
+    va_start(args, format);
+    const int written = vfprintf(serial_output, format, args);
+    va_end(args);
+    return written;
+}
+
+size_t HardwareSerial::print(const char* string) {
+    if (serial_output == nullptr) return 0;
+    return fputs(string, serial_output) < 0 ? 0 : strlen(string);
+}
+
+size_t HardwareSerial::println(const char* string) {
+    if (serial_output == nullptr) return 0;
+    const auto written = print(string);
+    fputc('\n', serial_output);
+    return written + 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, const size_t size) {
+    if (serial_output == nullptr) return 0;
+    return fwrite(buffer, 1, size, serial_output);
+}
+
+void HardwareSerial::flush() {
+    if (serial_output != nullptr) fflush(serial_output);
+}
+
+bool AHT20::begin() {
+    return isConnected();
+}
+
+bool AHT20::isConnected() {
+    std::lock_guard<std::mutex> lock(environment_mutex);
+    return environment.connected;
+}
+
+bool AHT20::available() {
+    return isConnected();
+}
+
+float AHT20::getTemperature() {
+    std::lock_guard<std::mutex> lock(environment_mutex);
+    return environment.temperature;
+}
+
+float AHT20::getHumidity() {
+    std::lock_guard<std::mutex> lock(environment_mutex);
+    return environment.humidity;
+}
+
+namespace native {
+
+void gpioDrive(const uint8_t pin, const uint8_t value) {
+    if (pin >= NATIVE_GPIO_COUNT) return;
+    void (*isr)() = nullptr;
+    void (*isr_with_arg)(void*) = nullptr;
+    void* isr_arg = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(pin_mutex);
+        auto& state = pins[pin];
+        const uint8_t level = value ? HIGH : LOW;
+        if (state.value == level) return;
+        state.value = level;
+        if (state.isr_mode == CHANGE ||
+            (state.isr_mode == RISING && level == HIGH) ||
+            (state.isr_mode == FALLING && level == LOW)) {
+            isr = state.isr;
+            isr_with_arg = state.isr_with_arg;
+            isr_arg = state.isr_arg;
+        }
+    }
+    // Called without the pin lock, the ISR may block on the kernel
+    if (isr != nullptr) isr();
+    if (isr_with_arg != nullptr) isr_with_arg(isr_arg);
+}
+
+void setSerialOutput(FILE* output) {
+    serial_output = output;
+}
+
+void setEnvironment(const float temperature, const float humidity, const bool connected) {
+    std::lock_guard<std::mutex> lock(environment_mutex);
+    environment.temperature = temperature;
+    environment.humidity = humidity;
+    environment.connected = connected;
+}
+
+}
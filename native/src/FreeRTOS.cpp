@@ -0,0 +1,385 @@
+//
+// Created by Jay on 10/18/2026.
+//
+// Every task is a thread and every blocking call goes through block(), which waits on one kernel wide condition
+// variable. With the simulated clock, time only advances once every thread is blocked: the clock then jumps to the
+// nearest timeout, so hours of mostly idle firmware run in milliseconds.
+//
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <NativeKernel.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+// Host frames are larger than Xtensa ones (and much larger with the sanitizers), so task stacks are scaled up.
+// The fleet env shrinks them, it runs hundreds of satellites in one process.
+#ifndef NATIVE_STACK_SCALE
+#define NATIVE_STACK_SCALE 16
+#endif
+#ifndef NATIVE_STACK_MIN
+#define NATIVE_STACK_MIN   (256 * 1024)
+#endif
+#define NATIVE_STACK_PAINT 0xA5 // Same fill byte FreeRTOS uses for its high water mark
+
+struct NativeTask {
+    std::string name;
+    uint32_t notifications = 0;
+    uint32_t stack_depth = 0;      // (bytes) As requested, the host stack is much larger
+    uint8_t* stack = nullptr;      // Lowest address of the host stack
+    uint8_t* stack_entry = nullptr; // Stack pointer when the task function was entered
+};
+
+struct NativeQueue {
+    size_t length;
+    size_t item_size;
+    std::vector<uint8_t> storage; // Items are copied in and out like FreeRTOS does, nothing is allocated per item
+    size_t head = 0;
+    size_t count = 0;
+};
+
+struct NativeSemaphore {
+    UBaseType_t count;
+    UBaseType_t max_count;
+};
+
+namespace {
+
+constexpr uint64_t FOREVER = UINT64_MAX;
+
+struct TaskExit {}; // Thrown by vTaskDelete(nullptr) to unwind the calling task
+
+struct Waiter {
+    const std::function<bool()>* ready;
+    uint64_t deadline;
+};
+
+struct Kernel {
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool simulated = false;
+    uint64_t simulated_now = 0;
+    int running = 1; // Threads not blocked in the kernel, the main thread counts as one
+    std::list<Waiter*> waiters;
+    const std::chrono::steady_clock::time_point boot = std::chrono::steady_clock::now();
+
+    uint64_t now() const {
+        if (simulated) return simulated_now;
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - boot).count();
+    }
+};
+
+Kernel& kernel() {
+    static Kernel instance; // Function local so it exists during static initialization
+    return instance;
+}
+
+NativeTask main_task{"main"};
+thread_local NativeTask* current_task = &main_task;
+
+uint64_t deadlineAfter(const Kernel& k, const TickType_t ticks) {
+    if (ticks == portMAX_DELAY) return FOREVER;
+    return k.now() + static_cast<uint64_t>(ticks) * portTICK_PERIOD_MS * 1000;
+}
+
+/**
+ * Moves the simulated clock to the nearest timeout if nothing can run.
+ * @note Called with the kernel lock held.
+ */
+void advance(Kernel& k) {
+    if (!k.simulated || k.running > 0) return;
+    uint64_t next = FOREVER;
+    for (const auto* waiter : k.waiters) {
+        if ((*waiter->ready)() || waiter->deadline <= k.simulated_now) {
+            k.changed.notify_all(); // Someone can already run
+            return;
+        }
+        next = std::min(next, waiter->deadline);
+    }
+    if (next == FOREVER) return; // Every task waits forever, nothing will ever happen again
+    k.simulated_now = next;
+    k.changed.notify_all();
+}
+
+/**
+ * Blocks the calling thread until ready() returns true or the deadline passes.
+ * @return The final value of ready(), the caller consumes whatever it waited for before releasing the lock.
+ */
+bool block(std::unique_lock<std::mutex>& lock, const std::function<bool()>& ready, const uint64_t deadline) {
+    auto& k = kernel();
+    if (ready()) return true;
+    if (deadline <= k.now()) return false;
+    Waiter waiter{&ready, deadline};
+    k.waiters.push_back(&waiter);
+    k.running--;
+    advance(k);
+    while (!ready() && k.now() < deadline) {
+        if (k.simulated || deadline == FOREVER) {
+            k.changed.wait(lock);
+        } else {
+            k.changed.wait_until(lock, k.boot + std::chrono::microseconds(deadline));
+        }
+    }
+    k.waiters.remove(&waiter);
+    k.running++;
+    return ready();
+}
+
+}
+
+namespace native {
+
+void useSimulatedClock() {
+    auto& k = kernel();
+    std::lock_guard<std::mutex> lock(k.mutex);
+    k.simulated = true;
+}
+
+bool simulatedClock() {
+    return kernel().simulated;
+}
+
+uint64_t kernelMicros() {
+    auto& k = kernel();
+    std::lock_guard<std::mutex> lock(k.mutex);
+    return k.now();
+}
+
+}
+
+namespace {
+
+/**
+ * Fills the unused part of the task's stack so the high water mark can be found later.
+ */
+__attribute__((no_sanitize_address, noinline))
+void paintStack(NativeTask* task) {
+    task->stack_entry = static_cast<uint8_t*>(__builtin_frame_address(0));
+    const auto* here = reinterpret_cast<uint8_t*>(&task);
+    memset(task->stack, NATIVE_STACK_PAINT, here - task->stack - 512); // Leave this frame alone
+}
+
+__attribute__((no_sanitize_address))
+size_t unpaintedBytes(const NativeTask* task) {
+    const uint8_t* lowest = task->stack;
+    while (lowest < task->stack_entry && *lowest == NATIVE_STACK_PAINT) lowest++;
+    return task->stack_entry - lowest;
+}
+
+struct TaskStart {
+    NativeTask* task;
+    TaskFunction_t function;
+    void* parameters;
+};
+
+void* taskEntry(void* argument) {
+    const auto start = *static_cast<TaskStart*>(argument);
+    delete static_cast<TaskStart*>(argument);
+    current_task = start.task;
+    paintStack(start.task);
+    try {
+        start.function(start.parameters);
+    } catch (const TaskExit&) {}
+    auto& k = kernel();
+    std::lock_guard<std::mutex> lock(k.mutex);
+    k.running--;
+    advance(k);
+    return nullptr;
+}
+
+}
+
+BaseType_t xTaskCreatePinnedToCore(const TaskFunction_t function, const char* name, const uint32_t stack_depth,
+                                   void* parameters, UBaseType_t priority, TaskHandle_t* created_task,
+                                   BaseType_t core_id) {
+    auto* task = new NativeTask{name};
+    const size_t stack_size = std::max<size_t>(static_cast<size_t>(stack_depth) * NATIVE_STACK_SCALE,
+                                               NATIVE_STACK_MIN);
+    task->stack_depth = stack_depth;
+    task->stack = static_cast<uint8_t*>(aligned_alloc(4096, stack_size)); // Never freed, like the task itself
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstack(&attributes, task->stack, stack_size);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    auto& k = kernel();
+    {
+        std::lock_guard<std::mutex> lock(k.mutex);
+        k.running++; // Counted from creation so the clock can't move before the thread gets going
+    }
+    pthread_t thread;
+    const auto result = pthread_create(&thread, &attributes, taskEntry, new TaskStart{task, function, parameters});
+    pthread_attr_destroy(&attributes);
+    if (result != 0) {
+        std::lock_guard<std::mutex> lock(k.mutex);
+        k.running--;
+        return pdFAIL;
+    }
+    if (created_task != nullptr) *created_task = task;
+    return pdPASS;
+}
+
+/**
+ * @return Bytes of the requested stack_depth never used, as on the ESP32.
+ * @note Only tasks the kernel created have a painted stack, the main thread reports 0.
+ */
+UBaseType_t uxTaskGetStackHighWaterMark(const TaskHandle_t task) {
+    const auto* target = task == nullptr ? current_task : task;
+    if (target->stack == nullptr) return 0;
+    const auto used = unpaintedBytes(target);
+    return used >= target->stack_depth ? 0 : target->stack_depth - used;
+}
+
+void vTaskDelete(const TaskHandle_t task) {
+    if (task == nullptr || task == current_task) throw TaskExit();
+    // Deleting another task isn't supported, the firmware never does it.
+}
+
+TickType_t xTaskGetTickCount() {
+    return static_cast<TickType_t>(native::kernelMicros() / 1000 / portTICK_PERIOD_MS);
+}
+
+void vTaskDelay(const TickType_t ticks) {
+    auto& k = kernel();
+    std::unique_lock<std::mutex> lock(k.mutex);
+    static const std::function<bool()> never = [] { return false; };
+    block(lock, never, deadlineAfter(k, ticks));
+}
+
+BaseType_t xTaskDelayUntil(TickType_t* previous_wake_time, const TickType_t period) {
+    const TickType_t wake_time = *previous_wake_time + period;
+    const TickType_t now = xTaskGetTickCount();
+    *previous_wake_time = wake_time;
+    if (static_cast<int32_t>(wake_time - now) <= 0) return pdFALSE; // Already late
+    vTaskDelay(wake_time - now);
+    return pdTRUE;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return current_task;
+}
+
+const char* pcTaskGetName(const TaskHandle_t task) {
+    return (task == nullptr ? current_task : task)->name.c_str();
+}
+
+BaseType_t xTaskNotifyGive(const TaskHandle_t task) {
+    auto& k = kernel();
+    std::lock_guard<std::mutex> lock(k.mutex);
+    task->notifications++;
+    k.changed.notify_all();
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(const TaskHandle_t task, BaseType_t* higher_priority_task_woken) {
+    xTaskNotifyGive(task);
+    if (higher_priority_task_woken != nullptr) *higher_priority_task_woken = pdFALSE;
+}
+
+uint32_t ulTaskNotifyTake(const BaseType_t clear_on_exit, const TickType_t ticks_to_wait) {
+    auto& k = kernel();
+    std::unique_lock<std::mutex> lock(k.mutex);
+    auto* task = current_task;
+    const std::function<bool()> ready = [task] { return task->notifications > 0; };
+    if (!block(lock, ready, deadlineAfter(k, ticks_to_wait))) return 0;
+    const auto value = task->notifications;
+    task->notifications = clear_on_exit ? 0 : value - 1;
+    return value;
+}
+
+QueueHandle_t xQueueCreate(const UBaseType_t length, const UBaseType_t item_size) {
+    return new NativeQueue{length, item_size, std::vector<uint8_t>(length * item_size)};
+}
+
+void vQueueDelete(const QueueHandle_t queue) {
+    delete queue;
+}
+
+BaseType_t xQueueSend(const QueueHandle_t queue, const void* item, const TickType_t ticks_to_wait) {
+    auto& k = kernel();
+    std::unique_lock<std::mutex> lock(k.mutex);
+    const std::function<bool()> ready = [queue] { return queue->count < queue->length; };
+    if (!block(lock, ready, deadlineAfter(k, ticks_to_wait))) return errQUEUE_FULL;
+    const auto* bytes = static_cast<const uint8_t*>(item);
+    memcpy(&queue->storage[(queue->head + queue->count) % queue->length * queue->item_size], bytes, queue->item_size);
+    queue->count++;
+    k.changed.notify_all();
+    return pdPASS;
+}
+
+BaseType_t xQueueSendFromISR(const QueueHandle_t queue, const void* item, BaseType_t* higher_priority_task_woken) {
+    if (higher_priority_task_woken != nullptr) *higher_priority_task_woken = pdFALSE;
+    return xQueueSend(queue, item, 0);
+}
+
+BaseType_t xQueueReceive(const QueueHandle_t queue, void* buffer, const TickType_t ticks_to_wait) {
+    auto& k = kernel();
+    std::unique_lock<std::mutex> lock(k.mutex);
+    const std::function<bool()> ready = [queue] { return queue->count > 0; };
+    if (!block(lock, ready, deadlineAfter(k, ticks_to_wait))) return pdFALSE;
+    memcpy(buffer, &queue->storage[queue->head * queue->item_size], queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    k.changed.notify_all();
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(const QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(kernel().mutex);
+    return queue->count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(const QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(kernel().mutex);
+    return queue->length - queue->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return new NativeSemaphore{1, 1};
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return new NativeSemaphore{0, 1};
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(const UBaseType_t max_count, const UBaseType_t initial_count) {
+    return new NativeSemaphore{initial_count, max_count};
+}
+
+void vSemaphoreDelete(const SemaphoreHandle_t semaphore) {
+    delete semaphore;
+}
+
+BaseType_t xSemaphoreTake(const SemaphoreHandle_t semaphore, const TickType_t ticks_to_wait) {
+    auto& k = kernel();
+    std::unique_lock<std::mutex> lock(k.mutex);
+    const std::function<bool()> ready = [semaphore] { return semaphore->count > 0; };
+    if (!block(lock, ready, deadlineAfter(k, ticks_to_wait))) return pdFALSE;
+    semaphore->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(const SemaphoreHandle_t semaphore) {
+    auto& k = kernel();
+    std::lock_guard<std::mutex> lock(k.mutex);
+    if (semaphore->count >= semaphore->max_count) return pdFALSE;
+    semaphore->count++;
+    k.changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(const SemaphoreHandle_t semaphore, BaseType_t* higher_priority_task_woken) {
+    if (higher_priority_task_woken != nullptr) *higher_priority_task_woken = pdFALSE;
+    return xSemaphoreGive(semaphore);
+}
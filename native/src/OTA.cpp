@@ -0,0 +1,231 @@
+//
+// Created by Jay on 10/18/2026.
+//
+// File backed esp_ota_*, esp_partition_read and esp_partition_get_sha256 (see esp_ota_ops.h). Only the calls the firmware makes are implemented.
+//
+
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <mbedtls/sha256.h>
+
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <sys/stat.h>
+
+#define NATIVE_OTA_PARTITION_COUNT 2
+#define NATIVE_OTA_IMAGE_MAGIC 0xE9 // First byte of every ESP32 app image
+#define NATIVE_OTA_HASH_APPENDED 23 // Offset of the image header flag set when esptool appended the image's SHA-256
+
+namespace {
+
+// Same layout as partitions.csv
+esp_partition_t partitions[NATIVE_OTA_PARTITION_COUNT] = {
+    {0x10000, 1500 * 1024, "ota_0"},
+    {0x187000, 1500 * 1024, "ota_1"},
+};
+
+struct Update {
+    const esp_partition_t* partition;
+    FILE* file;
+    size_t written;
+};
+
+struct OtaState {
+    std::mutex mutex;
+    bool loaded = false;
+    std::string directory;
+    size_t boot = 0;
+    size_t running = 0;
+    esp_ota_img_states_t states[NATIVE_OTA_PARTITION_COUNT] = {ESP_OTA_IMG_UNDEFINED, ESP_OTA_IMG_UNDEFINED};
+    std::map<esp_ota_handle_t, Update> updates;
+    esp_ota_handle_t next_handle = 1;
+
+    std::string path(const char* name) const {
+        return directory + "/" + name;
+    }
+
+    /**
+     * Reads otadata on first use, the partition it points at is the one "running".
+     * @note Called with the mutex held.
+     */
+    void load() {
+        if (loaded) return;
+        loaded = true;
+        const char* configured = getenv("NATIVE_OTA_DIR");
+        directory = configured != nullptr ? configured : "native_ota";
+        mkdir(directory.c_str(), 0755);
+        FILE* otadata = fopen(path("otadata").c_str(), "r");
+        if (otadata == nullptr) return;
+        unsigned boot_index = 0, first = ESP_OTA_IMG_UNDEFINED, second = ESP_OTA_IMG_UNDEFINED;
+        if (fscanf(otadata, "%u %x %x", &boot_index, &first, &second) == 3 && boot_index < NATIVE_OTA_PARTITION_COUNT) {
+            boot = running = boot_index;
+            states[0] = static_cast<esp_ota_img_states_t>(first);
+            states[1] = static_cast<esp_ota_img_states_t>(second);
+        }
+        fclose(otadata);
+    }
+
+    /**
+     * @note Called with the mutex held.
+     */
+    esp_err_t save() const {
+        FILE* otadata = fopen(path("otadata").c_str(), "w");
+        if (otadata == nullptr) return ESP_FAIL;
+        fprintf(otadata, "%zu %x %x\n", boot, states[0], states[1]);
+        fclose(otadata);
+        return ESP_OK;
+    }
+
+    static int indexOf(const esp_partition_t* partition) {
+        for (int i = 0; i < NATIVE_OTA_PARTITION_COUNT; i++) {
+            if (partition == &partitions[i]) return i;
+        }
+        return -1;
+    }
+};
+
+OtaState& ota() {
+    static OtaState instance;
+    std::lock_guard<std::mutex> lock(instance.mutex);
+    instance.load();
+    return instance;
+}
+
+}
+
+const esp_partition_t* esp_ota_get_running_partition() {
+    return &partitions[ota().running];
+}
+
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start_from) {
+    auto& state = ota();
+    const int index = start_from == nullptr ? static_cast<int>(state.running) : OtaState::indexOf(start_from);
+    if (index < 0) return nullptr;
+    return &partitions[(index + 1) % NATIVE_OTA_PARTITION_COUNT];
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t* partition, const size_t image_size, esp_ota_handle_t* out_handle) {
+    auto& state = ota();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    const int index = OtaState::indexOf(partition);
+    if (index < 0 || out_handle == nullptr) return ESP_ERR_INVALID_ARG;
+    if (index == static_cast<int>(state.running)) return ESP_ERR_OTA_PARTITION_CONFLICT;
+    if (image_size != OTA_SIZE_UNKNOWN && image_size > partition->size) return ESP_ERR_INVALID_SIZE;
+    FILE* file = fopen(state.path(partition->label).c_str(), "wb"); // Truncating is the erase
+    if (file == nullptr) return ESP_FAIL;
+    state.states[index] = ESP_OTA_IMG_UNDEFINED;
+    *out_handle = state.next_handle++;
+    state.updates[*out_handle] = {partition, file, 0};
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(const esp_ota_handle_t handle, const void* data, const size_t size) {
+    static const char* write_rate = getenv("NATIVE_OTA_WRITE_KBPS");
+    if (write_rate != nullptr && atoi(write_rate) > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(size * 1000000ull / (atoi(write_rate) * 1024ull)));
+    }
+    auto& state = ota();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    const auto update = state.updates.find(handle);
+    if (update == state.updates.end()) return ESP_ERR_INVALID_ARG;
+    auto& current = update->second;
+    if (size == 0) return ESP_OK;
+    if (current.written == 0 && static_cast<const uint8_t*>(data)[0] != NATIVE_OTA_IMAGE_MAGIC) {
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    if (current.written + size > current.partition->size) return ESP_ERR_INVALID_SIZE;
+    if (fwrite(data, 1, size, current.file) != size) return ESP_FAIL;
+    current.written += size;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_end(const esp_ota_handle_t handle) {
+    auto& state = ota();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    const auto update = state.updates.find(handle);
+    if (update == state.updates.end()) return ESP_ERR_NOT_FOUND;
+    const auto current = update->second;
+    state.updates.erase(update);
+    if (fclose(current.file) != 0) return ESP_FAIL;
+    if (current.written == 0) return ESP_ERR_OTA_VALIDATE_FAILED;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_abort(const esp_ota_handle_t handle) {
+    auto& state = ota();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    const auto update = state.updates.find(handle);
+    if (update == state.updates.end()) return ESP_ERR_NOT_FOUND;
+    fclose(update->second.file);
+    state.updates.erase(update);
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition) {
+    auto& state = ota();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    const int index = OtaState::indexOf(partition);
+    if (index < 0) return ESP_ERR_INVALID_ARG;
+    struct stat image = {};
+    if (index != static_cast<int>(state.running) &&
+        (stat(state.path(partition->label).c_str(), &image) != 0 || image.st_size == 0)) {
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    state.boot = index;
+    state.states[index] = ESP_OTA_IMG_NEW;
+    return state.save();
+}
+
+esp_err_t esp_ota_get_state_partition(const esp_partition_t* partition, esp_ota_img_states_t* out_state) {
+    auto& state = ota();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    const int index = OtaState::indexOf(partition);
+    if (index < 0 || out_state == nullptr) return ESP_ERR_INVALID_ARG;
+    *out_state = state.states[index];
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_invalid_rollback_and_reboot() {
+    return ESP_ERR_OTA_ROLLBACK_FAILED; // No rollback support, see esp_ota_ops.h
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, const size_t src_offset, void* dst, const size_t size) {
+    auto& state = ota();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (OtaState::indexOf(partition) < 0 || dst == nullptr) return ESP_ERR_INVALID_ARG;
+    if (src_offset + size > partition->size) return ESP_ERR_INVALID_SIZE;
+    memset(dst, 0xFF, size);
+    FILE* file = fopen(state.path(partition->label).c_str(), "rb");
+    if (file == nullptr) return ESP_OK; // Never written, all erased
+    if (fseek(file, static_cast<long>(src_offset), SEEK_SET) == 0) fread(dst, 1, size, file);
+    fclose(file);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_get_sha256(const esp_partition_t* partition, uint8_t* sha_256) {
+    auto& state = ota();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (OtaState::indexOf(partition) < 0 || sha_256 == nullptr) return ESP_ERR_INVALID_ARG;
+    FILE* file = fopen(state.path(partition->label).c_str(), "rb");
+    if (file == nullptr) return ESP_ERR_NOT_FOUND;
+    std::string image;
+    char chunk[4096];
+    for (size_t read; (read = fread(chunk, 1, sizeof(chunk), file)) > 0;) image.append(chunk, read);
+    fclose(file);
+    // Like the bootloader, the appended hash covers the image in front of it
+    auto length = image.size();
+    if (length > NATIVE_OTA_HASH_APPENDED + 32 && static_cast<uint8_t>(image[0]) == NATIVE_OTA_IMAGE_MAGIC &&
+        image[NATIVE_OTA_HASH_APPENDED] == 1) {
+        length -= 32;
+    }
+    mbedtls_sha256_context sha256;
+    mbedtls_sha256_init(&sha256);
+    mbedtls_sha256_starts_ret(&sha256, 0);
+    mbedtls_sha256_update_ret(&sha256, reinterpret_cast<const unsigned char*>(image.data()), length);
+    mbedtls_sha256_finish_ret(&sha256, sha_256);
+    mbedtls_sha256_free(&sha256);
+    return ESP_OK;
+}
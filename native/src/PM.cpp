@@ -0,0 +1,67 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#include <esp_pm.h>
+
+#include <atomic>
+
+struct esp_pm_lock {
+    esp_pm_lock_type_t type;
+    const char* name;
+    std::atomic<int> count{0};
+};
+
+namespace {
+
+std::atomic<int> held{0};
+
+}
+
+esp_err_t esp_pm_configure(const void* config) {
+    return config == nullptr ? ESP_ERR_INVALID_ARG : ESP_OK;
+}
+
+esp_err_t esp_pm_lock_create(const esp_pm_lock_type_t lock_type, const int arg, const char* name,
+                             esp_pm_lock_handle_t* out_handle) {
+    if (out_handle == nullptr) return ESP_ERR_INVALID_ARG;
+    auto* lock = new esp_pm_lock();
+    lock->type = lock_type;
+    lock->name = name != nullptr ? name : "";
+    *out_handle = lock;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_delete(const esp_pm_lock_handle_t handle) {
+    if (handle == nullptr) return ESP_ERR_INVALID_ARG;
+    if (handle->count.load() != 0) {
+        fprintf(stderr, "esp_pm: lock \"%s\" deleted while held\n", handle->name);
+        return ESP_ERR_INVALID_STATE;
+    }
+    delete handle;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_acquire(const esp_pm_lock_handle_t handle) {
+    if (handle == nullptr) return ESP_ERR_INVALID_ARG;
+    handle->count.fetch_add(1);
+    held.fetch_add(1);
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_release(const esp_pm_lock_handle_t handle) {
+    if (handle == nullptr) return ESP_ERR_INVALID_ARG;
+    auto count = handle->count.load();
+    do {
+        if (count == 0) {
+            fprintf(stderr, "esp_pm: lock \"%s\" released more often than acquired\n", handle->name);
+            return ESP_ERR_INVALID_STATE;
+        }
+    } while (!handle->count.compare_exchange_weak(count, count - 1));
+    held.fetch_sub(1);
+    return ESP_OK;
+}
+
+int native::pmLocksHeld() {
+    return held.load();
+}
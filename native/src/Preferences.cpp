@@ -0,0 +1,55 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#include <Preferences.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::mutex store_mutex;
+std::map<std::string, std::vector<uint8_t>> store; // "namespace/key"
+
+std::string storeKey(const String& name, const char* key) {
+    return std::string(name.c_str()) + "/" + key;
+}
+
+}
+
+bool Preferences::begin(const char* name, const bool read_only, const char* partition_label) {
+    this->name = String(name);
+    this->read_only = read_only;
+    started = true;
+    return true;
+}
+
+void Preferences::end() {
+    started = false;
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, const size_t length) {
+    if (!started || read_only) return 0;
+    const std::lock_guard<std::mutex> lock(store_mutex);
+    const auto* bytes = static_cast<const uint8_t*>(value);
+    store[storeKey(name, key)].assign(bytes, bytes + length);
+    return length;
+}
+
+size_t Preferences::getBytes(const char* key, void* buffer, const size_t max_length) {
+    if (!started) return 0;
+    const std::lock_guard<std::mutex> lock(store_mutex);
+    const auto entry = store.find(storeKey(name, key));
+    if (entry == store.end() || entry->second.size() > max_length) return 0;
+    memcpy(buffer, entry->second.data(), entry->second.size());
+    return entry->second.size();
+}
+
+bool Preferences::remove(const char* key) {
+    if (!started || read_only) return false;
+    const std::lock_guard<std::mutex> lock(store_mutex);
+    return store.erase(storeKey(name, key)) > 0;
+}
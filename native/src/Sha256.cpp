@@ -0,0 +1,115 @@
+//
+// Created by Jay on 10/18/2026.
+//
+// FIPS 180-4 SHA-256 behind the mbedtls calls (see mbedtls/sha256.h).
+//
+
+#include <mbedtls/sha256.h>
+
+#include <cstring>
+
+namespace {
+
+const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+uint32_t rotate(const uint32_t value, const int bits) {
+    return value >> bits | value << (32 - bits);
+}
+
+void process(mbedtls_sha256_context* ctx, const uint8_t* block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = static_cast<uint32_t>(block[i * 4]) << 24 | block[i * 4 + 1] << 16 | block[i * 4 + 2] << 8 |
+            block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        const auto s0 = rotate(w[i - 15], 7) ^ rotate(w[i - 15], 18) ^ w[i - 15] >> 3;
+        const auto s1 = rotate(w[i - 2], 17) ^ rotate(w[i - 2], 19) ^ w[i - 2] >> 10;
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = ctx->state[0], b = ctx->state[1], c = ctx->state[2], d = ctx->state[3];
+    uint32_t e = ctx->state[4], f = ctx->state[5], g = ctx->state[6], h = ctx->state[7];
+    for (int i = 0; i < 64; i++) {
+        const auto t1 = h + (rotate(e, 6) ^ rotate(e, 11) ^ rotate(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+        const auto t2 = (rotate(a, 2) ^ rotate(a, 13) ^ rotate(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    ctx->state[0] += a;
+    ctx->state[1] += b;
+    ctx->state[2] += c;
+    ctx->state[3] += d;
+    ctx->state[4] += e;
+    ctx->state[5] += f;
+    ctx->state[6] += g;
+    ctx->state[7] += h;
+}
+
+}
+
+void mbedtls_sha256_init(mbedtls_sha256_context* ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+void mbedtls_sha256_free(mbedtls_sha256_context* ctx) {
+    if (ctx != nullptr) memset(ctx, 0, sizeof(*ctx));
+}
+
+int mbedtls_sha256_starts_ret(mbedtls_sha256_context* ctx, const int is224) {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    if (is224 != 0) return -1; // Not needed on the host
+    memcpy(ctx->state, initial, sizeof(initial));
+    ctx->total[0] = ctx->total[1] = 0;
+    ctx->is224 = 0;
+    return 0;
+}
+
+int mbedtls_sha256_update_ret(mbedtls_sha256_context* ctx, const unsigned char* input, size_t ilen) {
+    auto used = ctx->total[0] & 63;
+    ctx->total[0] += ilen;
+    if (ctx->total[0] < ilen) ctx->total[1]++;
+    if (used > 0 && used + ilen >= 64) { // Complete the buffered block first
+        const auto fill = 64 - used;
+        memcpy(ctx->buffer + used, input, fill);
+        process(ctx, ctx->buffer);
+        input += fill;
+        ilen -= fill;
+        used = 0;
+    }
+    for (; ilen >= 64; input += 64, ilen -= 64) process(ctx, input);
+    memcpy(ctx->buffer + used, input, ilen);
+    return 0;
+}
+
+int mbedtls_sha256_finish_ret(mbedtls_sha256_context* ctx, unsigned char output[32]) {
+    const uint64_t bits = (static_cast<uint64_t>(ctx->total[1]) << 32 | ctx->total[0]) << 3;
+    const auto used = ctx->total[0] & 63;
+    uint8_t padding[72] = {0x80};
+    const auto padding_length = (used < 56 ? 56 : 120) - used;
+    for (int i = 0; i < 8; i++) padding[padding_length + i] = static_cast<uint8_t>(bits >> (56 - i * 8));
+    mbedtls_sha256_update_ret(ctx, padding, padding_length + 8);
+    for (int i = 0; i < 8; i++) {
+        output[i * 4] = static_cast<uint8_t>(ctx->state[i] >> 24);
+        output[i * 4 + 1] = static_cast<uint8_t>(ctx->state[i] >> 16);
+        output[i * 4 + 2] = static_cast<uint8_t>(ctx->state[i] >> 8);
+        output[i * 4 + 3] = static_cast<uint8_t>(ctx->state[i]);
+    }
+    return 0;
+}
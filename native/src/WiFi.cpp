@@ -0,0 +1,245 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#include <WiFi.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+WiFiClass WiFi;
+
+String IPAddress::toString() const {
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", octets[0], octets[1], octets[2], octets[3]);
+    return String(buffer);
+}
+
+int WiFiClient::connect(const char* host, const uint16_t port) {
+    stop();
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
+    if (getaddrinfo(host, service, &hints, &addresses) != 0) return 0;
+    int socket_fd = -1;
+    for (auto* address = addresses; address != nullptr; address = address->ai_next) {
+        socket_fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (socket_fd < 0) continue;
+        if (::connect(socket_fd, address->ai_addr, address->ai_addrlen) == 0) break;
+        close(socket_fd);
+        socket_fd = -1;
+    }
+    freeaddrinfo(addresses);
+    if (socket_fd < 0) return 0;
+    fd = socket_fd;
+    return 1;
+}
+
+size_t WiFiClient::write(const char* buffer, const size_t size) {
+    return write(reinterpret_cast<const uint8_t*>(buffer), size);
+}
+
+size_t WiFiClient::write(const uint8_t* buffer, const size_t size) {
+    const int socket_fd = fd;
+    if (socket_fd < 0) return 0;
+    size_t written = 0;
+    while (written < size) {
+        const auto sent = send(socket_fd, buffer + written, size - written, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) {
+            stop();
+            break;
+        }
+        written += sent;
+    }
+    return written;
+}
+
+uint8_t WiFiClient::connected() {
+    const int socket_fd = fd;
+    if (socket_fd < 0) return 0;
+    uint8_t peek;
+    const auto result = recv(socket_fd, &peek, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (result == 0 || (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        stop(); // Closed by the other side
+        return 0;
+    }
+    return 1;
+}
+
+int WiFiClient::available() {
+    if (rx_head == rx_tail) fillBuffer(0);
+    return static_cast<int>(rx_tail - rx_head);
+}
+
+int WiFiClient::read() {
+    if (rx_head == rx_tail && !fillBuffer(static_cast<int>(timeout))) return -1;
+    return rx_buffer[rx_head++];
+}
+
+/**
+ * Reads until the terminator (which is consumed but not stored), the buffer is full or nothing arrives
+ * within the timeout.
+ * @return The number of bytes stored in the buffer.
+ */
+size_t WiFiClient::readBytesUntil(const char terminator, uint8_t* buffer, const size_t length) {
+    size_t stored = 0;
+    while (stored < length) {
+        if (rx_head == rx_tail && !fillBuffer(static_cast<int>(timeout))) break;
+        const auto* start = rx_buffer + rx_head;
+        const auto count = std::min(rx_tail - rx_head, length - stored);
+        const auto* found = static_cast<const uint8_t*>(memchr(start, static_cast<uint8_t>(terminator), count));
+        const auto copy = found != nullptr ? static_cast<size_t>(found - start) : count;
+        memcpy(buffer + stored, start, copy);
+        stored += copy;
+        rx_head += copy;
+        if (found != nullptr) {
+            rx_head++; // Consume the terminator
+            break;
+        }
+    }
+    return stored;
+}
+
+/**
+ * Reads until the buffer is full or nothing arrives within the timeout.
+ * @return The number of bytes stored in the buffer.
+ */
+size_t WiFiClient::readBytes(uint8_t* buffer, const size_t length) {
+    size_t stored = 0;
+    while (stored < length) {
+        if (rx_head == rx_tail && !fillBuffer(static_cast<int>(timeout))) break;
+        const auto count = std::min(rx_tail - rx_head, length - stored);
+        memcpy(buffer + stored, rx_buffer + rx_head, count);
+        stored += count;
+        rx_head += count;
+    }
+    return stored;
+}
+
+/**
+ * Waits up to timeout_ms for data and reads whatever the socket has into the receive buffer.
+ * @return True if the buffer holds data.
+ */
+bool WiFiClient::fillBuffer(const int timeout_ms) {
+    rx_head = rx_tail = 0;
+    while (true) {
+        const int socket_fd = fd;
+        if (socket_fd < 0) return false;
+        pollfd poll_fd = {socket_fd, POLLIN, 0};
+        const auto ready = poll(&poll_fd, 1, timeout_ms);
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready <= 0) return false; // Timed out
+        const auto received = recv(socket_fd, rx_buffer, sizeof(rx_buffer), 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) {
+            stop(); // Closed by the other side
+            return false;
+        }
+        rx_tail = received;
+        return true;
+    }
+}
+
+void WiFiClient::setTimeout(const uint32_t seconds) {
+    timeout = seconds * 1000;
+}
+
+int WiFiClient::setNoDelay(const bool no_delay) {
+    const int socket_fd = fd;
+    if (socket_fd < 0) return 0;
+    const int value = no_delay ? 1 : 0;
+    return setsockopt(socket_fd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value)) == 0 ? 1 : 0;
+}
+
+void WiFiClient::stop() {
+    const int socket_fd = fd.exchange(-1);
+    if (socket_fd >= 0) close(socket_fd);
+}
+
+int WiFiClass::hostByName(const char* host, IPAddress& result) {
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    addrinfo* addresses = nullptr;
+    if (getaddrinfo(host, nullptr, &hints, &addresses) != 0 || addresses == nullptr) return 0;
+    const auto* address = reinterpret_cast<const sockaddr_in*>(addresses->ai_addr);
+    result = IPAddress(static_cast<uint32_t>(address->sin_addr.s_addr));
+    freeaddrinfo(addresses);
+    return 1;
+}
+
+uint8_t WiFiUDP::begin(const uint16_t port) {
+    stop();
+    const int socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (socket_fd < 0) return 0;
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(socket_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(socket_fd);
+        return 0;
+    }
+    fd = socket_fd;
+    return 1;
+}
+
+void WiFiUDP::stop() {
+    if (fd >= 0) close(fd);
+    fd = -1;
+}
+
+int WiFiUDP::beginPacket(const IPAddress ip, const uint16_t port) {
+    tx_ip = ip;
+    tx_port = port;
+    tx_length = 0;
+    return fd >= 0 ? 1 : 0;
+}
+
+size_t WiFiUDP::write(const uint8_t* buffer, const size_t size) {
+    const auto count = std::min(size, sizeof(tx_buffer) - tx_length);
+    memcpy(tx_buffer + tx_length, buffer, count);
+    tx_length += count;
+    return count;
+}
+
+int WiFiUDP::endPacket() {
+    if (fd < 0) return 0;
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = static_cast<uint32_t>(tx_ip);
+    address.sin_port = htons(tx_port);
+    const auto sent = sendto(fd, tx_buffer, tx_length, 0, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    tx_length = 0;
+    return sent >= 0 ? 1 : 0;
+}
+
+int WiFiUDP::parsePacket() {
+    rx_length = rx_position = 0;
+    if (fd < 0) return 0;
+    sockaddr_in address = {};
+    socklen_t address_length = sizeof(address);
+    const auto received = recvfrom(fd, rx_buffer, sizeof(rx_buffer), MSG_DONTWAIT,
+        reinterpret_cast<sockaddr*>(&address), &address_length);
+    if (received <= 0) return 0;
+    rx_length = received;
+    remote_ip = IPAddress(static_cast<uint32_t>(address.sin_addr.s_addr));
+    remote_port = ntohs(address.sin_port);
+    return static_cast<int>(rx_length);
+}
+
+int WiFiUDP::read(uint8_t* buffer, const size_t length) {
+    const auto count = std::min(length, rx_length - rx_position);
+    memcpy(buffer, rx_buffer + rx_position, count);
+    rx_position += count;
+    return static_cast<int>(count);
+}
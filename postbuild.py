@@ -1,9 +1,15 @@
 import os
+import shutil
 import requests
 
+import OtaDelta
+
 
 class FirmwareMover:
     endpoint = 'http://localhost/satellite_firmware_upload'
+    # Every uploaded image is kept here by the SHA-256 satellites report for it (OtaDelta.image_digest), the base of
+    # the next delta patch. A git hash does not pin an image, two builds of one commit differ.
+    bases = os.path.join(os.getcwd(), '.pio', 'ota_bases')
 
     def __init__(self):
         self.build_version = ''
@@ -36,6 +42,47 @@ class FirmwareMover:
                 print(f"Firmware uploaded successfully: {response.text}")
             else:
                 print(f"Failed to upload firmware: {response.status_code} - {response.text}")
+        self.upload_patch(firmware_file)
+        self.archive_firmware(firmware_file)
+
+    def get_base_digest(self):
+        """The image the satellites run: $OTA_DELTA_BASE (its image_sha256), or the one uploaded last."""
+        if os.environ.get('OTA_DELTA_BASE'):
+            return os.environ['OTA_DELTA_BASE']
+        last = os.path.join(self.bases, 'last')
+        if os.path.isfile(last):
+            with open(last) as f:
+                return f.read().strip()
+        return None
+
+    def upload_patch(self, firmware_file):
+        """Uploads a delta patch against the base build, satellites running another build get the full image."""
+        base_digest = self.get_base_digest()
+        base_file = os.path.join(self.bases, f'{base_digest}.bin') if base_digest else None
+        if base_file is None or not os.path.isfile(base_file):
+            return
+        with open(base_file, 'rb') as f:
+            base = f.read()
+        with open(firmware_file, 'rb') as f:
+            firmware = f.read()
+        if OtaDelta.image_digest(firmware).hex() == base_digest:
+            return
+        patch = OtaDelta.make_patch(base, firmware)
+        print(f"Uploading {len(patch)} byte patch against {base_digest[:8]} ({len(firmware)} byte image)")
+        request = f"{self.endpoint}?version={self.build_version}&branch={self.build_branch}&base={base_digest}"
+        response = requests.post(request, files={'patch': patch})
+        if response.status_code == 200:
+            print(f"Patch uploaded successfully: {response.text}")
+        else:
+            print(f"Failed to upload patch: {response.status_code} - {response.text}")
+
+    def archive_firmware(self, firmware_file):
+        with open(firmware_file, 'rb') as f:
+            digest = OtaDelta.image_digest(f.read()).hex()
+        os.makedirs(self.bases, exist_ok=True)
+        shutil.copyfile(firmware_file, os.path.join(self.bases, f'{digest}.bin'))
+        with open(os.path.join(self.bases, 'last'), 'w') as f:
+            f.write(digest)
 
 
 mover = FirmwareMover()
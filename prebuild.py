@@ -8,7 +8,9 @@ from subprocess import CalledProcessError
 
 import configparser
 
-env.AddPostAction("buildprog", postbuild.upload_firmware)
+# Only the firmware gets uploaded, not the host builds
+if env.subst("$PIOENV") == "nodemcu-32s2":
+    env.AddPostAction("buildprog", postbuild.upload_firmware)
 
 # Add build info to build_info.h so it can be included in the firmware
 
@@ -0,0 +1,52 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#include "BootTimeline.h"
+#include "debug.h"
+
+#include <atomic>
+
+namespace {
+
+constexpr const char* PHASE_NAMES[] = {
+    "setup", "devices_created", "devices_started", "setup_done", "wifi_connected", "link_up",
+};
+
+static_assert(sizeof(PHASE_NAMES) / sizeof(PHASE_NAMES[0]) == BOOT_PHASE_COUNT, "Every boot phase needs a name");
+
+uint32_t phase_times[BOOT_PHASE_COUNT] = {}; // (us) micros() when the phase was reached
+std::atomic<uint32_t> reached{0};            // Bit per phase
+
+}
+
+void bootMark(const boot_phase_t phase) {
+    const uint32_t bit = 1UL << phase;
+    if ((reached.load(std::memory_order_acquire) & bit) != 0) return;
+    phase_times[phase] = micros();
+    reached.fetch_or(bit, std::memory_order_release);
+}
+
+bool bootReached(const boot_phase_t phase) {
+    return (reached.load(std::memory_order_acquire) & (1UL << phase)) != 0;
+}
+
+void bootLog() {
+    for (uint8_t phase = 0; phase < BOOT_PHASE_COUNT; phase++) {
+        if (!bootReached(static_cast<boot_phase_t>(phase))) continue;
+        LOG_INFO("Boot phase %-16s at %8.03fms", PHASE_NAMES[phase], phase_times[phase] / 1000.0f);
+    }
+}
+
+size_t bootReport(char* buffer, const size_t size) {
+    auto length = snprintf(buffer, size, R"({"msg_type":"boot","phases_us":{)");
+    bool first = true;
+    for (uint8_t phase = 0; phase < BOOT_PHASE_COUNT && static_cast<size_t>(length) < size; phase++) {
+        if (!bootReached(static_cast<boot_phase_t>(phase))) continue;
+        length += snprintf(buffer + length, size - length, R"(%s"%s":%lu)", first ? "" : ",", PHASE_NAMES[phase],
+            static_cast<unsigned long>(phase_times[phase]));
+        first = false;
+    }
+    if (static_cast<size_t>(length) < size) length += snprintf(buffer + length, size - length, "}}");
+    return static_cast<size_t>(length) < size ? length : 0;
+}
@@ -0,0 +1,51 @@
+//
+// Created by Jay on 10/18/2026.
+//
+// Boot phase timestamps. The boot is split so the devices never wait on the network: setup() constructs the devices
+// and starts their tasks right away, WiFi and the CENTRAL link come up in the downlink task afterwards. Each phase
+// is marked the first time it is reached, the timeline is logged and sent to CENTRAL as a "boot" message once the
+// link is up.
+//
+
+#ifndef BOOTTIMELINE_H
+#define BOOTTIMELINE_H
+
+#include <Arduino.h>
+
+/**
+ * Roughly in the order a boot reaches them (the device tasks may start after setup() returns), BootTimeline.cpp
+ * keeps the matching names.
+ */
+typedef enum : uint8_t {
+    BOOT_SETUP,             // setup() entered
+    BOOT_DEVICES_CREATED,   // Device constructors done, outputs are in their restored state
+    BOOT_DEVICES_STARTED,   // Device tasks created, local control runs from here on
+    BOOT_SETUP_DONE,        // setup() returned
+    BOOT_WIFI_CONNECTED,
+    BOOT_LINK_UP,           // CENTRAL accepted the connection and the device info
+    BOOT_PHASE_COUNT
+} boot_phase_t;
+
+/**
+ * Records micros() for the phase, only the first call per phase counts.
+ */
+void bootMark(boot_phase_t phase);
+
+/**
+ * @return True once the phase has been marked.
+ */
+bool bootReached(boot_phase_t phase);
+
+/**
+ * Logs every phase reached so far with its time since reset.
+ */
+void bootLog();
+
+/**
+ * Serializes the phases reached so far:
+ * {"msg_type":"boot","phases_us":{"setup":312000,"devices_created":318000,...}}
+ * @return The length written, 0 if the buffer was too small.
+ */
+size_t bootReport(char* buffer, size_t size);
+
+#endif //BOOTTIMELINE_H
@@ -0,0 +1,108 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#include "Clock.h"
+#include "debug.h"
+
+#include <atomic>
+#ifdef NATIVE_BUILD
+#include <chrono>
+#else
+#include <esp_timer.h>
+#endif
+
+namespace {
+
+struct Sample {
+    int64_t offset;
+    uint32_t delay;
+};
+
+Sample samples[CLOCK_SYNC_SAMPLES] = {};
+uint8_t sample_count = 0;
+uint8_t next_sample = 0;
+
+std::atomic<int64_t> best_offset{0};
+std::atomic<uint32_t> best_delay{0};
+std::atomic<bool> synced{false};
+uint32_t last_request = 0; // (ms)
+bool requested = false;
+
+portMUX_TYPE busy = portMUX_INITIALIZER_UNLOCKED;
+
+}
+
+uint64_t clockMicros() {
+#ifdef NATIVE_BUILD
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+#else
+    return esp_timer_get_time();
+#endif
+}
+
+uint32_t clockSyncUntilDue() {
+    if (!requested) return 0;
+    const uint32_t interval = sample_count < CLOCK_SYNC_SAMPLES ? CLOCK_SYNC_RETRY_INTERVAL : CLOCK_SYNC_INTERVAL;
+    const auto elapsed = millis() - last_request;
+    return elapsed < interval ? interval - elapsed : 0;
+}
+
+bool clockSyncDue() {
+    if (clockSyncUntilDue() > 0) return false;
+    requested = true;
+    last_request = millis();
+    return true;
+}
+
+size_t clockSyncRequest(char* buffer, const size_t size) {
+    const auto length = snprintf(buffer, size, R"({"msg_type":"clock_sync","t0":%llu})",
+        static_cast<unsigned long long>(clockMicros()));
+    return length > 0 && static_cast<size_t>(length) < size ? length : 0;
+}
+
+void clockSyncReply(const uint64_t t0, const uint64_t t1, const uint64_t t2, const uint64_t t3) {
+    if (t3 < t0 || t2 < t1) {
+        LOG_WARN("Discarding clock sync reply with times out of order");
+        return;
+    }
+    const auto round_trip = static_cast<int64_t>(t3 - t0) - static_cast<int64_t>(t2 - t1);
+    const Sample sample = {
+        (static_cast<int64_t>(t1 - t0) + static_cast<int64_t>(t2 - t3)) / 2,
+        static_cast<uint32_t>(round_trip > 0 ? round_trip : 0)
+    };
+    portENTER_CRITICAL(&busy);
+    samples[next_sample] = sample;
+    next_sample = (next_sample + 1) % CLOCK_SYNC_SAMPLES;
+    if (sample_count < CLOCK_SYNC_SAMPLES) sample_count++;
+    auto best = samples[0];
+    for (uint8_t i = 1; i < sample_count; i++) {
+        if (samples[i].delay < best.delay) best = samples[i];
+    }
+    portEXIT_CRITICAL(&busy);
+    const bool first = !synced.load();
+    best_offset = best.offset;
+    best_delay = best.delay;
+    synced = true;
+    if (first) {
+        LOG_INFO("Clock synced to CENTRAL, offset %lldus, delay %luus", static_cast<long long>(best.offset),
+            static_cast<unsigned long>(best.delay));
+    } else {
+        LOG_DEBUG("Clock sync sample offset %lldus delay %luus, using offset %lldus",
+            static_cast<long long>(sample.offset), static_cast<unsigned long>(sample.delay),
+            static_cast<long long>(best.offset));
+    }
+}
+
+bool clockSynced() {
+    return synced.load();
+}
+
+int64_t clockOffset() {
+    return best_offset.load();
+}
+
+uint32_t clockDelay() {
+    return best_delay.load();
+}
@@ -0,0 +1,67 @@
+//
+// Created by Jay on 10/18/2026.
+//
+// Monotonic microsecond clock and its offset to CENTRAL's clock. Outbound frames are stamped with clockMicros()
+// ("ts_us", counts from boot, keeps counting through light sleep) and, once synced, with clockOffset()
+// ("clock_offset_us") so CENTRAL can put them on its own time line: server time = ts_us + clock_offset_us.
+//
+// The offset is estimated NTP style over the datalink. The satellite sends {"msg_type":"clock_sync","t0":T0},
+// CENTRAL answers with the event Clock.sync [t0, t1, t2] (its receive and transmit times in us) and the reply is
+// timestamped t3 when it comes off the socket:
+//   offset = ((t1 - t0) + (t2 - t3)) / 2, delay = (t3 - t0) - (t2 - t1)
+// Of the last CLOCK_SYNC_SAMPLES exchanges the one with the lowest delay wins, queueing delays only ever add to
+// the delay and they are what makes an offset wrong.
+//
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <Arduino.h>
+
+#define CLOCK_OBJECT_NAME         "Clock" // CENTRAL addresses the sync replies to this object
+#define CLOCK_SYNC_SAMPLES        8
+#define CLOCK_SYNC_INTERVAL       64000   // (ms) Between exchanges once synced
+#define CLOCK_SYNC_RETRY_INTERVAL 2000    // (ms) Between exchanges until the first reply, and while filling the window
+
+/**
+ * @return (us) Since boot, never goes backwards.
+ */
+uint64_t clockMicros();
+
+/**
+ * @return True if a sync request should be sent now, and counts it as sent.
+ */
+bool clockSyncDue();
+
+/**
+ * @return (ms) Until clockSyncDue() returns true, for the interface loop to wake up in time.
+ */
+uint32_t clockSyncUntilDue();
+
+/**
+ * Serializes a sync request stamped with the current time.
+ * @return The length written, 0 if the buffer was too small.
+ */
+size_t clockSyncRequest(char* buffer, size_t size);
+
+/**
+ * Adds the result of one exchange, all four in us.
+ */
+void clockSyncReply(uint64_t t0, uint64_t t1, uint64_t t2, uint64_t t3);
+
+/**
+ * @return True once a reply has been received.
+ */
+bool clockSynced();
+
+/**
+ * @return (us) CENTRAL's clock minus clockMicros().
+ */
+int64_t clockOffset();
+
+/**
+ * @return (us) Round trip delay of the exchange the offset comes from.
+ */
+uint32_t clockDelay();
+
+#endif //CLOCK_H
@@ -0,0 +1,103 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#include "CommandLimiter.h"
+
+namespace {
+
+/**
+ * Hashes (FNV-1a) the string value of a top level key without parsing the command.
+ * @return 0 if the key isn't there.
+ */
+uint32_t scanValueHash(const char* command, const char* key) {
+    const char* value = strstr(command, key);
+    if (value == nullptr) return 0;
+    value = strchr(value + strlen(key), ':');
+    if (value == nullptr) return 0;
+    value = strchr(value, '"');
+    if (value == nullptr) return 0;
+    uint32_t hash = 2166136261u;
+    for (value++; *value != '\0' && *value != '"'; value++) {
+        hash ^= static_cast<uint8_t>(*value);
+        hash *= 16777619u;
+    }
+    return hash == 0 ? 1 : hash;
+}
+
+uint32_t hashOf(const char* string) {
+    uint32_t hash = 2166136261u;
+    for (; *string != '\0'; string++) {
+        hash ^= static_cast<uint8_t>(*string);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+const uint32_t PRIORITY_EVENT_HASH = hashOf(COMMAND_PRIORITY_EVENT);
+
+}
+
+void TokenBucket::reset(const uint16_t bucket_rate, const uint16_t bucket_burst, const uint32_t now) {
+    rate = bucket_rate;
+    burst = bucket_burst;
+    tokens = burst * 1000;
+    last = now;
+}
+
+bool TokenBucket::take(const uint32_t now) {
+    const uint64_t refilled = tokens + static_cast<uint64_t>(now - last) * rate;
+    tokens = refilled > burst * 1000u ? burst * 1000u : static_cast<uint32_t>(refilled);
+    last = now;
+    if (tokens < 1000) return false;
+    tokens -= 1000;
+    return true;
+}
+
+uint32_t TokenBucket::wait() const {
+    return tokens >= 1000 || rate == 0 ? 0 : (1000 - tokens + rate - 1) / rate;
+}
+
+TokenBucket* CommandLimiter::deviceBucket(const uint32_t device, const uint32_t now) {
+    if (device == 0) return &shared; // No sub_device_id, 0 would also match (and never reset) a free slot
+    for (auto& entry : devices) {
+        if (entry.device == device) return &entry.bucket;
+        if (entry.device == 0) {
+            entry.device = device;
+            entry.bucket.reset(COMMAND_RATE_DEVICE, COMMAND_BURST_DEVICE, now);
+            return &entry.bucket;
+        }
+    }
+    return &shared;
+}
+
+command_status_t CommandLimiter::admit(const char* command, bool* is_priority, uint32_t* retry_ms) {
+    const auto now = millis();
+    if (!started) {
+        global.reset(COMMAND_RATE_GLOBAL, COMMAND_BURST_GLOBAL, now);
+        priority.reset(COMMAND_RATE_PRIORITY, COMMAND_BURST_PRIORITY, now);
+        shared.reset(COMMAND_RATE_DEVICE, COMMAND_BURST_DEVICE, now);
+        started = true;
+    }
+    *is_priority = scanValueHash(command, "\"event_name\"") == PRIORITY_EVENT_HASH;
+    if (*is_priority && priority.take(now)) {
+        counters.priority++;
+        counters.admitted++;
+        return COMMAND_OK;
+    }
+    *is_priority = false; // Over its own rate, it competes with the rest
+    auto* device = deviceBucket(scanValueHash(command, "\"sub_device_id\""), now);
+    if (!device->take(now)) {
+        counters.device_limited++;
+        *retry_ms = device->wait();
+        return COMMAND_RATE_LIMITED;
+    }
+    if (!global.take(now)) {
+        device->tokens += 1000; // Not used after all, the device isn't charged for the global limit
+        counters.global_limited++;
+        *retry_ms = global.wait();
+        return COMMAND_RATE_LIMITED;
+    }
+    counters.admitted++;
+    return COMMAND_OK;
+}
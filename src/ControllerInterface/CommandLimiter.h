@@ -0,0 +1,96 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#ifndef COMMANDLIMITER_H
+#define COMMANDLIMITER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "RoomInterfaceDatastructures.h"
+
+#define COMMAND_RATE_GLOBAL      20 // (commands/s) Sustained rate for every device together
+#define COMMAND_BURST_GLOBAL     10
+#define COMMAND_RATE_DEVICE      8  // (commands/s) Sustained rate per sub_device_id
+#define COMMAND_BURST_DEVICE     5
+#define COMMAND_RATE_PRIORITY    4  // (commands/s) Priority commands, outside the global bucket
+#define COMMAND_BURST_PRIORITY   4
+#define COMMAND_LIMIT_DEVICES    8  // Devices with a bucket of their own, the rest share one
+#define COMMAND_PRIORITY_EVENT   "heartbeat" // Keeps the radiator's heartbeat timeout from firing during a flood
+#define COMMAND_RESERVED_SLOTS   1  // Uplink queue slots only priority commands may take
+#define COMMAND_OVERLOAD_REPORT  1000 // (ms) Least time between overload reports to CENTRAL
+
+/**
+ * A token bucket in thousandths of a token, refilled from the time elapsed since it was last drawn from.
+ */
+struct TokenBucket {
+    uint32_t tokens;    // (1/1000 token)
+    uint32_t last;      // (ms) millis() of the last refill
+    uint16_t rate;      // (tokens/s), which is also thousandths per ms
+    uint16_t burst;     // (tokens)
+
+    void reset(uint16_t bucket_rate, uint16_t bucket_burst, uint32_t now);
+
+    /**
+     * Takes a token if one is available.
+     */
+    bool take(uint32_t now);
+
+    /**
+     * @return (ms) Until the next token is available.
+     */
+    uint32_t wait() const;
+};
+
+/**
+ * Admission control for inbound commands, runs on the uplink task before a command is queued or parsed. A command
+ * takes a token from the bucket of its sub_device_id and one from the global bucket, a command for
+ * COMMAND_PRIORITY_EVENT takes one from the priority bucket instead so a flood of other commands can't starve it.
+ * The fields are found with a scan of the raw text, not a parse, rejecting a command costs a few string searches.
+ * Not thread safe, only the uplink task uses it.
+ */
+class CommandLimiter {
+
+    friend struct BenchAccess; // The benchmarks (bench/) widen the buckets to measure admitted commands
+
+    struct DeviceBucket {
+        uint32_t device; // Hash of the sub_device_id, 0 for a free slot (a missing id uses the shared bucket)
+        TokenBucket bucket;
+    };
+
+    TokenBucket global = {};
+    TokenBucket priority = {};
+    TokenBucket shared = {}; // Devices past COMMAND_LIMIT_DEVICES
+    DeviceBucket devices[COMMAND_LIMIT_DEVICES] = {};
+    bool started = false;
+
+    TokenBucket* deviceBucket(uint32_t device, uint32_t now);
+
+public:
+
+    struct Counters {
+        uint32_t admitted;
+        uint32_t priority;        // Admitted from the priority bucket
+        uint32_t global_limited;  // Rejected by the global bucket
+        uint32_t device_limited;  // Rejected by the bucket of their device
+        uint32_t queue_full;      // Admitted by the buckets but the uplink queue had no slot for them
+    } counters = {};
+
+    /**
+     * @param command The raw command text.
+     * @param is_priority Set if the command is a priority command.
+     * @param retry_ms Set to the time until the rejecting bucket has a token again.
+     * @return COMMAND_OK to queue the command, COMMAND_RATE_LIMITED to reject it.
+     */
+    command_status_t admit(const char* command, bool* is_priority, uint32_t* retry_ms);
+
+    /**
+     * @return The rejections of every kind so far.
+     */
+    uint32_t rejected() const {
+        return counters.global_limited + counters.device_limited + counters.queue_full;
+    }
+
+};
+
+#endif //COMMANDLIMITER_H
@@ -0,0 +1,138 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#define LOG_MODULE LOG_MODULE_NETWORK
+
+#include "DatagramChannel.h"
+#include "NetworkInterface.h"
+
+#ifdef CENTRAL_UDP_PORT
+
+#ifdef NATIVE_BUILD
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#else
+#include <lwip/sockets.h>
+#endif
+
+void DatagramChannel::begin(const char* name, NetworkInterface* fallback) {
+    this->name = name;
+    this->fallback = fallback;
+    queue = xQueueCreate(DATAGRAM_QUEUE_LENGTH, sizeof(datagram_message_t));
+    if (queue == nullptr) {
+        LOG_ERROR("Failed to create datagram queue, urgent messages take the TCP stream");
+        return;
+    }
+    xTaskCreate(datagram_task, "datagram_task", 4096, this, 2, &task_handle);
+}
+
+bool DatagramChannel::queue_message(const char* data, const size_t length, const uint32_t sequence) const {
+    if (queue == nullptr || length > DATAGRAM_MAX_PAYLOAD) return false;
+    datagram_message_t message;
+    memcpy(message.data, data, length);
+    message.length = length;
+    message.sequence = sequence;
+    return xQueueSend(queue, &message, 0) == pdTRUE;
+}
+
+/**
+ * Opens the socket and resolves CENTRAL the first time, needs WiFi to be up.
+ */
+bool DatagramChannel::ensure_open() {
+    if (open) return true;
+    if (WiFi.hostByName(CENTRAL_HOST, central_ip) != 1) {
+        LOG_WARN("Failed to resolve %s for the datagram channel", CENTRAL_HOST);
+        return false;
+    }
+    socket_fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP); // Any local port, CENTRAL answers to wherever it came from
+    if (socket_fd < 0) {
+        LOG_WARN("Failed to open the datagram socket");
+        return false;
+    }
+    open = true;
+    LOG_INFO("Datagram channel open to %s:%d", central_ip.toString().c_str(), CENTRAL_UDP_PORT);
+    return true;
+}
+
+/**
+ * Blocks in recv() until the ACK of the sequence number arrives or the timeout runs out, ACKs of earlier (already
+ * given up) datagrams are discarded.
+ */
+bool DatagramChannel::wait_for_ack(const uint32_t sequence, const uint32_t timeout) {
+    const auto started = millis();
+    for (uint32_t elapsed = 0; elapsed < timeout; elapsed = millis() - started) {
+        const auto remaining = timeout - elapsed;
+        timeval receive_timeout = {};
+        receive_timeout.tv_sec = static_cast<decltype(receive_timeout.tv_sec)>(remaining / 1000);
+        receive_timeout.tv_usec = static_cast<decltype(receive_timeout.tv_usec)>(remaining % 1000 * 1000);
+        setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &receive_timeout, sizeof(receive_timeout));
+        datagram_header_t header;
+        const auto received = recv(socket_fd, &header, sizeof(header), 0);
+        if (received < 0) return false; // Timed out
+        if (received == sizeof(header) && header.magic == DATAGRAM_MAGIC && header.type == DATAGRAM_ACK &&
+            header.sequence == sequence) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @return True once CENTRAL acknowledged the datagram.
+ */
+bool DatagramChannel::send(const datagram_message_t& message) {
+    if (!ensure_open()) return false;
+    const auto name_length = static_cast<uint8_t>(strnlen(name, UINT8_MAX));
+    const datagram_header_t header = {DATAGRAM_MAGIC, DATAGRAM_DATA, name_length, 0, message.sequence};
+    uint8_t packet[sizeof(header) + UINT8_MAX + DATAGRAM_MAX_PAYLOAD];
+    memcpy(packet, &header, sizeof(header));
+    memcpy(packet + sizeof(header), name, name_length);
+    memcpy(packet + sizeof(header) + name_length, message.data, message.length);
+    const auto packet_length = sizeof(header) + name_length + message.length;
+    sockaddr_in central = {};
+    central.sin_family = AF_INET;
+    central.sin_port = htons(CENTRAL_UDP_PORT);
+    central.sin_addr.s_addr = static_cast<uint32_t>(central_ip);
+    const auto started = micros();
+    for (uint8_t attempt = 0; attempt < DATAGRAM_MAX_ATTEMPTS; attempt++) {
+        {
+            PROFILE_ZONE("sendto:datagram");
+            POWER_LOCK(POWER_LOCK_NETWORK);
+            const auto sent = sendto(socket_fd, packet, packet_length, 0, reinterpret_cast<const sockaddr*>(&central),
+                sizeof(central));
+            if (sent != static_cast<ssize_t>(packet_length)) {
+                LOG_WARN("Failed to send datagram %lu", static_cast<unsigned long>(message.sequence));
+                return false;
+            }
+        }
+        if (wait_for_ack(message.sequence, DATAGRAM_ACK_TIMEOUT << attempt)) {
+            LOG_DEBUG("Datagram %lu acked in %luus after %u attempt(s)", static_cast<unsigned long>(message.sequence),
+                static_cast<unsigned long>(micros() - started), attempt + 1);
+            return true;
+        }
+    }
+    LOG_WARN("Datagram %lu was not acked after %d attempts, using TCP for %ds",
+        static_cast<unsigned long>(message.sequence), DATAGRAM_MAX_ATTEMPTS, DATAGRAM_BACKOFF / 1000);
+    return false;
+}
+
+[[noreturn]] void DatagramChannel::datagram_task(void* pvParameters) {
+    auto* channel = static_cast<DatagramChannel*>(pvParameters);
+    datagram_message_t message;
+    while (true) {
+        if (xQueueReceive(channel->queue, &message, portMAX_DELAY) != pdTRUE) continue;
+        const bool backing_off = channel->failed_at != 0 && millis() - channel->failed_at < DATAGRAM_BACKOFF;
+        if (!backing_off && channel->fallback->linkUp()) {
+            if (channel->send(message)) {
+                channel->failed_at = 0;
+                continue;
+            }
+            channel->failed_at = millis();
+            if (channel->failed_at == 0) channel->failed_at = 1;
+        }
+        channel->fallback->queue_message(message.data, message.length);
+    }
+}
+
+#endif
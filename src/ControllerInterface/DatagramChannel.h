@@ -0,0 +1,89 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#ifndef DATAGRAMCHANNEL_H
+#define DATAGRAMCHANNEL_H
+
+#include <WiFi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+#define DATAGRAM_MAGIC        0xD6
+#define DATAGRAM_DATA         1
+#define DATAGRAM_ACK          2
+#define DATAGRAM_MAX_PAYLOAD  512   // (bytes) Larger messages take the TCP stream
+#define DATAGRAM_QUEUE_LENGTH 4
+#define DATAGRAM_ACK_TIMEOUT  40    // (ms) Before the first retransmit, doubles with every attempt
+#define DATAGRAM_MAX_ATTEMPTS 4
+#define DATAGRAM_BACKOFF      60000 // (ms) Everything takes the TCP stream after a datagram went unacknowledged
+
+class NetworkInterface;
+
+/**
+ * UDP side channel to CENTRAL for small, latency critical messages (motion, faults), so they don't queue behind
+ * state updates and OTA data on the TCP stream. Enabled by defining CENTRAL_UDP_PORT in secrets.h.
+ *
+ * A datagram is a datagram_header_t, the satellite name and the JSON message (no null terminator). CENTRAL acks
+ * every DATA datagram with an ACK header carrying the same sequence number, duplicates included. Messages are sent
+ * one at a time (stop and wait) and retransmitted DATAGRAM_MAX_ATTEMPTS times, a message that is never acked is
+ * sent over the TCP stream and the channel backs off for DATAGRAM_BACKOFF. The JSON carries the sequence number
+ * as "seq" too, so CENTRAL drops whichever copy arrives second.
+ *
+ * The socket is a plain lwip socket rather than a WiFiUDP, which can only be polled: the task waits for an ACK
+ * blocked in recv() with a receive timeout, so the CPU can stay in light sleep until the ACK arrives.
+ */
+class DatagramChannel {
+
+public:
+
+    typedef struct __attribute__((packed)) {
+        uint8_t magic;
+        uint8_t type;
+        uint8_t name_length; // Satellite name bytes after the header, 0 in an ACK
+        uint8_t reserved;
+        uint32_t sequence;
+    } datagram_header_t;
+
+    typedef struct {
+        char data[DATAGRAM_MAX_PAYLOAD];
+        size_t length;
+        uint32_t sequence;
+    } datagram_message_t;
+
+private:
+
+    const char* name = nullptr;
+    NetworkInterface* fallback = nullptr;
+    QueueHandle_t queue = nullptr;
+    TaskHandle_t task_handle = nullptr;
+    int socket_fd = -1; // Open once ensure_open() succeeded
+    IPAddress central_ip;
+    bool open = false;
+    uint32_t failed_at = 0; // (ms) When the last datagram went unacknowledged, 0 if none has
+
+    bool ensure_open();
+
+    bool send(const datagram_message_t& message);
+
+    bool wait_for_ack(uint32_t sequence, uint32_t timeout);
+
+    [[noreturn]] static void datagram_task(void* pvParameters);
+
+public:
+
+    /**
+     * Starts the sending task, the socket is opened when the first message is sent.
+     * @param fallback Sends the messages that can't go over UDP.
+     */
+    void begin(const char* name, NetworkInterface* fallback);
+
+    /**
+     * @return False if the message is too large or the queue is full, the caller sends it over TCP instead.
+     */
+    bool queue_message(const char* data, size_t length, uint32_t sequence) const;
+
+};
+
+#endif //DATAGRAMCHANNEL_H
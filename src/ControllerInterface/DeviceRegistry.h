@@ -0,0 +1,206 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#ifndef DEVICEREGISTRY_H
+#define DEVICEREGISTRY_H
+
+#include <new>
+#include <tuple>
+#include <utility>
+#include <cstring>
+
+#include <ArduinoJson.h>
+#include "RoomDevice.h"
+#include "RoomInterfaceDatastructures.h"
+#include "build_info.h"
+
+#define DEVICE_INFO_BUFFER_SIZE 1024 // Matches NetworkInterface::device_info
+
+/**
+ * The interface the RoomInterface uses to walk a compile-time device registry.
+ * This costs one virtual call per operation instead of one (or more) per device per operation.
+ */
+class DeviceRegistry {
+
+public:
+
+    virtual ~DeviceRegistry() = default;
+
+    virtual size_t getDeviceCount() const = 0;
+
+    virtual void startDeviceLoops() = 0;
+
+    /**
+     * Adds the device data of every registered device to the objects of a state_update.
+     * @param objects The "objects" object of the downlink payload.
+     * @param target_device If not null, only the device with the matching name is added.
+     */
+    virtual void getDeviceData(JsonObject objects, const char* target_device) = 0;
+
+    /**
+     * Passes an event to every device whose name matches the event's object name.
+     * @return COMMAND_UNKNOWN_OBJECT if no device matched, COMMAND_UNKNOWN_EVENT if none of them handled it.
+     */
+    virtual command_status_t eventExecute(const ParsedEvent_t* event) = 0;
+
+    /**
+     * @param length Set to the length of the payload (not including the null terminator).
+     * @return The device_info handshake payload.
+     */
+    virtual const char* getDeviceInfo(size_t* length) const = 0;
+
+};
+
+/**
+ * Fixed size character buffer that can be filled in a constant expression.
+ */
+struct DeviceInfoPayload {
+    char data[DEVICE_INFO_BUFFER_SIZE] = {};
+    size_t length = 0;
+
+    constexpr void append(const char* string) {
+        while (*string != '\0' && length < sizeof(data) - 1) {
+            data[length++] = *string++;
+        }
+    }
+
+    constexpr void append(size_t value) {
+        char digits[20] = {};
+        size_t count = 0;
+        do {
+            digits[count++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        while (count > 0 && length < sizeof(data) - 1) {
+            data[length++] = digits[--count];
+        }
+    }
+};
+
+/**
+ * Statically allocated storage for a device, the device is constructed in place by StaticDeviceRegistry::construct
+ * because device constructors touch hardware and cannot run during static initialization.
+ */
+template<typename Device>
+struct StaticDeviceSlot {
+    alignas(Device) uint8_t storage[sizeof(Device)];
+
+    Device* get() {
+        return std::launder(reinterpret_cast<Device*>(storage));
+    }
+};
+
+/**
+ * Compile-time list of the devices running on this satellite.
+ * Every device type must be final and provide static constexpr OBJECT_NAME and OBJECT_TYPE strings,
+ * this lets the compiler resolve getDeviceData() and the device names without going through the vtable.
+ * @tparam DeviceName The name reported to CENTRAL in the device_info payload.
+ * @tparam Devices The device classes, each one is instantiated exactly once.
+ */
+template<const char* DeviceName, typename... Devices>
+class StaticDeviceRegistry final : public DeviceRegistry {
+
+    static_assert(sizeof...(Devices) > 0, "A device registry needs at least one device");
+
+    std::tuple<StaticDeviceSlot<Devices>...> slots;
+    TaskHandle_t taskHandles[sizeof...(Devices)] = {};
+    bool constructed = false;
+
+    template<typename Function, size_t... Index>
+    void forEach(Function&& function, std::index_sequence<Index...>) {
+        (function(*std::get<Index>(slots).get(), Index), ...);
+    }
+
+    template<typename Function>
+    void forEach(Function&& function) {
+        forEach(std::forward<Function>(function), std::index_sequence_for<Devices...>{});
+    }
+
+    static constexpr DeviceInfoPayload buildDeviceInfo() {
+        // Same layout as the payload RoomInterface::getDeviceInfo builds at runtime.
+        DeviceInfoPayload payload;
+        payload.append("{\"name\":\"");
+        payload.append(DeviceName);
+        payload.append("\",\"version\":\"" BUILD_VERSION "\",\"branch\":\"" BUILD_GIT_BRANCH "\",\"sub_device_count\":");
+        payload.append(sizeof...(Devices));
+        payload.append(",\"sub_devices\":{");
+        size_t index = 0;
+        ((payload.append(index++ == 0 ? "\"" : ",\""),
+          payload.append(Devices::OBJECT_NAME),
+          payload.append("\":\""),
+          payload.append(Devices::OBJECT_TYPE),
+          payload.append("\"")), ...);
+        payload.append("},\"cmd_window\":");
+        payload.append(static_cast<size_t>(COMMAND_WINDOW));
+        payload.append(",\"msg_type\":\"device_info\"}");
+        return payload;
+    }
+
+    static constexpr DeviceInfoPayload deviceInfo = buildDeviceInfo();
+
+    static_assert(deviceInfo.length < DEVICE_INFO_BUFFER_SIZE - 1, "device_info payload does not fit its buffer");
+
+public:
+
+    StaticDeviceRegistry() = default;
+
+    /**
+     * Constructs every device in place, in the order they were declared.
+     * @param room_interface The interface the devices are bound to.
+     */
+    void construct(RoomInterface* room_interface) {
+        if (constructed) return;
+        forEach([room_interface](auto& slot_device, size_t) {
+            using Device = std::remove_reference_t<decltype(slot_device)>;
+            new (&slot_device) Device(room_interface);
+        });
+        constructed = true;
+    }
+
+    template<typename Device>
+    Device* get() {
+        return std::get<StaticDeviceSlot<Device>>(slots).get();
+    }
+
+    size_t getDeviceCount() const override {
+        return sizeof...(Devices);
+    }
+
+    void startDeviceLoops() override {
+        forEach([this](auto& device, const size_t index) {
+            LOG_INFO("Starting Task: %s", device.OBJECT_NAME);
+            device.startTask(&taskHandles[index]);
+        });
+    }
+
+    void getDeviceData(JsonObject objects, const char* target_device) override {
+        forEach([&objects, target_device](auto& device, size_t) {
+            if (target_device != nullptr && strcmp(device.OBJECT_NAME, target_device) != 0) return;
+            objects[device.OBJECT_NAME] = device.getDeviceData();
+        });
+    }
+
+    command_status_t eventExecute(const ParsedEvent_t* event) override {
+        auto status = COMMAND_UNKNOWN_OBJECT;
+        forEach([event, &status](auto& device, size_t) {
+            if (strcmp(device.OBJECT_NAME, event->objectName) == 0) {
+                if (device.processEvent(event->eventName, event)) {
+                    status = COMMAND_OK;
+                } else if (status != COMMAND_OK) {
+                    status = COMMAND_UNKNOWN_EVENT;
+                }
+            }
+        });
+        return status;
+    }
+
+    const char* getDeviceInfo(size_t* length) const override {
+        *length = deviceInfo.length;
+        return deviceInfo.data;
+    }
+
+};
+
+
+#endif //DEVICEREGISTRY_H
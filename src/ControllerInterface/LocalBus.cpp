@@ -0,0 +1,120 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#define LOG_MODULE LOG_MODULE_INTERFACE
+
+#include "LocalBus.h"
+#include "Profile/Profile.h"
+#include "debug.h"
+
+uint32_t LocalBus::topic(const char* object, const char* event) {
+    // FNV-1a over "<object>.<event>"
+    uint32_t hash = 2166136261u;
+    for (const auto* part : {object, ".", event}) {
+        for (; *part != '\0'; part++) {
+            hash ^= static_cast<uint8_t>(*part);
+            hash *= 16777619u;
+        }
+    }
+    return hash;
+}
+
+/**
+ * Must be called with the mutex held, a message is free once every subscriber released it.
+ */
+BusMessage* LocalBus::allocate() {
+    for (auto& message : pool) {
+        if (message.references.load(std::memory_order_acquire) == 0) return &message;
+    }
+    return nullptr;
+}
+
+int8_t LocalBus::subscribe(const char* object, const char* event, TaskHandle_t task, const uint8_t depth) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (subscriber_count == BUS_MAX_SUBSCRIBERS) {
+        xSemaphoreGive(mutex);
+        LOG_ERROR("No subscriber slot left for %s.%s", object, event);
+        return -1;
+    }
+    const auto handle = static_cast<int8_t>(subscriber_count);
+    auto& subscriber = subscribers[handle];
+    subscriber.topic = topic(object, event);
+    subscriber.queue = xQueueCreate(depth, sizeof(BusMessage*));
+    subscriber.task = task;
+    subscriber_count++;
+    xSemaphoreGive(mutex);
+    LOG_INFO("Subscribed to %s.%s", object, event);
+    return handle;
+}
+
+uint8_t LocalBus::publish(const ParsedEvent_t* event) {
+    if (subscriber_count == 0 || event->objectName == nullptr || event->eventName == nullptr) return 0;
+    const auto hash = topic(event->objectName, event->eventName);
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    uint8_t matching = 0;
+    for (uint8_t i = 0; i < subscriber_count; i++) {
+        if (subscribers[i].topic == hash) matching++;
+    }
+    if (matching == 0) {
+        xSemaphoreGive(mutex);
+        return 0;
+    }
+    PROFILE_ZONE("LocalBus::publish");
+    auto* message = allocate();
+    if (message == nullptr) {
+        for (uint8_t i = 0; i < subscriber_count; i++) {
+            if (subscribers[i].topic == hash) subscribers[i].dropped++;
+        }
+        xSemaphoreGive(mutex);
+        LOG_WARN("Message pool exhausted, dropped %s.%s", event->objectName, event->eventName);
+        return 0;
+    }
+    // The one copy, every subscriber reads this message in place
+    size_t used = 0;
+    const auto copy = [&](const char* string) -> const char* {
+        const auto length = strlen(string) + 1;
+        if (used + length > sizeof(message->strings)) return "";
+        auto* out = message->strings + used;
+        memcpy(out, string, length);
+        used += length;
+        return out;
+    };
+    message->topic = hash;
+    message->objectName = copy(event->objectName);
+    message->eventName = copy(event->eventName);
+    message->timestamp = event->timestamp;
+    message->numArgs = event->numArgs < BUS_MAX_ARGS ? event->numArgs : BUS_MAX_ARGS;
+    for (uint8_t i = 0; i < message->numArgs; i++) {
+        message->args[i] = event->args[i];
+        if (event->args[i].type == ParsedArg::STRING) {
+            message->args[i].value.stringVal = const_cast<char*>(copy(event->args[i].value.stringVal));
+        }
+    }
+    message->references.store(matching, std::memory_order_release);
+    uint8_t queued = 0;
+    for (uint8_t i = 0; i < subscriber_count; i++) {
+        auto& subscriber = subscribers[i];
+        if (subscriber.topic != hash) continue;
+        if (xQueueSend(subscriber.queue, &message, 0) != pdTRUE) {
+            subscriber.dropped++;
+            release(message);
+            continue;
+        }
+        subscriber.delivered++;
+        queued++;
+        if (subscriber.task != nullptr) xTaskNotifyGive(subscriber.task);
+    }
+    xSemaphoreGive(mutex);
+    if (queued < matching) {
+        LOG_DEBUG("%d subscriber(s) of %s.%s are behind", matching - queued, event->objectName, event->eventName);
+    }
+    return queued;
+}
+
+const BusMessage* LocalBus::receive(const int8_t subscription, const TickType_t wait) const {
+    if (subscription < 0) return nullptr;
+    BusMessage* message = nullptr;
+    if (xQueueReceive(subscribers[subscription].queue, &message, wait) != pdTRUE) return nullptr;
+    return message;
+}
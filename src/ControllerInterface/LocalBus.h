@@ -0,0 +1,110 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#ifndef LOCALBUS_H
+#define LOCALBUS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include "RoomInterfaceDatastructures.h"
+
+#define BUS_POOL_SIZE       8   // Messages in flight across every subscriber
+#define BUS_MAX_SUBSCRIBERS 8
+#define BUS_QUEUE_DEPTH     4   // Default messages a subscriber may hold before new ones are dropped for it
+#define BUS_MAX_ARGS        4
+#define BUS_STRING_BUFFER   96  // (bytes) Object and event names and string arguments of a message
+
+/**
+ * A device event as the bus delivers it. Subscribers read it in place and hand it back with LocalBus::release.
+ */
+struct BusMessage {
+    uint32_t topic;
+    const char* objectName;
+    const char* eventName;
+    ParsedArg args[BUS_MAX_ARGS]; // Arguments past BUS_MAX_ARGS are not published
+    uint8_t numArgs;
+    uint64_t timestamp;           // (us) clockMicros() when the event was created
+    char strings[BUS_STRING_BUFFER];
+    std::atomic<uint8_t> references;
+
+    /**
+     * @return The argument as a number, NAN if it is missing or a string.
+     */
+    float number(const uint8_t index) const {
+        if (index >= numArgs) return NAN;
+        switch (args[index].type) {
+            case ParsedArg::BOOL: return args[index].value.boolVal ? 1.0f : 0.0f;
+            case ParsedArg::INT: return static_cast<float>(args[index].value.intVal);
+            case ParsedArg::FLOAT: return args[index].value.floatVal;
+            default: return NAN;
+        }
+    }
+};
+
+/**
+ * In-process publish/subscribe between the devices of one room interface. Every event a device sends
+ * (RoomInterface::sendEvent) is published under the topic "<object>.<event>" before it goes to CENTRAL, so devices
+ * on the same board observe each other without a round trip.
+ *
+ * An event is copied once, into a pooled message, and only when something subscribed to its topic. Every subscriber
+ * gets a pointer to that message in its own bounded queue and the task it named is notified (xTaskNotifyGive, so a
+ * device task blocked in ulTaskNotifyTake wakes up). A subscriber that falls behind loses new messages, the
+ * publisher never waits.
+ */
+class LocalBus {
+
+    struct Subscriber {
+        uint32_t topic;
+        QueueHandle_t queue;
+        TaskHandle_t task;   // Notified on delivery, may be null
+        uint32_t delivered;
+        uint32_t dropped;    // Queue full, or no free message in the pool
+    };
+
+    BusMessage pool[BUS_POOL_SIZE] = {};
+    Subscriber subscribers[BUS_MAX_SUBSCRIBERS] = {};
+    uint8_t subscriber_count = 0;
+    SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
+
+    BusMessage* allocate();
+
+public:
+
+    static uint32_t topic(const char* object, const char* event);
+
+    /**
+     * Subscriptions last for the life of the bus, subscribe once when the device starts.
+     * @param task Notified when a message is queued, null to poll.
+     * @param depth Messages the subscriber may hold at once.
+     * @return The subscription handle, -1 if every subscriber slot is taken.
+     */
+    int8_t subscribe(const char* object, const char* event, TaskHandle_t task, uint8_t depth = BUS_QUEUE_DEPTH);
+
+    /**
+     * Delivers the event to the subscribers of its topic, never blocks on a subscriber.
+     * @return The number of subscribers it was queued for.
+     */
+    uint8_t publish(const ParsedEvent_t* event);
+
+    /**
+     * @return The next message, null if none arrived within wait. Must be released once read.
+     */
+    const BusMessage* receive(int8_t subscription, TickType_t wait = 0) const;
+
+    static void release(const BusMessage* message) {
+        const_cast<BusMessage*>(message)->references.fetch_sub(1, std::memory_order_release);
+    }
+
+    uint32_t dropped(int8_t subscription) const {
+        return subscription < 0 ? 0 : subscribers[subscription].dropped;
+    }
+
+};
+
+#endif //LOCALBUS_H
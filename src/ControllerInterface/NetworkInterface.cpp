@@ -2,24 +2,29 @@
 // Created by Jay on 10/12/2024.
 //
 
+#define LOG_MODULE LOG_MODULE_NETWORK
+
 #include "NetworkInterface.h"
 
 #include <esp_task_wdt.h>
 
-void NetworkInterface::begin(const char* device_info, const size_t device_info_length) {
-    DEBUG_PRINT("Initializing Network Interface");
+void NetworkInterface::begin(const char* name, const char* device_info, const size_t device_info_length,
+                             SemaphoreHandle_t link_up_signal) {
+    LOG_INFO("Initializing Network Interface");
     pinMode(ACTIVITY_LED, OUTPUT);
     memcpy(this->device_info, device_info, device_info_length);
     this->device_info_length = device_info_length;
+    this->link_up_signal = link_up_signal;
     // The network interface runs on Core 0
     this->downlink_queue = xQueueCreate(5, sizeof(downlink_message_t));
     if (this->downlink_queue == nullptr) {
-        DEBUG_PRINT("Failed to create downlink queue");
+        LOG_ERROR("Failed to create downlink queue");
         return;
     }
-    this->uplink_queue = xQueueCreate(5, sizeof(uplink_message_t));
+    // CENTRAL's window, plus the slots held back for priority commands (see CommandLimiter.h)
+    this->uplink_queue = xQueueCreate(COMMAND_WINDOW + COMMAND_RESERVED_SLOTS, sizeof(uplink_message_t));
     if (this->uplink_queue == nullptr) {
-        DEBUG_PRINT("Failed to create uplink queue");
+        LOG_ERROR("Failed to create uplink queue");
         vQueueDelete(this->downlink_queue);
         return;
     }
@@ -27,49 +32,122 @@ void NetworkInterface::begin(const char* device_info, const size_t device_info_l
     this->datalink_client = new WiFiClient();
     // Initialize the tcp/ip connection to the server
     this->datalink_client->setTimeout(15); // Set a timeout for the connection
-    // this->datalink_client->setNoDelay(true); // Disable Nagle's algorithm for low latency
-    this->establish_connection();
+    // Nagle's algorithm is disabled once connected (establish_connection), the option needs the socket
+    // The connection is made by the downlink task so nothing else waits on the network
     // esp_task_wdt_add(system_tasks[0].handle);
     xTaskCreate(downlink_task,"downlink_task", 8192,
         this,1, &this->downlink_task_handle);
     xTaskCreate(poll_uplink_buffer,"uplink_task", 16384,
         this,1 , &this->uplink_task_handle);
-    this->update_handler->begin();
+    this->update_handler->begin(this);
+#ifdef CENTRAL_UDP_PORT
+    this->datagram_channel.begin(name, this);
+#endif
     esp_task_wdt_add(this->downlink_task_handle);
     esp_task_wdt_add(this->uplink_task_handle);
-    DEBUG_PRINT("Network interface initialized successfully");
+    LOG_INFO("Network interface started, connecting in the background");
 }
 
+/**
+ * Blocks until the join started by wifiJoinStart() is connected, see WifiJoin.h for the fallbacks.
+ */
+void NetworkInterface::wait_for_wifi() {
+    if (wifiJoinPoll()) return;
+    ledcSetup(LEDC_CHANNEL, LEDC_FREQUENCY_NO_WIFI, LEDC_TIMER);
+    ledcAttachPin(ACTIVITY_LED, LEDC_CHANNEL);
+    ledcWrite(LEDC_CHANNEL, 4096);
+    while (!wifiJoinPoll()) {
+        esp_task_wdt_reset();
+        vTaskDelay(20 / portTICK_PERIOD_MS);
+    }
+    ledcDetachPin(ACTIVITY_LED);
+}
+
+/**
+ * Adds the running image's SHA-256 to the device info, the base CENTRAL makes delta updates against. Hashing reads
+ * the whole app partition, it is done here while WiFi joins instead of in setup() before the devices start.
+ */
+void NetworkInterface::add_image_hash() {
+    char field[96];
+    const auto length = snprintf(field, sizeof(field), R"(,"image_sha256":"%s"})", UpdateHandler::runningImageHash());
+    // The device info is a JSON object, the field replaces its closing brace
+    if (device_info_length == 0 || device_info_length + length + 1 >= sizeof(device_info)) {
+        LOG_ERROR("No room for the image hash in the device info");
+        return;
+    }
+    memcpy(device_info + device_info_length - 1, field, length + 1);
+    device_info_length += length - 1;
+}
+
+/**
+ * Brings up WiFi and the connection to CENTRAL for the first time, then reports the boot timeline.
+ */
+void NetworkInterface::bring_up_link() {
+    add_image_hash();
+    wait_for_wifi();
+    bootMark(BOOT_WIFI_CONNECTED);
+    establish_connection();
+    bootMark(BOOT_LINK_UP);
+    bootLog();
+    char report[256];
+    auto length = bootReport(report, sizeof(report));
+    if (length > 0) queue_message(report, length);
+    length = wifiJoinReport(report, sizeof(report));
+    if (length > 0) queue_message(report, length);
+}
+
+/**
+ * Blocks until CENTRAL accepted the device info, a connection that takes the connect but not the device info
+ * is dropped and made again.
+ */
 void NetworkInterface::establish_connection() {
-    DEBUG_PRINT("Establishing connection to %s:%d", CENTRAL_HOST, CENTRAL_PORT);
+    link_up = false;
+    link_down_since = xTaskGetTickCount();
+    LOG_INFO("Establishing connection to %s:%d", CENTRAL_HOST, CENTRAL_PORT);
     ledcSetup(LEDC_CHANNEL, LEDC_FREQUENCY_NO_LINK, LEDC_TIMER);
     ledcAttachPin(ACTIVITY_LED, LEDC_CHANNEL);
     ledcWrite(LEDC_CHANNEL, 4096);
+    size_t wrote = 0;
     while (true) {
         esp_task_wdt_reset();
         const auto connect_result = this->datalink_client->connect(CENTRAL_HOST, CENTRAL_PORT);
+        if (!connect_result && wifiJoinUsedCache()) {
+            // The cached address may have been handed to another host since, get a fresh lease
+            wifiJoinFallback("Failed to reach CENTRAL");
+            wait_for_wifi();
+            continue;
+        }
         if (!connect_result) {
-            DEBUG_PRINT("Failed to connect to %s:%d, retrying in 5 seconds...", CENTRAL_HOST, CENTRAL_PORT);
+            LOG_WARN("Failed to connect to %s:%d, retrying in 5 seconds...", CENTRAL_HOST, CENTRAL_PORT);
             vTaskDelay(5000 / portTICK_PERIOD_MS);
             continue; // Retry connection
         }
-        break; // Connection successful
-    }
-    DEBUG_PRINT("Connected to %s:%d, sending device information...", CENTRAL_HOST, CENTRAL_PORT);
-    device_info[device_info_length + 1] = '\0'; // Ensure the last byte is a null terminated
-    const auto wrote = this->datalink_client->write(device_info, device_info_length + 1); // +1 for the null terminator
-    if (wrote != device_info_length + 1) {
-        DEBUG_PRINT("Failed to write device info to server, wrote %d != %d bytes",
-                   wrote, device_info_length);
-        ledcDetachPin(ACTIVITY_LED); // Detach the LED pin if we failed to write
-        return;
+        LOG_INFO("Connected to %s:%d, sending device information...", CENTRAL_HOST, CENTRAL_PORT);
+        // Acks are small and pipelined, Nagle would hold each one back until CENTRAL (delay) acks the one before it
+        this->datalink_client->setNoDelay(true);
+        device_info[device_info_length + 1] = '\0'; // Ensure the last byte is a null terminated
+        {
+            PROFILE_ZONE("WiFiClient::write");
+            POWER_LOCK(POWER_LOCK_NETWORK);
+            wrote = this->datalink_client->write(device_info, device_info_length + 1); // +1 for the null terminator
+        }
+        if (wrote == device_info_length + 1) break; // Connection successful
+        LOG_ERROR("Failed to write device info to server, wrote %u != %u bytes, reconnecting in 5 seconds...",
+            static_cast<unsigned>(wrote), static_cast<unsigned>(device_info_length + 1));
+        this->datalink_client->stop();
+        vTaskDelay(5000 / portTICK_PERIOD_MS);
     }
     ledcDetachPin(ACTIVITY_LED); // Detach the LED pin after writing
-    DEBUG_PRINT("Device information sent successfully [%d bytes]", wrote);
+    LOG_INFO("Device information sent successfully [%u bytes]", static_cast<unsigned>(wrote));
+    link_up_since = xTaskGetTickCount();
+    link_up = true;
+    if (uplink_task_handle != nullptr) xTaskNotifyGive(uplink_task_handle); // Stop waiting for the link
+    if (link_up_signal != nullptr) xSemaphoreGive(link_up_signal);
 }
 
 [[noreturn]] void NetworkInterface::downlink_task(void *pvParameters) {
     auto *network_interface = static_cast<NetworkInterface *>(pvParameters);
+    network_interface->bring_up_link();
     while (true) {
         network_interface->last_connection_attempt = millis();
         network_interface->flush_downlink_queue();
@@ -78,17 +156,29 @@ void NetworkInterface::establish_connection() {
 }
 
 [[noreturn]] void NetworkInterface::poll_uplink_buffer(void *pvParameters) {
-    DEBUG_PRINT("Starting Uplink Task");
+    LOG_INFO("Starting Uplink Task");
     const auto *network_interface = static_cast<NetworkInterface *>(pvParameters);
     uint8_t buffer[4096] = {0}; // Buffer to hold incoming data
     while (true) {
         if (!network_interface->datalink_client->connected()) {
             esp_task_wdt_reset();
-            vTaskDelay(5000);
+            ulTaskNotifyTake(pdTRUE, 5000); // Woken early when the link comes up
         }
-        // Check if there is data to read from the WebSocket client
-        const auto read =
-            network_interface->datalink_client->readBytesUntil('\0', buffer, sizeof(buffer) - 1);
+        // The first byte tells a binary OTA frame, which carries its length, from a null terminated message
+        auto* client = network_interface->datalink_client;
+        if (client->readBytes(buffer, 1) == 0) {
+            esp_task_wdt_reset();
+            continue;
+        }
+        if (buffer[0] == OTA_FRAME) {
+            if (!network_interface->update_handler->receiveFrame(client)) {
+                LOG_ERROR("OTA frame cut off, reconnecting to resynchronize");
+                client->stop();
+            }
+            esp_task_wdt_reset();
+            continue;
+        }
+        const auto read = buffer[0] == '\0' ? 0 : client->readBytesUntil('\0', buffer + 1, sizeof(buffer) - 2) + 1;
         if (read > 0) {
             buffer[read] = '\0'; // Null-terminate the buffer
             network_interface->handle_uplink_data(buffer, read + 1);
@@ -102,38 +192,115 @@ void NetworkInterface::queue_message(const char *data, const size_t length) cons
     memcpy(message.data, data, length);
     message.length = length;
     message.timestamp = micros();
+    message.id = TRACE_MESSAGE_ID();
     if (downlink_queue == nullptr) {
-        DEBUG_PRINT("Downlink queue is not initialized, cannot send message");
+        LOG_ERROR("Downlink queue is not initialized, cannot send message");
+        return;
+    }
+    if (!link_up) {
+        // Nothing would drain the queue until the link is up, the caller must not stall on it.
+        // The state is sent in full again once the link is back (see link_up_signal).
+        LOG_DEBUG("Link is down, dropping downlink message [%u bytes]", static_cast<unsigned>(length));
         return;
     }
-    xQueueSend(downlink_queue, &message, 10000);
+    TRACE_EVENT(TRACE_MSG_QUEUED, TRACE_OBJ_NONE, message.id, length);
+    [[maybe_unused]] const auto status = xQueueSend(downlink_queue, &message, 10000);
+    TRACE_EVENT(TRACE_QUEUE_SEND, TRACE_OBJ_DOWNLINK_QUEUE, message.id, status == pdTRUE);
+}
+
+void NetworkInterface::queue_urgent(const char *data, const size_t length, const uint32_t sequence) const {
+#ifdef CENTRAL_UDP_PORT
+    if (link_up && datagram_channel.queue_message(data, length, sequence)) return;
+#endif
+    queue_message(data, length);
+}
+
+/**
+ * A command dropped before it was queued is nacked so it can be resent, BUSY when CENTRAL went over the window
+ * (COMMAND_WINDOW), RATE_LIMITED with the time until the limiter takes it again.
+ */
+void NetworkInterface::reject_command(const char* command, const command_status_t status, const uint32_t retry_ms) const {
+    const auto request_id = scan_request_id(command);
+    if (request_id != 0) {
+        char buffer[128];
+        const auto length = snprintf(buffer, sizeof(buffer),
+            R"({"msg_type":"nack","req_id":%lu,"code":%u,"status":"%s","retry_ms":%lu})",
+            static_cast<unsigned long>(request_id), status, commandStatusName(status),
+            static_cast<unsigned long>(retry_ms));
+        queue_message(buffer, length);
+    }
+    report_overload();
+}
+
+/**
+ * Tells CENTRAL (and the log) it is sending more than the satellite takes, at most every COMMAND_OVERLOAD_REPORT.
+ */
+void NetworkInterface::report_overload() const {
+    const auto now = millis();
+    if (now - last_overload_report < COMMAND_OVERLOAD_REPORT) return;
+    last_overload_report = now;
+    const auto& counters = command_limiter.counters;
+    LOG_WARN("Command overload: %lu rejected (global %lu, device %lu, queue %lu), %lu admitted",
+        static_cast<unsigned long>(command_limiter.rejected()), static_cast<unsigned long>(counters.global_limited),
+        static_cast<unsigned long>(counters.device_limited), static_cast<unsigned long>(counters.queue_full),
+        static_cast<unsigned long>(counters.admitted));
+    char buffer[192];
+    const auto length = snprintf(buffer, sizeof(buffer),
+        R"({"msg_type":"overload","admitted":%lu,"priority":%lu,"global_limited":%lu,"device_limited":%lu,)"
+        R"("queue_full":%lu})", static_cast<unsigned long>(counters.admitted),
+        static_cast<unsigned long>(counters.priority), static_cast<unsigned long>(counters.global_limited),
+        static_cast<unsigned long>(counters.device_limited), static_cast<unsigned long>(counters.queue_full));
+    queue_message(buffer, length);
 }
 
 /**
  * This event handler is called when the WebSocket client receives data from the server.
  */
 void NetworkInterface::handle_uplink_data(const uint8_t* data, const size_t length) const {
+    const auto received = clockMicros();
+    POWER_LOCK(POWER_LOCK_NETWORK);
+    if (data[0] == '\b') { // Commands are admitted before anything is copied or parsed
+        const auto* command = reinterpret_cast<const char*>(data + 1);
+        bool priority = false;
+        uint32_t retry_ms = 0;
+        if (command_limiter.admit(command, &priority, &retry_ms) != COMMAND_OK) {
+            reject_command(command, COMMAND_RATE_LIMITED, retry_ms);
+            return;
+        }
+        // The uplink task never waits on a full queue for an ordinary command, and leaves the last slots to priority
+        if (!priority && uxQueueSpacesAvailable(uplink_queue) <= COMMAND_RESERVED_SLOTS) {
+            command_limiter.counters.queue_full++; // Logged with the overload report, a flood would flood the log
+            reject_command(command, COMMAND_BUSY, 0);
+            return;
+        }
+    }
     // Put the received data into a message structure
     uplink_message_t message;
     message.length = length;
-    message.timestamp = millis();
+    message.timestamp = received;
+    message.id = TRACE_MESSAGE_ID();
     memset(message.data, 0, sizeof(message.data)); // Clear the data buffer
     BaseType_t status = pdFALSE;
     switch (data[0]){
         case '\b':
             memcpy(message.data, data + 1, length);
-            // Send the message to the uplink queue
+            TRACE_EVENT(TRACE_MSG_RECEIVED, TRACE_OBJ_NONE, message.id, length);
+            // Send the message to the uplink queue, only a priority command can find it full and waits for a slot
             status = xQueueSend(this->uplink_queue, &message, 200);
+            TRACE_EVENT(TRACE_QUEUE_SEND, TRACE_OBJ_UPLINK_QUEUE, message.id, status == pdTRUE);
             if (status != pdTRUE) {
-                DEBUG_PRINT("Failed to move inbound message to uplink queue %s",
+                LOG_ERROR("Failed to move inbound message to uplink queue %s",
                                status == errQUEUE_FULL ? "Queue is full" : "Unknown error");
+                command_limiter.counters.queue_full++;
+                reject_command(message.data, COMMAND_BUSY, 0);
             }
         break;
         case '\t': // This is a heartbeat message
+            TRACE_EVENT(TRACE_OTA_CHUNK, TRACE_OBJ_UPDATE_QUEUE, 0, length);
             update_handler->passData(data + 1, length - 2); // Pass the data to the update handler
         break;
         default:
-            DEBUG_PRINT("Received unknown message type %d", data[0]);
+            LOG_WARN("Received unknown message type %d", data[0]);
             return; // Ignore unknown message types
     }
 }
@@ -145,22 +312,23 @@ void NetworkInterface::flush_downlink_queue() {
     downlink_message_t message;
     while (true) {
         if (this->downlink_queue == nullptr) {
-            DEBUG_PRINT("Downlink queue is not initialized, cannot flush");
+            LOG_ERROR("Downlink queue is not initialized, cannot flush");
             return;
         }
         esp_task_wdt_reset();
-        if (xQueueReceive(downlink_queue, &message, 100) == pdTRUE) {
+        if (xQueueReceive(downlink_queue, &message, pdMS_TO_TICKS(DOWNLINK_IDLE_WAKE)) == pdTRUE) {
+            TRACE_EVENT(TRACE_QUEUE_RECEIVE, TRACE_OBJ_DOWNLINK_QUEUE, message.id, 0);
             analogWrite(ACTIVITY_LED, 32);
             if (WiFi.status() != WL_CONNECTED) {
-                DEBUG_PRINT("WiFi is not connected, skipping message");
+                LOG_WARN("WiFi is not connected, skipping message");
                 analogWrite(ACTIVITY_LED, 0);
                 break;
             }
             if (!datalink_client->connected()) {
-                DEBUG_PRINT("Socket is not connected, attempting to reconnect");
+                LOG_WARN("Socket is not connected, attempting to reconnect");
                 this->establish_connection();
                 if (!datalink_client->connected()) {
-                    DEBUG_PRINT("Failed to reconnect to server, skipping message");
+                    LOG_ERROR("Failed to reconnect to server, skipping message");
                     analogWrite(ACTIVITY_LED, 0);
                     continue; // Skip this message if we can't reconnect
                 }
@@ -169,16 +337,22 @@ void NetworkInterface::flush_downlink_queue() {
             // Init a timer to keep track of how long it takes to send a message
             const uint32_t start_time = micros();
             message.data[message.length] = '\0'; // Ensure the last byte is a null terminator
-            const auto wrote = datalink_client->write(message.data, message.length + 1); // +1 for the null terminator
+            size_t wrote;
+            {
+                PROFILE_ZONE("WiFiClient::write");
+                POWER_LOCK(POWER_LOCK_NETWORK);
+                wrote = datalink_client->write(message.data, message.length + 1); // +1 for the null terminator
+            }
             if (wrote != message.length + 1) {
-                DEBUG_PRINT("Failed to write downlink message, wrote %d != %d bytes",
-                               wrote, message.length + 1);
+                LOG_ERROR("Failed to write downlink message, wrote %u != %u bytes",
+                    static_cast<unsigned>(wrote), static_cast<unsigned>(message.length + 1));
                 analogWrite(ACTIVITY_LED, 0);
                 continue; // Skip this message if we can't write it
             }
-            DEBUG_PRINT("Downlink sent [%d bytes] in %dus [%.03f KB/s] [Queue Time: %.02fms]",
-                message.length,
-                micros() - start_time,
+            TRACE_EVENT(TRACE_MSG_SENT, TRACE_OBJ_NONE, message.id, micros() - start_time);
+            LOG_DEBUG("Downlink sent [%u bytes] in %uus [%.03f KB/s] [Queue Time: %.02fms]",
+                static_cast<unsigned>(message.length),
+                static_cast<unsigned>(micros() - start_time),
                 message.length / ((micros() - start_time) / 1000000.0f) / 1024.0f,
                 queue_time / 1000.0f);
             last_transmission = millis();
@@ -191,7 +365,7 @@ void NetworkInterface::flush_downlink_queue() {
 
 BaseType_t NetworkInterface::uplink_queue_receive(uplink_message_t* message, const TickType_t waitTime) const {
     if (this->uplink_queue == nullptr) {
-        DEBUG_PRINT("Uplink queue is not initialized, cannot get message");
+        LOG_ERROR("Uplink queue is not initialized, cannot get message");
         return pdFALSE;
     }
     return xQueueReceive(this->uplink_queue, message, waitTime);
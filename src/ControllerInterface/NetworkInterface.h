@@ -10,15 +10,30 @@
 #include "secrets.h"
 #include "debug.h"
 #include "UpdateHandler.h"
+#include "Trace/Trace.h"
+#include "Profile/Profile.h"
+#include "Boot/BootTimeline.h"
+#include "WifiJoin/WifiJoin.h"
+#include "Power/Power.h"
+#include "DatagramChannel.h"
+#include "RoomInterfaceDatastructures.h"
+#include "CommandLimiter.h"
+#include "Clock/Clock.h"
+
+#include <atomic>
 
 #define ACTIVITY_LED 2
 #define LEDC_CHANNEL 0
 #define LEDC_FREQUENCY_NO_WIFI 6
 #define LEDC_FREQUENCY_NO_LINK 1
 #define LEDC_TIMER 13
+#define DOWNLINK_IDLE_WAKE 2000 // (ms) The downlink task wakes this often without messages, to feed the watchdog
+#define LINK_DOWN_RESTART 900000 // (ms) The health check restarts a satellite whose link stays down this long
 
 class NetworkInterface {
 
+    friend struct BenchAccess; // The benchmarks (bench/) drive the queues without a connection
+
 public:
 
     typedef enum {
@@ -34,12 +49,14 @@ public:
         char data[4096];
         size_t length;
         uint32_t timestamp;
+        uint32_t id; // Follows the message through the trace, 0 without TRACE
     } downlink_message_t;
 
     typedef struct {
         char data[4096];
         size_t length;
-        uint32_t timestamp;
+        uint64_t timestamp; // (us) clockMicros() when the command came off the socket, the clock sync's t3
+        uint32_t id; // Follows the message through the trace, 0 without TRACE
     } uplink_message_t;
 
 private:
@@ -55,30 +72,105 @@ private:
     TaskHandle_t uplink_task_handle = nullptr;
     TaskHandle_t downlink_task_handle = nullptr;
 
-    static void poll_uplink_buffer(void *pvParameters);
+    std::atomic<bool> link_up{false}; // Connected to CENTRAL and the device info was accepted
+    TickType_t link_up_since = 0;
+    TickType_t link_down_since = 0;
+    SemaphoreHandle_t link_up_signal = nullptr; // Given every time the link comes up
+
+    void wait_for_wifi();
+
+    void add_image_hash();
+
+    void bring_up_link();
+
+    [[noreturn]] static void poll_uplink_buffer(void *pvParameters);
 
     void flush_downlink_queue();
 
     void handle_uplink_data(const uint8_t* data, size_t length) const;
 
+    void reject_command(const char* command, command_status_t status, uint32_t retry_ms) const;
+
+    void report_overload() const;
+
+    mutable CommandLimiter command_limiter; // Only the uplink task uses it
+    mutable uint32_t last_overload_report = 0;
+
     WiFiClient* datalink_client = nullptr;
     uint32_t last_connection_attempt = 0;
     uint32_t last_transmission = 0;
 
     UpdateHandler *update_handler = new UpdateHandler();
 
+#ifdef CENTRAL_UDP_PORT
+    DatagramChannel datagram_channel;
+#endif
+    std::atomic<uint32_t> urgent_sequence{0};
+
 public:
 
     NetworkInterface() = default;
 
-    static void downlink_task(void *pvParameters);
+    [[noreturn]] static void downlink_task(void *pvParameters);
 
-    void begin(const char* device_info, size_t device_info_length);
+    /**
+     * Creates the queues and starts the network tasks, WiFi and the connection to CENTRAL come up in the background.
+     * Messages queued before the link is up are dropped.
+     * @param name The satellite name, identifies the datagrams to CENTRAL.
+     * @param link_up_signal If not null, given every time the link to CENTRAL comes up.
+     */
+    void begin(const char* name, const char* device_info, size_t device_info_length, SemaphoreHandle_t link_up_signal = nullptr);
 
     void establish_connection();
 
     void queue_message(const char *data, size_t length) const;
 
+    /**
+     * Finds a command's "req_id" without parsing it, for commands that are dropped or don't parse.
+     * @return 0 if the command has none.
+     */
+    static uint32_t scan_request_id(const char* command) {
+        const char* request = strstr(command, "\"req_id\"");
+        if (request == nullptr) return 0;
+        request = strchr(request + 8, ':');
+        return request == nullptr ? 0 : strtoul(request + 1, nullptr, 10);
+    }
+
+    /**
+     * Sends a small, latency critical message over the datagram channel, or the TCP stream if it is disabled or
+     * can't take the message. The message must carry the sequence number as "seq" for CENTRAL to drop duplicates.
+     */
+    void queue_urgent(const char *data, size_t length, uint32_t sequence) const;
+
+    uint32_t next_urgent_sequence() {
+        return ++urgent_sequence;
+    }
+
+    bool linkUp() const {
+        return link_up.load();
+    }
+
+    /**
+     * @return The tick the link last came up at, only meaningful while linkUp().
+     */
+    TickType_t linkUpSince() const {
+        return link_up_since;
+    }
+
+    /**
+     * @return The tick the link last went down at, only meaningful while !linkUp().
+     */
+    TickType_t linkDownSince() const {
+        return link_down_since;
+    }
+
+    /**
+     * @return Where the last OTA transfer stands, for the state updates.
+     */
+    UpdateHandler::Progress otaProgress() const {
+        return update_handler->progress();
+    }
+
     BaseType_t uplink_queue_receive(uplink_message_t* message, TickType_t ticks_to_wait) const;
 
 };
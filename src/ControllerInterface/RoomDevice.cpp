@@ -4,27 +4,29 @@
 
 #include "RoomDevice.h"
 
-class RoomInterface;
-extern RoomInterface MainRoomInterface;
-
-ParsedEvent_t *RoomDevice::getScratchSpace() {
-    return MainRoomInterface.get_free_scratch_space();
+ParsedEvent_t *RoomDevice::getScratchSpace() const {
+    auto* event = roomInterface->get_free_scratch_space(); // Claimed until sendEvent cleans it up
+    if (event != nullptr) {
+        event->timestamp = clockMicros(); // Devices fetch the scratch space as the event happens
+        event->urgent = false;
+    }
+    return event;
 }
 
 char* RoomDevice::writeStringToScratchSpace(const char *string, ParsedEvent_t *scratchSpace) {
     return RoomInterface::write_string_to_scratch_space(string, scratchSpace);
 }
 
-void RoomDevice::sendEvent(ParsedEvent_t *data) {
-    MainRoomInterface.sendEvent(data);
+void RoomDevice::sendEvent(ParsedEvent_t *data) const {
+    roomInterface->sendEvent(data);
 }
 
 void RoomDevice::uplinkNow() {
-    MainRoomInterface.downlinkNow(this->getObjectName());
+    roomInterface->downlinkNow(this->getObjectName());
 }
 
-RoomDevice::RoomDevice() {
-    MainRoomInterface.addDevice(this);
+RoomDevice::RoomDevice(RoomInterface* room_interface) : roomInterface(room_interface) {
+    roomInterface->addDevice(this);
     deviceData["state"] = JsonObject();
     deviceData["actions"] = JsonObject();
     deviceData["info"] = JsonObject();
@@ -50,13 +52,16 @@ void RoomDevice::addEventCallback(const char* event_name, void (*callback)(RoomD
     eventCallbacks = newCallback;
 }
 
-void RoomDevice::processEvent(const char* event, const ParsedEvent_t* data) {
+bool RoomDevice::processEvent(const char* event, const ParsedEvent_t* data) {
     const auto* current = eventCallbacks;
+    bool handled = false;
     while (current != nullptr) {
         if (strcmp(current->event_name, event) == 0) {
             // Serial.print("Processing Event: ");
             current->callback(this, data);
+            handled = true;
         }
         current = current->next;
     }
+    return handled;
 }
@@ -9,6 +9,7 @@
 #include <ArduinoJson.h>
 #include "RoomInterfaceDatastructures.h"
 #include "RoomInterface.h"
+#include "Snapshot/Snapshot.h"
 
 
 class RoomInterface;
@@ -41,6 +42,9 @@ private:
     EventCallbackList* eventCallbacks = nullptr;
 
 protected:
+
+    RoomInterface* roomInterface; // The interface this device is bound to, events and uplinks go through it
+
     /**
      * This function is called by the subclass to add an event callback to the list of callbacks.
      * @param event_name The name of the event that the callback will be fired on.
@@ -50,11 +54,30 @@ protected:
         void (*callback)(RoomDevice* self,
         const ParsedEvent_t* data));
 
-    static ParsedEvent_t* getScratchSpace();
+    ParsedEvent_t* getScratchSpace() const;
 
     static char* writeStringToScratchSpace(const char* string, ParsedEvent_t* scratchSpace);
 
-    static void sendEvent(ParsedEvent_t* event) ;
+    void sendEvent(ParsedEvent_t* event) const;
+
+    /**
+     * Reads the state this device saved before the last restart (see Snapshot/Snapshot.h), meant for the constructor.
+     * @tparam State A trivially copyable struct with a static constexpr uint8_t VERSION, bump it when the layout
+     * changes so a snapshot from older firmware is ignored.
+     * @return False on a cold boot.
+     */
+    template<typename State>
+    bool restoreState(State* state) {
+        return snapshotRead(getObjectName(), State::VERSION, state);
+    }
+
+    /**
+     * Saves the state to be restored after a restart, call it whenever the state changes.
+     */
+    template<typename State>
+    void saveState(const State& state) {
+        snapshotWrite(getObjectName(), State::VERSION, state);
+    }
 
 public:
     /**
@@ -62,8 +85,9 @@ public:
      * that the event actually exists and to call the appropriate callback.
      * @param event The event to process.
      * @param data JSON data associated with the event. (Array of key-value pairs)
+     * @return False if the device has no callback for the event.
      */
-    void processEvent(const char* event, const ParsedEvent_t* data);
+    bool processEvent(const char* event, const ParsedEvent_t* data);
 
     virtual const char* getObjectName() const {
         return nullptr;
@@ -81,7 +105,10 @@ public:
         return nullptr;
     }
 
-    RoomDevice();
+    /**
+     * @param room_interface The interface the device registers with, it must outlive the device.
+     */
+    explicit RoomDevice(RoomInterface* room_interface);
 
     /**
      * This function is called by the RoomInterface to get the device data object, and update it with the latest
@@ -2,38 +2,48 @@
 // Created by Jay on 10/12/2024.
 //
 
+#define LOG_MODULE LOG_MODULE_INTERFACE
+
 #include "RoomInterface.h"
+#include "DeviceRegistry.h"
 #include "build_info.h"
 
-class RoomDevice;
+#include <algorithm>
 
-// Instantiate the singleton instance of the RoomInterface
-auto MainRoomInterface = RoomInterface();
+class RoomDevice;
 
 void RoomInterface::begin(const char* device_name) {
-    DEBUG_PRINT("Initializing Room Interface");
+    LOG_INFO("Initializing Room Interface");
     if (device_name == nullptr) {
-        DEBUG_PRINT("Device name is null, cannot initialize Room Interface");
+        LOG_ERROR("Device name is null, cannot initialize Room Interface");
         return; // Exit if the device name is null
     }
     deviceName = const_cast<char*>(device_name); // Set the device name
-    // The network interface runs on Core 0
+    rules.begin();
+    // The network interface runs on Core 0, it connects in the background and wakes the interface loop for a full
+    // state update every time the link comes up.
     const auto info_size = getDeviceInfo(downlink_buffer);
-    networkInterface->begin(downlink_buffer, info_size);
-    for (auto & i : argumentScratchSpace) {
-        i.finished = true;
-    }
+    networkInterface->begin(deviceName, downlink_buffer, info_size, downlinkSemaphore);
+    // The interface loop starts the device tasks, it doesn't wait for the network.
     xTaskCreate(interfaceLoop,"interfaceLoop", 8192,
         this,2, &roomInterfaceTaskHandle);
     xTaskCreate(eventLoop, "eventLoop",8192,
         this, 2, &eventLoopTaskHandle);
-    xTaskCreate(interfaceHealthCheck,"interfaceHealthCheck",1024,
+    // The health check formats and flushes the log (and the trace) itself before it restarts.
+    xTaskCreate(interfaceHealthCheck,"interfaceHealthCheck",4096,
         this, 0, &interfaceHealthCheckTaskHandle);
-    startDeviceLoops();
-    DEBUG_PRINT("Room Interface Initialized");
+    LOG_INFO("Room Interface Initialized");
 }
 
 size_t RoomInterface::getDeviceInfo(char* buffer) const {
+    if (registry != nullptr) { // The registry payload was built at compile time
+        size_t length = 0;
+        const auto* info = registry->getDeviceInfo(&length);
+        memset(buffer, 0, 1024); // Clear the buffer
+        memcpy(buffer, info, length);
+        LOG_DEBUG("Using static device info payload: %s", buffer);
+        return length;
+    }
     auto payload = JsonDocument();
     const auto root = payload.to<JsonObject>();
     root["name"] = deviceName;
@@ -41,28 +51,44 @@ size_t RoomInterface::getDeviceInfo(char* buffer) const {
     root["branch"]  = BUILD_GIT_BRANCH; // Use the build branch from the build_info.h
     root["sub_device_count"] = getDeviceCount();
     root["sub_devices"] = JsonObject();
+    root["cmd_window"] = COMMAND_WINDOW; // Commands CENTRAL may have in flight
     root["msg_type"] = "device_info"; // This is a device info message
     size_t index = 0;
     for (auto current = devices; current != nullptr; current = current->next) {
         root["sub_devices"][current->device->getObjectName()] = current->device->getObjectType();
     }
-    DEBUG_PRINT("Created device info payload with %d sub devices", root["sub_devices"].size());
+    LOG_DEBUG("Created device info payload with %u sub devices",
+        static_cast<unsigned>(root["sub_devices"].size()));
     // Serialize the json data into the buffer.
     memset(buffer, 0, 1024); // Clear the buffer
     const auto serialized = serializeJson(payload, buffer, 1024);
     if (serialized == 0) {
-        DEBUG_PRINT("Failed to serialize device info payload");
+        LOG_ERROR("Failed to serialize device info payload");
         return 0; // Return 0 on failure
     }
-    DEBUG_PRINT("Serialized device info payload: %s", buffer);
+    LOG_DEBUG("Serialized device info payload: %s", buffer);
     return serialized; // Return the size of the serialized data
 }
 
-void RoomInterface::startDeviceLoops() const {
+size_t RoomInterface::getDeviceCount() const {
+    if (registry != nullptr) return registry->getDeviceCount();
+    size_t count = 0;
     for (auto current = devices; current != nullptr; current = current->next) {
-        DEBUG_PRINT("Starting Task: %s", current->device->getObjectName());
-        current->device->startTask(&current->taskHandle);
+        count++;
     }
+    return count;
+}
+
+void RoomInterface::startDeviceLoops() const {
+    if (registry != nullptr) {
+        registry->startDeviceLoops();
+    } else {
+        for (auto current = devices; current != nullptr; current = current->next) {
+            LOG_INFO("Starting Task: %s", current->device->getObjectName());
+            current->device->startTask(&current->taskHandle);
+        }
+    }
+    bootMark(BOOT_DEVICES_STARTED);
 }
 
 /**
@@ -77,41 +103,98 @@ void RoomInterface::sendDownlink() {
     root["mcu_temp"] = temperatureRead(); // MCU temperature in degrees Celsius
     root["objects"] = JsonObject();
     root["msg_type"] = "state_update"; // This is a downlink message
-    for (auto current = devices; current != nullptr; current = current->next) {
-        if (downlink_target_device != nullptr && // If exclusive downlink is requested, only send the target device
-            strcmp(current->device->getObjectName(), downlink_target_device) != 0) {
-            continue;
-        } // Otherwise, add all devices to the downlink.
-        const auto deviceData = current->device->getDeviceData();
-        root["objects"][current->device->getObjectName()] = deviceData;
+    const auto ota = networkInterface->otaProgress();
+    if (ota.state != OTA_IDLE) { // Lets a rollout see how far each satellite got, and where it resumes
+        root["ota"]["state"] = otaStateName(ota.state);
+        root["ota"]["offset"] = ota.committed;
+        root["ota"]["size"] = ota.size;
+    }
+    stampClock(root, clockMicros()); // Sampled now
+    {
+        PROFILE_ZONE("getDeviceData");
+        if (registry != nullptr) registry->getDeviceData(root["objects"].to<JsonObject>(), downlink_target_device);
+        for (auto current = devices; current != nullptr; current = current->next) {
+            if (downlink_target_device != nullptr && // If exclusive downlink is requested, only send the target device
+                strcmp(current->device->getObjectName(), downlink_target_device) != 0) {
+                continue;
+            } // Otherwise, add all devices to the downlink.
+            const auto deviceData = current->device->getDeviceData();
+            root["objects"][current->device->getObjectName()] = deviceData;
+        }
     }
-    DEBUG_PRINT("Sending downlink: %s : %d", downlink_target_device == nullptr ? "All" : downlink_target_device,
-        root["objects"].size());
     if (downlink_target_device == nullptr) last_full_send = millis(); // Update the last full send time
+    if (subscriptions.active()) {
+        PROFILE_ZONE("SubscriptionTable::select");
+        JsonDocument selected;
+        const auto count = subscriptions.select(root["objects"].as<JsonObject>(), selected.to<JsonObject>(),
+            downlink_target_device == nullptr, millis());
+        root["objects"] = selected;
+        if (count == 0) { // Nothing CENTRAL subscribed to is due or changed
+            downlink_target_device = nullptr;
+            return;
+        }
+    }
+    LOG_DEBUG("Sending downlink: %s : %u", downlink_target_device == nullptr ? "All" : downlink_target_device,
+        static_cast<unsigned>(root["objects"].size()));
     downlink_target_device = nullptr; // Reset the exclusive downlink target device
     // Serialize the json data.
-    xSemaphoreTake(downlink_buffer_mutex, portMAX_DELAY); // Take the exclusive downlink mutex
+    TRACE_WAIT_BEGIN(TRACE_OBJ_DOWNLINK_BUFFER_MUTEX);
+    // Take the exclusive downlink mutex
+    [[maybe_unused]] const auto taken = xSemaphoreTake(downlink_buffer_mutex, portMAX_DELAY);
+    TRACE_WAIT_END(TRACE_OBJ_DOWNLINK_BUFFER_MUTEX, taken);
     memset(downlink_buffer, 0, sizeof(downlink_buffer)); // Clear the buffer
-    const auto serialized = serializeJson(payload, &downlink_buffer, sizeof(downlink_buffer));
+    size_t serialized;
+    {
+        PROFILE_ZONE("serializeJson:state_update");
+        serialized = serializeJson(payload, &downlink_buffer, sizeof(downlink_buffer));
+    }
     // Queue the message to be sent to CENTRAL
     networkInterface->queue_message(downlink_buffer, serialized);
     xSemaphoreGive(downlink_buffer_mutex); // Release the exclusive downlink mutex
     payload.clear();
 }
 
+/**
+ * Adds the frame's timestamp, and CENTRAL's clock offset once it is known (see Clock/Clock.h).
+ * @param timestamp (us) clockMicros() when what the frame reports happened.
+ */
+void RoomInterface::stampClock(const JsonObject& root, const uint64_t timestamp) {
+    static_assert(ARDUINOJSON_USE_LONG_LONG, "The timestamps need 64-bit JSON integers");
+    root["ts_us"] = timestamp;
+    if (clockSynced()) root["clock_offset_us"] = clockOffset();
+}
+
+/**
+ * Sends a report that aggregates since the last one (the profiling zones, the power residency) to the CENTRAL server.
+ */
+void RoomInterface::sendReport(size_t (*report)(char* buffer, size_t size), const char* name) {
+    TRACE_WAIT_BEGIN(TRACE_OBJ_DOWNLINK_BUFFER_MUTEX);
+    [[maybe_unused]] const auto taken = xSemaphoreTake(downlink_buffer_mutex, portMAX_DELAY);
+    TRACE_WAIT_END(TRACE_OBJ_DOWNLINK_BUFFER_MUTEX, taken);
+    const auto length = report(downlink_buffer, sizeof(downlink_buffer));
+    if (length > 0) {
+        networkInterface->queue_message(downlink_buffer, length);
+    } else {
+        LOG_WARN("%s report does not fit the downlink buffer", name);
+    }
+    xSemaphoreGive(downlink_buffer_mutex);
+}
+
 /**
  * Called when a device changes it's data and wants to send an uplink to the CENTRAL server immediately.
  * @param target_device The name of the device to send the uplink to. If null, nothing happens and this was pointless.
  */
 void RoomInterface::downlinkNow(char* target_device) {
+    TRACE_WAIT_BEGIN(TRACE_OBJ_EXCLUSIVE_DOWNLINK_MUTEX);
     const auto result = xSemaphoreTake(exclusive_downlink_mutex, 50);
+    TRACE_WAIT_END(TRACE_OBJ_EXCLUSIVE_DOWNLINK_MUTEX, result);
     if (result != pdTRUE) {
-        DEBUG_PRINT("Failed to take exclusive uplink mutex");
+        LOG_WARN("Failed to take exclusive uplink mutex");
         return;
     }
     if (downlink_target_device != nullptr) { // The uplink task is still processing a previous exclusive uplink
         xSemaphoreGive(exclusive_downlink_mutex); // Release the mutex and abort the uplink
-        DEBUG_PRINT("Failed to send exclusive uplink, previous uplink still processing");
+        LOG_WARN("Failed to send exclusive uplink, previous uplink still processing");
         return;
     }
     downlink_target_device = target_device;
@@ -130,15 +213,37 @@ void RoomInterface::downlinkNow(char* target_device) {
  * @noreturn
  */
 [[noreturn]] void RoomInterface::interfaceLoop(void *pvParameters) {
-    DEBUG_PRINT("Starting Room Interface Loop");
+    LOG_INFO("Starting Room Interface Loop");
     auto* roomInterface = static_cast<RoomInterface*>(pvParameters);
     // roomInterface->lastWakeTime = xTaskGetTickCount();
     roomInterface->startDeviceLoops();
     while (true) {
+        auto& subscriptions = roomInterface->subscriptions;
+        subscriptions.bind(roomInterface->networkInterface->linkUpSince());
         roomInterface->sendDownlink();
         // This will either block until the semaphore is given or timeout after the loopInterval and send the uplink.
-        if (millis() - roomInterface->last_full_send > 15000) roomInterface->sendDownlink();
-        xSemaphoreTake(roomInterface->downlinkSemaphore, roomInterface->loopInterval);
+        // With subscriptions the periodic updates follow their intervals instead.
+        if (!subscriptions.active() && millis() - roomInterface->last_full_send > 15000) roomInterface->sendDownlink();
+#ifdef PROFILE
+        if (millis() - roomInterface->last_diagnostics > PROFILE_REPORT_INTERVAL) {
+            roomInterface->last_diagnostics = millis();
+            roomInterface->sendReport(profileReport, "Diagnostics");
+        }
+#endif
+        if (roomInterface->linkUp() && clockSyncDue()) roomInterface->sendReport(clockSyncRequest, "Clock sync");
+        if (millis() - roomInterface->last_power_report > POWER_REPORT_INTERVAL) {
+            roomInterface->last_power_report = millis();
+            roomInterface->sendReport(powerReport, "Power");
+        }
+        TRACE_WAIT_BEGIN(TRACE_OBJ_DOWNLINK_SEMAPHORE);
+        auto wait = subscriptions.active()
+            ? pdMS_TO_TICKS(subscriptions.untilDue(millis(), 15000)) : roomInterface->loopInterval;
+        // The first exchanges are CLOCK_SYNC_RETRY_INTERVAL apart, much shorter than the update interval
+        if (roomInterface->linkUp()) {
+            wait = std::min(wait, static_cast<TickType_t>(pdMS_TO_TICKS(clockSyncUntilDue())));
+        }
+        [[maybe_unused]] const auto woken = xSemaphoreTake(roomInterface->downlinkSemaphore, wait);
+        TRACE_WAIT_END(TRACE_OBJ_DOWNLINK_SEMAPHORE, woken);
     }
 }
 
@@ -149,16 +254,24 @@ void RoomInterface::downlinkNow(char* target_device) {
  * @param pvParameters The RoomInterface instance.
  */
 [[noreturn]] void RoomInterface::eventLoop(void *pvParameters) {
-    DEBUG_PRINT("Starting Event Loop");
+    LOG_INFO("Starting Event Loop");
     auto* roomInterface = static_cast<RoomInterface*>(pvParameters);
     while (true) {
         // Check the uplink queue for new events.
         NetworkInterface::uplink_message_t message;
         if (roomInterface->networkInterface->uplink_queue_receive(&message, 100) == pdTRUE) {
-            DEBUG_PRINT("Received Event: %s", message.data);
+            TRACE_EVENT(TRACE_QUEUE_RECEIVE, TRACE_OBJ_UPLINK_QUEUE, message.id, 0);
+            LOG_DEBUG("Received Event: %s", message.data);
             // Parse the event data and execute the event.
-            auto* parsed = roomInterface->eventParse(message.data);
-            if (parsed != nullptr) roomInterface->eventExecute(parsed);
+            CommandResult_t result = {};
+            result.received = message.timestamp;
+            auto* parsed = roomInterface->eventParse(message.data, &result);
+            if (parsed != nullptr) {
+                TRACE_EVENT(TRACE_MSG_PARSED, TRACE_OBJ_NONE, message.id, 0);
+                result.status = roomInterface->eventExecute(parsed);
+                TRACE_EVENT(TRACE_MSG_EXECUTED, TRACE_OBJ_NONE, message.id, 0);
+            }
+            if (result.request_id != 0) roomInterface->sendCommandResult(result);
         }
         esp_task_wdt_reset();
     }
@@ -170,11 +283,16 @@ void RoomInterface::downlinkNow(char* target_device) {
  */
 void RoomInterface::sendEvent(ParsedEvent_t* event) {
     // return;
+    bus.publish(event); // Devices on this board see the event before CENTRAL does
+    rules.evaluate(event, this); // Local automation runs first, it doesn't wait for the link
     auto document = event->document;
     const auto root = document.to<JsonObject>();
     root["object"] = event->objectName;
     root["event"] = event->eventName;
     root["msg_type"] = "event"; // This is an event message
+    stampClock(root, event->timestamp);
+    const auto sequence = event->urgent ? networkInterface->next_urgent_sequence() : 0;
+    if (event->urgent) root["seq"] = sequence;
     root["args"] = JsonArray();
     for (int i = 0; i < event->numArgs; i++) {
         switch (event->args[i].type) {
@@ -195,10 +313,21 @@ void RoomInterface::sendEvent(ParsedEvent_t* event) {
     }
     // Implement the kwargs object later.
     root["kwargs"] = JsonObject();
-    xSemaphoreTake(downlink_buffer_mutex, portMAX_DELAY); // Take the exclusive downlink mutex
-    const auto serialized = serializeJson(document, &downlink_buffer, sizeof(downlink_buffer));
+    TRACE_WAIT_BEGIN(TRACE_OBJ_DOWNLINK_BUFFER_MUTEX);
+    // Take the exclusive downlink mutex
+    [[maybe_unused]] const auto taken = xSemaphoreTake(downlink_buffer_mutex, portMAX_DELAY);
+    TRACE_WAIT_END(TRACE_OBJ_DOWNLINK_BUFFER_MUTEX, taken);
+    size_t serialized;
+    {
+        PROFILE_ZONE("serializeJson:event");
+        serialized = serializeJson(document, &downlink_buffer, sizeof(downlink_buffer));
+    }
     // Queue the message to be sent to CENTRAL
-    networkInterface->queue_message(downlink_buffer, serialized);
+    if (event->urgent) {
+        networkInterface->queue_urgent(downlink_buffer, serialized, sequence);
+    } else {
+        networkInterface->queue_message(downlink_buffer, serialized);
+    }
     xSemaphoreGive(downlink_buffer_mutex); // Release the exclusive downlink mutex
     cleanup_scratch_space(event);
 }
@@ -214,24 +343,42 @@ void RoomInterface::sendEvent(ParsedEvent_t* event) {
  * @param data The json data to parse.
  * @return
  */
-ParsedEvent_t* RoomInterface::eventParse(const char* data) {
+ParsedEvent_t* RoomInterface::eventParse(const char* data, CommandResult_t* result) {
+    PROFILE_ZONE("eventParse");
+    CommandResult_t ignored = {};
+    if (result == nullptr) result = &ignored;
+    result->parsed = clockMicros();
+    // The clock sync's t3, queueing behind other commands on the satellite must not count as network delay
+    const auto received = result->received != 0 ? result->received : result->parsed;
     this->last_event_parse = xTaskGetTickCount();
-    auto* working_space = get_free_scratch_space();
-    if (working_space == nullptr) {
-        DEBUG_PRINT("Failed to get scratch space for event");
-        return nullptr;
-    }
-    working_space->finished = false;
-    // Parse the json data and fill the working space.
+    // Parse the json data first, the request id is needed to nack a command that finds no scratch space.
     event_document.clear();
     const DeserializationError error = deserializeJson(event_document, data);
     if (error) {
-        DEBUG_PRINT("deserializeJson() failed: %s", error.c_str());
+        LOG_ERROR("deserializeJson() failed: %s", error.c_str());
+        result->request_id = NetworkInterface::scan_request_id(data);
+        result->status = COMMAND_MALFORMED;
         return nullptr;
     }
     const auto root = event_document.as<JsonObject>();
-    char* object_ptr = write_string_to_scratch_space(root["sub_device_id"], working_space);
-    char* event_ptr = write_string_to_scratch_space(root["event_name"], working_space);
+    result->request_id = root["req_id"] | 0;
+    if (root["sub_device_id"] == CLOCK_OBJECT_NAME) { // The times don't fit an int arg, they are read here
+        const auto args = root["args"].as<JsonArray>();
+        clockSyncReply(args[0].as<uint64_t>(), args[1].as<uint64_t>(), args[2].as<uint64_t>(), received);
+        event_document.clear();
+        result->status = COMMAND_OK;
+        return nullptr;
+    }
+    auto* working_space = get_free_scratch_space();
+    if (working_space == nullptr) {
+        LOG_ERROR("Failed to get scratch space for event");
+        event_document.clear();
+        result->status = COMMAND_BUSY;
+        return nullptr;
+    }
+    working_space->timestamp = received;
+    char* object_ptr = write_string_to_scratch_space(root["sub_device_id"] | "", working_space);
+    char* event_ptr = write_string_to_scratch_space(root["event_name"] | "", working_space);
     working_space->objectName = object_ptr;
     working_space->eventName = event_ptr;
     // Parse the args array.
@@ -252,7 +399,10 @@ ParsedEvent_t* RoomInterface::eventParse(const char* data) {
                 write_string_to_scratch_space(arg.as<const char*>(), working_space);
             working_space->args[working_space->numArgs].type = ParsedArg::STRING;
         } else {
-            DEBUG_PRINT("Unknown arg type in event, aborting");
+            LOG_ERROR("Unknown arg type in event, aborting");
+            event_document.clear();
+            cleanup_scratch_space(working_space);
+            result->status = COMMAND_MALFORMED;
             return nullptr;
         }
         working_space->numArgs++;
@@ -261,30 +411,95 @@ ParsedEvent_t* RoomInterface::eventParse(const char* data) {
     return working_space;
 }
 
-void RoomInterface::eventExecute(ParsedEvent_t* event) const {
-    DEBUG_PRINT("Executing Event: %s", event->eventName);
+command_status_t RoomInterface::eventExecute(ParsedEvent_t* event) {
+    LOG_DEBUG("Executing Event: %s", event->eventName);
+    auto status = COMMAND_UNKNOWN_OBJECT;
+    if (strcmp(event->objectName, SUBSCRIPTION_OBJECT_NAME) == 0) {
+        subscriptions.bind(networkInterface->linkUpSince());
+        status = subscriptions.execute(event);
+        if (status == COMMAND_OK) xSemaphoreGive(downlinkSemaphore); // New subscriptions get their first update now
+        cleanup_scratch_space(event);
+        return status;
+    }
+    if (strcmp(event->objectName, RULES_OBJECT_NAME) == 0) {
+        bool report = false;
+        status = rules.execute(event, &report);
+        cleanup_scratch_space(event);
+        if (report) {
+            xSemaphoreTake(downlink_buffer_mutex, portMAX_DELAY);
+            const auto length = rules.report(downlink_buffer, sizeof(downlink_buffer));
+            if (length > 0) networkInterface->queue_message(downlink_buffer, length);
+            xSemaphoreGive(downlink_buffer_mutex);
+        }
+        return status;
+    }
+#ifdef TRACE
+    if (strcmp(event->objectName, TRACE_OBJECT_NAME) == 0 && strcmp(event->eventName, "dump") == 0) {
+        const bool serial = event->numArgs > 0 && event->args[0].type == ParsedArg::STRING &&
+            strcmp(event->args[0].value.stringVal, "serial") == 0;
+        if (serial) {
+            traceDumpSerial();
+        } else {
+            traceDump([](const char* data, const size_t length, void* context) {
+                static_cast<NetworkInterface*>(context)->queue_message(data, length);
+            }, networkInterface);
+        }
+        cleanup_scratch_space(event);
+        return COMMAND_OK;
+    }
+#endif
+    if (registry != nullptr) status = registry->eventExecute(event);
     for (auto current = devices; current != nullptr; current = current->next) {
         // Serial.printf("Checking Device: %s : %s\n", current->device->getObjectName(), event->objectName);
         if (strcmp(current->device->getObjectName(), event->objectName) == 0) {
             // Serial.printf("Sending Event to: %s\n", current->device->getObjectName());
-            current->device->processEvent(event->eventName, event);
+            if (current->device->processEvent(event->eventName, event)) {
+                status = COMMAND_OK;
+            } else if (status != COMMAND_OK) {
+                status = COMMAND_UNKNOWN_EVENT;
+            }
         }
     }
     // Clear the working space for the next event.
     cleanup_scratch_space(event);
-    event->finished = true;
+    return status;
+}
+
+/**
+ * Acks (or nacks) a command that carried a "req_id", queue_us is the time from the socket to the event task and
+ * exec_us the time spent parsing and executing it.
+ */
+void RoomInterface::sendCommandResult(const CommandResult_t& result) const {
+    char buffer[160];
+    const auto done = clockMicros();
+    const auto length = snprintf(buffer, sizeof(buffer),
+        R"({"msg_type":"%s","req_id":%lu,"code":%u,"status":"%s","queue_us":%lu,"exec_us":%lu})",
+        result.status == COMMAND_OK ? "ack" : "nack", static_cast<unsigned long>(result.request_id), result.status,
+        commandStatusName(result.status), static_cast<unsigned long>(result.parsed - result.received),
+        static_cast<unsigned long>(done - result.parsed));
+    networkInterface->queue_message(buffer, length);
 }
 
 [[noreturn]] void RoomInterface::interfaceHealthCheck(void* pvParameters) {
     const auto* roomInterface = static_cast<RoomInterface*>(pvParameters);
     while (true) {
-        // Check if the last event parse was more than 2 minutes ago.
-        if (xTaskGetTickCount() - roomInterface->last_event_parse > 120000) {
-            DEBUG_PRINT("Event Parse Timeout");
+        // Check if the last event parse was more than 2 minutes ago. CENTRAL only sends events over a live link,
+        // so the timeout runs from whichever is later, the last event or the link coming up.
+        const auto* network = roomInterface->networkInterface;
+        const auto since = std::max(roomInterface->last_event_parse, network->linkUpSince());
+        const bool parse_timeout = network->linkUp() && xTaskGetTickCount() - since > 120000;
+        // The connection is retried forever, a restart at least resets the WiFi stack
+        const bool link_timeout = !network->linkUp() && xTaskGetTickCount() - network->linkDownSince() > LINK_DOWN_RESTART;
+        if (parse_timeout || link_timeout) {
+            LOG_ERROR("%s", parse_timeout ? "Event Parse Timeout" : "Link Down Timeout");
+#ifdef TRACE
+            traceDumpSerial(); // The datalink is most likely what's broken
+#endif
+            logFlush();
             esp_restart();
         }
         esp_task_wdt_reset();
-        vTaskDelay(1000);
+        vTaskDelay(pdMS_TO_TICKS(5000)); // The timeout is minutes, more frequent checks only cut light sleeps short
     }
 }
 
@@ -8,6 +8,10 @@
 #include "NetworkInterface.h"
 #include "RoomDevice.h"
 #include "RoomInterfaceDatastructures.h"
+#include "Subscriptions.h"
+#include "LocalBus.h"
+#include "Clock/Clock.h"
+#include "Rules/RuleEngine.h"
 #include <ArduinoJson.h>
 #include <esp_task_wdt.h>
 
@@ -15,12 +19,16 @@
 #include <freertos/task.h>
 
 class RoomDevice;
+class DeviceRegistry;
 
-// Room Interface is a singleton class that all room devices will bind themselves to in order to be
-// controlled by the central controller.
+// A Room Interface is the connection of one satellite to the central controller, room devices are bound to the
+// interface they are constructed with. The firmware runs a single one, the host fleet simulation (native/fleet/) one
+// per simulated satellite.
 
 class RoomInterface {
 
+    friend struct BenchAccess; // The benchmarks (bench/) reach the network interface directly
+
     // Setup scratch space for storing the parsed arguments for multiple events so we don't have to malloc/free
     // every time we parse an event.
     char* deviceName = nullptr; // Name of the device this interface is running on
@@ -46,17 +54,30 @@ class RoomInterface {
         DeviceList* next;
     };
     DeviceList* devices = nullptr;
+    DeviceRegistry* registry = nullptr; // When set, replaces the device list (see DeviceRegistry.h)
 
     SemaphoreHandle_t downlinkSemaphore = xSemaphoreCreateBinary();
     SemaphoreHandle_t exclusive_downlink_mutex = xSemaphoreCreateMutex();
     TickType_t last_event_parse = 0;
 
     uint32_t last_full_send = 0; // Last time the downlink was sent
+#ifdef PROFILE
+    uint32_t last_diagnostics = 0; // Last time the profiling aggregates were sent
+#endif
+    uint32_t last_power_report = 0; // Last time the power residency was sent
+    SubscriptionTable subscriptions; // What CENTRAL wants in the state updates, everything until it subscribes
+    RuleEngine rules; // Local automation, checked against every device event
+    LocalBus bus;     // Device events for the other devices on this board
     char* downlink_target_device = nullptr;
 
 public:
 
-    RoomInterface() = default;
+    RoomInterface() {
+        // The scratch spaces are usable before begin() so devices can send events as soon as they are constructed.
+        for (auto & i : argumentScratchSpace) {
+            i.finished = true;
+        }
+    }
 
     size_t getDeviceInfo(char* buffer) const;
 
@@ -85,47 +106,77 @@ public:
         scratchSpace->finished = true;
     }
 
+    /**
+     * Claims a free scratch space, it stays claimed until cleanup_scratch_space() releases it. The device tasks,
+     * the event loop and the rule engine claim concurrently, so the claim is a compare-exchange on the flag.
+     * @return Null if every scratch space is in use.
+     */
     ParsedEvent_t* get_free_scratch_space() const {
         for (const auto & i : argumentScratchSpace) {
-            if (i.finished == true) {
-                return const_cast<ParsedEvent_t *>(&i);
-            }
+            auto& slot = const_cast<ParsedEvent_t&>(i);
+            bool free = true;
+            if (slot.finished.compare_exchange_strong(free, false)) return &slot;
         }
         return nullptr;
     }
 
+    /**
+     * Replaces the runtime device list with a compile-time registry, must be called before any device is constructed.
+     */
+    void setDeviceRegistry(DeviceRegistry* device_registry) {
+        registry = device_registry;
+    }
+
     void addDevice(RoomDevice* device) {
+        if (registry != nullptr) return; // The registry already knows about every device
         auto* newDevice = new DeviceList();
         newDevice->device = device;
         newDevice->next = devices;
         devices = newDevice;
     }
 
-    size_t getDeviceCount() const {
-        size_t count = 0;
-        for (auto current = devices; current != nullptr; current = current->next) {
-            count++;
-        }
-        return count;
+    size_t getDeviceCount() const;
+
+    LocalBus& localBus() {
+        return bus;
+    }
+
+    /**
+     * @return True while connected to CENTRAL.
+     */
+    bool linkUp() const {
+        return networkInterface->linkUp();
     }
 
     void startDeviceLoops() const;
 
+
     void sendDownlink(); // Send the uplink data to the network interface.
 
+    static void stampClock(const JsonObject& root, uint64_t timestamp);
+
+    // Send a report (profileReport, powerReport, clockSyncRequest) to the network interface, name is for the log.
+    void sendReport(size_t (*report)(char* buffer, size_t size), const char* name);
+
     void downlinkNow(char* target_device); // Set the uplink semaphore to send the uplink now instead of waiting for next timer.
 
-    static void interfaceLoop(void *pvParameters);
+    [[noreturn]] static void interfaceLoop(void *pvParameters);
 
-    static void eventLoop(void *pvParameters);
+    [[noreturn]] static void eventLoop(void *pvParameters);
 
-    static void interfaceHealthCheck(void* pvParameters);
+    [[noreturn]] static void interfaceHealthCheck(void* pvParameters);
 
     void sendEvent(ParsedEvent_t* event);
 
-    ParsedEvent_t* eventParse(const char* data);
+    /**
+     * @param result If not null, gets the command's request id, and the status if the command won't be executed.
+     * @return The parsed event, null if there is nothing to execute.
+     */
+    ParsedEvent_t* eventParse(const char* data, CommandResult_t* result = nullptr);
+
+    command_status_t eventExecute(ParsedEvent_t* event);
 
-    void eventExecute(ParsedEvent_t* event) const;
+    void sendCommandResult(const CommandResult_t& result) const;
 
 };
 
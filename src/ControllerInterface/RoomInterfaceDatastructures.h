@@ -5,6 +5,7 @@
 #ifndef ROOMINTERFACEDATASTRUCTURES_H
 #define ROOMINTERFACEDATASTRUCTURES_H
 #include <Arduino.h>
+#include <atomic>
 
 struct ParsedArg {
     union {
@@ -34,8 +35,40 @@ typedef struct {
     uint8_t numKwargs;
     char stringBuffer[512]; // .5KB buffer for storing string values and kwarg keys
     uint16_t stringIndex = 0;
-    bool finished;
+    uint64_t timestamp; // (us) clockMicros() when the event was created or received
+    bool urgent;        // Sent over the datagram channel when it is enabled (motion, faults)
+    std::atomic<bool> finished; // False while claimed, see RoomInterface::get_free_scratch_space()
     JsonDocument document;
 } ParsedEvent_t;
 
+// Commands CENTRAL may have in flight (sent, not yet acked), the uplink queue holds this many. Sent in device_info.
+#define COMMAND_WINDOW 5
+
+// Result of a command, sent back as "code" in the ack/nack when the command carried a "req_id".
+typedef enum : uint8_t {
+    COMMAND_OK,
+    COMMAND_BUSY,           // Dropped, the window or the scratch spaces were full. Safe to resend
+    COMMAND_MALFORMED,      // Not JSON, or an argument of an unsupported type
+    COMMAND_UNKNOWN_OBJECT, // No device with the sub_device_id
+    COMMAND_UNKNOWN_EVENT,  // The device has no callback for the event_name
+    COMMAND_RATE_LIMITED,   // Rejected before parsing, over the command rate (see CommandLimiter.h). Back off
+    COMMAND_STATUS_COUNT
+} command_status_t;
+
+/**
+ * @return The "status" string of an ack/nack.
+ */
+inline const char* commandStatusName(const command_status_t status) {
+    constexpr const char* NAMES[] = {"ok", "busy", "malformed", "unknown_object", "unknown_event", "rate_limited"};
+    static_assert(sizeof(NAMES) / sizeof(NAMES[0]) == COMMAND_STATUS_COUNT, "Every command status needs a name");
+    return status < COMMAND_STATUS_COUNT ? NAMES[status] : "unknown";
+}
+
+typedef struct {
+    uint32_t request_id;     // "req_id" of the command, 0 if CENTRAL doesn't want an ack
+    command_status_t status;
+    uint64_t received;       // (us) clockMicros() when the command came off the socket, 0 if unknown
+    uint64_t parsed;         // (us) clockMicros() when parsing started
+} CommandResult_t;
+
 #endif //ROOMINTERFACEDATASTRUCTURES_H
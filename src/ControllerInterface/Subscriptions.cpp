@@ -0,0 +1,178 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#define LOG_MODULE LOG_MODULE_INTERFACE
+
+#include "Subscriptions.h"
+#include "debug.h"
+
+#include <algorithm>
+
+namespace {
+
+uint32_t fnv1a(const char* data, const size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool isString(const ParsedEvent_t* event, const uint8_t index) {
+    return event->numArgs > index && event->args[index].type == ParsedArg::STRING;
+}
+
+}
+
+void SubscriptionTable::bind(const TickType_t link_up_since) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (link_up_since != link) {
+        if (count > 0) LOG_INFO("New connection, dropping %d subscription(s)", count);
+        count = 0;
+        link = link_up_since;
+    }
+    xSemaphoreGive(mutex);
+}
+
+SubscriptionTable::Subscription* SubscriptionTable::find(const char* device) {
+    for (uint8_t i = 0; i < count; i++) {
+        if (strcmp(entries[i].device, device) == 0) return &entries[i];
+    }
+    return nullptr;
+}
+
+command_status_t SubscriptionTable::execute(const ParsedEvent_t* event) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    auto status = COMMAND_UNKNOWN_EVENT;
+    if (strcmp(event->eventName, "subscribe") == 0) {
+        status = subscribe(event);
+    } else if (strcmp(event->eventName, "unsubscribe") == 0) {
+        status = COMMAND_MALFORMED;
+        if (isString(event, 0)) {
+            if (auto* entry = find(event->args[0].value.stringVal)) {
+                *entry = entries[--count]; // Order doesn't matter, fill the hole with the last entry
+            }
+            status = COMMAND_OK;
+        }
+    } else if (strcmp(event->eventName, "reset") == 0) {
+        count = 0;
+        status = COMMAND_OK;
+    }
+    xSemaphoreGive(mutex);
+    return status;
+}
+
+/**
+ * @note Must be called with the mutex held.
+ */
+command_status_t SubscriptionTable::subscribe(const ParsedEvent_t* event) {
+    if (!isString(event, 0) || !isString(event, 1) || event->numArgs < 4 || event->args[2].type != ParsedArg::INT ||
+        event->args[3].type != ParsedArg::BOOL || event->args[2].value.intVal < 0) {
+        return COMMAND_MALFORMED;
+    }
+    const char* device = event->args[0].value.stringVal;
+    if (strlen(device) >= SUBSCRIPTION_NAME_LENGTH) return COMMAND_MALFORMED;
+    auto* entry = find(device);
+    if (entry == nullptr) {
+        if (count == SUBSCRIPTION_MAX) {
+            LOG_WARN("Subscription table is full, rejecting %s", device);
+            return COMMAND_BUSY;
+        }
+        entry = &entries[count];
+    }
+    Subscription subscription = {};
+    strcpy(subscription.device, device);
+    // Split the field list in place of a copy, the scratch space string stays untouched
+    const char* field = event->args[1].value.stringVal;
+    while (*field != '\0') {
+        const char* end = strchr(field, ',');
+        const size_t length = end == nullptr ? strlen(field) : end - field;
+        if (length > 0) {
+            if (subscription.field_count == SUBSCRIPTION_MAX_FIELDS || length >= SUBSCRIPTION_NAME_LENGTH) {
+                return COMMAND_MALFORMED;
+            }
+            memcpy(subscription.fields[subscription.field_count], field, length);
+            subscription.fields[subscription.field_count++][length] = '\0';
+        }
+        if (end == nullptr) break;
+        field = end + 1;
+    }
+    const auto interval = static_cast<uint32_t>(event->args[2].value.intVal);
+    subscription.interval = interval == 0 ? 0 : std::max<uint32_t>(interval, SUBSCRIPTION_MIN_INTERVAL);
+    subscription.on_change = event->args[3].value.boolVal;
+    subscription.pending = true;
+    if (entry == &entries[count]) count++;
+    *entry = subscription;
+    LOG_INFO("Subscribed to %s, %d field(s) every %lums%s", device, subscription.field_count,
+        static_cast<unsigned long>(subscription.interval), subscription.on_change ? " and on change" : "");
+    return COMMAND_OK;
+}
+
+void SubscriptionTable::copyFields(const JsonObject& device, const Subscription& entry, const JsonObject& out) {
+    if (entry.field_count == 0) {
+        for (const auto group : device) out[group.key().c_str()] = group.value();
+        return;
+    }
+    for (uint8_t i = 0; i < entry.field_count; i++) {
+        const char* field = entry.fields[i];
+        const char* member = strchr(field, '.');
+        if (member == nullptr) {
+            if (!device[field].isNull()) out[field] = device[field];
+            continue;
+        }
+        char group[SUBSCRIPTION_NAME_LENGTH];
+        memcpy(group, field, member - field);
+        group[member - field] = '\0';
+        member++;
+        if (!device[group][member].isNull()) out[group][member] = device[group][member];
+    }
+}
+
+size_t SubscriptionTable::select(const JsonObject& objects, JsonObject selected, const bool periodic,
+                                 const uint32_t now) {
+    size_t selected_count = 0;
+    char buffer[SUBSCRIPTION_HASH_BUFFER];
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (const auto device : objects) {
+        const char* name = device.key().c_str();
+        auto* entry = find(name);
+        if (entry == nullptr) continue;
+        const bool due = entry->pending ||
+            (periodic ? entry->interval != 0 && now - entry->last_sent >= entry->interval : entry->on_change);
+        if (!due) continue;
+        const auto out = selected[name].to<JsonObject>();
+        copyFields(device.value().as<JsonObject>(), *entry, out);
+        const auto length = serializeJson(out, buffer, sizeof(buffer));
+        const auto hash = length < sizeof(buffer) - 1 ? fnv1a(buffer, length) : entry->last_hash + 1;
+        if (!periodic && !entry->pending && hash == entry->last_hash) { // Pushed, but nothing subscribed to changed
+            selected.remove(name);
+            continue;
+        }
+        entry->pending = false;
+        entry->last_sent = now;
+        entry->last_hash = hash;
+        selected_count++;
+    }
+    xSemaphoreGive(mutex);
+    return selected_count;
+}
+
+uint32_t SubscriptionTable::untilDue(const uint32_t now, const uint32_t idle) {
+    uint32_t wait = idle;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (uint8_t i = 0; i < count; i++) {
+        const auto& entry = entries[i];
+        if (entry.pending) {
+            wait = 0;
+            break;
+        }
+        if (entry.interval == 0) continue;
+        const auto elapsed = now - entry.last_sent;
+        const auto remaining = elapsed >= entry.interval ? 0 : entry.interval - elapsed;
+        if (remaining < wait) wait = remaining;
+    }
+    xSemaphoreGive(mutex);
+    return wait;
+}
@@ -0,0 +1,93 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#ifndef SUBSCRIPTIONS_H
+#define SUBSCRIPTIONS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "RoomInterfaceDatastructures.h"
+
+#define SUBSCRIPTION_OBJECT_NAME   "Subscriptions"
+#define SUBSCRIPTION_MAX           8
+#define SUBSCRIPTION_MAX_FIELDS    4
+#define SUBSCRIPTION_NAME_LENGTH   32   // Device names and field paths, including the null terminator
+#define SUBSCRIPTION_MIN_INTERVAL  250  // (ms) Faster periodic updates are clamped to this
+#define SUBSCRIPTION_HASH_BUFFER   1024 // (bytes) A selection that serializes larger is always treated as changed
+
+/**
+ * The devices, fields and rates CENTRAL asked for over the current connection. Without any subscription every
+ * state_update carries every device in full (the default), once CENTRAL subscribes only the subscribed devices are
+ * sent, trimmed to the subscribed fields. Commands go to the "Subscriptions" object:
+ *  subscribe   [device, fields, interval_ms, on_change]
+ *      fields is a comma separated list of groups ("state") or group members ("health.online"), "" for everything.
+ *      interval_ms sends the selection periodically, 0 for never.
+ *      on_change sends the selection when the device pushes an update (uplinkNow) and a subscribed field changed.
+ *      Replaces an earlier subscription to the same device, the first update is sent straight away.
+ *  unsubscribe [device]
+ *  reset       [] Back to every device in full.
+ * Subscriptions belong to a connection, they are dropped when the link to CENTRAL comes up again.
+ */
+class SubscriptionTable {
+
+    struct Subscription {
+        char device[SUBSCRIPTION_NAME_LENGTH];
+        char fields[SUBSCRIPTION_MAX_FIELDS][SUBSCRIPTION_NAME_LENGTH];
+        uint8_t field_count;  // 0 for every field
+        uint32_t interval;    // (ms) 0 for never
+        bool on_change;
+        bool pending;         // Not sent since subscribing
+        uint32_t last_sent;   // (ms)
+        uint32_t last_hash;   // FNV-1a of the last selection sent
+    };
+
+    Subscription entries[SUBSCRIPTION_MAX] = {};
+    uint8_t count = 0;
+    TickType_t link = 0; // linkUpSince() of the connection the subscriptions were made on
+    SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
+
+    Subscription* find(const char* device);
+
+    command_status_t subscribe(const ParsedEvent_t* event);
+
+    static void copyFields(const JsonObject& device, const Subscription& entry, const JsonObject& out);
+
+public:
+
+    /**
+     * Drops the subscriptions made over an earlier connection.
+     * @param link_up_since NetworkInterface::linkUpSince() of the current connection.
+     */
+    void bind(TickType_t link_up_since);
+
+    /**
+     * @return True if CENTRAL subscribed, false while every device is sent in full.
+     */
+    bool active() const {
+        return count > 0;
+    }
+
+    /**
+     * Runs a subscribe, unsubscribe or reset command.
+     */
+    command_status_t execute(const ParsedEvent_t* event);
+
+    /**
+     * Copies the subscribed fields of the devices that are due into selected.
+     * @param objects The "objects" of a state_update.
+     * @param periodic True for the periodic update, false for a device's push (uplinkNow).
+     * @return The number of devices selected, nothing needs to be sent if 0.
+     */
+    size_t select(const JsonObject& objects, JsonObject selected, bool periodic, uint32_t now);
+
+    /**
+     * @return (ms) Until the next periodic subscription is due, idle if there is none.
+     */
+    uint32_t untilDue(uint32_t now, uint32_t idle);
+
+};
+
+#endif //SUBSCRIPTIONS_H
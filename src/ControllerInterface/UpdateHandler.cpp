@@ -2,133 +2,603 @@
 // Created by Jay on 7/27/2025.
 //
 
+#define LOG_MODULE LOG_MODULE_UPDATE
+
 #include "UpdateHandler.h"
+#include "NetworkInterface.h"
 
 #include <esp32-hal.h>
 #include <HardwareSerial.h>
 
 #include "debug.h"
 
+#include <algorithm>
+#include <esp_task_wdt.h>
+
+namespace {
+
+/**
+ * Re-adds the null characters the network interface can't carry.
+ * @param consumed Set to the escaped bytes used.
+ * @return The bytes written to out, at most room.
+ */
+size_t unescape(const uint8_t* data, const size_t length, size_t* consumed, uint8_t* out, const size_t room) {
+    size_t i = 0;
+    size_t produced = 0;
+    while (i < length && produced < room) {
+        if (data[i] != NULL_TERM_ESCAPE) {
+            out[produced++] = data[i++];
+        } else if (i + 1 < length && data[i + 1] == NULL_TERM_REPLACE) {
+            out[produced++] = '\0';
+            i += 2;
+        } else if (i + 1 < length && data[i + 1] == NULL_TERM_ESCAPE_REPLACE) {
+            out[produced++] = NULL_TERM_ESCAPE;
+            i += 2;
+        } else {
+            LOG_ERROR("Invalid escape sequence in data at position %zu", i);
+            i++;
+        }
+    }
+    *consumed = i;
+    return produced;
+}
+
+uint32_t readLittleEndian(const uint8_t* data) {
+    return data[0] | data[1] << 8 | data[2] << 16 | static_cast<uint32_t>(data[3]) << 24;
+}
+
+/**
+ * Reads and drops a payload that has nowhere to go.
+ */
+bool skip(WiFiClient* client, uint32_t length) {
+    uint8_t discard[256];
+    while (length > 0) {
+        const auto chunk = length < sizeof(discard) ? length : sizeof(discard);
+        if (client->readBytes(discard, chunk) != chunk) return false;
+        length -= chunk;
+    }
+    return true;
+}
+
+struct RunningImage {
+    bool hashed = false;
+    uint8_t hash[OTA_HASH_SIZE] = {};
+    char hex[2 * OTA_HASH_SIZE + 1] = {};
+};
+
+RunningImage hashRunningImage() {
+    RunningImage image;
+    const auto* running = esp_ota_get_running_partition();
+    const auto err = running == nullptr ? ESP_ERR_NOT_FOUND : esp_partition_get_sha256(running, image.hash);
+    if (err != ESP_OK) {
+        LOG_WARN("Could not hash the running image, delta OTA updates are refused: %s", esp_err_to_name(err));
+        return image;
+    }
+    image.hashed = true;
+    for (size_t i = 0; i < OTA_HASH_SIZE; i++) snprintf(image.hex + 2 * i, 3, "%02x", image.hash[i]);
+    LOG_INFO("Running image %.8s", image.hex);
+    return image;
+}
+
+/**
+ * SHA-256 of the running image, hashed on the first call. That is the network task adding it to the device info
+ * (NetworkInterface::add_image_hash), after the devices started, or a patch begin, whichever comes first.
+ */
+const RunningImage& runningImage() {
+    static const RunningImage image = hashRunningImage();
+    return image;
+}
+
+}
+
+const char* UpdateHandler::runningImageHash() {
+    return runningImage().hex;
+}
 
 [[noreturn]] void UpdateHandler::updateTask(void* pvParameters) {
     auto* self = static_cast<UpdateHandler*>(pvParameters);
-    DEBUG_PRINT("Starting Update Handler Task");
+    LOG_INFO("Starting Update Handler Task");
     while (true) {
         self->handleUpdate();
     }
 }
 
-void UpdateHandler::passData(const uint8_t* data, const size_t length) const {
-    if (incomingDataQueue == nullptr) {
-        return; // Queue not initialized
+/**
+ * Reads a begin payload, OTA_FRAME_BEGIN: size, optionally SHA-256; OTA_FRAME_PATCH: size, SHA-256, patch length,
+ * base.
+ * @return False if the payload doesn't fit its kind.
+ */
+bool UpdateHandler::parseBegin(const uint8_t kind, const uint8_t* payload, const uint32_t length, block_t* begin) {
+    *begin = {};
+    begin->kind = kind;
+    begin->buffer = -1;
+    if (kind == OTA_FRAME_BEGIN && length != 4 && length != 4 + OTA_HASH_SIZE) return false;
+    if (kind == OTA_FRAME_PATCH && length != OTA_PATCH_BEGIN_SIZE) return false;
+    begin->length = readLittleEndian(payload);
+    begin->hashed = length > 4;
+    if (begin->hashed) memcpy(begin->hash, payload + 4, OTA_HASH_SIZE);
+    if (kind == OTA_FRAME_PATCH) {
+        begin->patch_length = readLittleEndian(payload + 4 + OTA_HASH_SIZE);
+        memcpy(begin->patch_base, payload + 8 + OTA_HASH_SIZE, OTA_HASH_SIZE);
     }
-    updateData_t incoming_buffer;
-    uint32_t position = 0;
-    // Re-add null characters as they were removed by the network interface
-    for (size_t i = 0; i < length && position < sizeof(incoming_buffer.data); i++) {
-        if (data[i] == NULL_TERM_ESCAPE) {
-            if (data[i + 1] == NULL_TERM_REPLACE) {
-                incoming_buffer.data[position++] = '\0'; // Replace with null character
-                i++; // Skip the next byte
-            } else if (data[i + 1] == NULL_TERM_ESCAPE_REPLACE) {
-                incoming_buffer.data[position++] = NULL_TERM_ESCAPE; // Replace with escape character
-                i++; // Skip the next byte
-            } else if (data[i + 1] == '\0') {
-                // Check if this is supposed to be the end of the data
-                DEBUG_PRINT("Received null character in data at position %zu, stopping processing", i);
-            } else {
-                DEBUG_PRINT("Invalid escape sequence in data at position %zu", i);
+    return true;
+}
+
+/**
+ * Starts a transfer on the receiving side, the update task opens the partition or resumes the open one when it gets
+ * the begin block and answers with the offset the data continues from.
+ */
+bool UpdateHandler::beginTransfer(block_t& begin) {
+    if (filled == nullptr || empty == nullptr || resumed == nullptr) return false;
+    if (buffers[0] == nullptr) {
+        for (int8_t i = 0; i < OTA_BUFFER_COUNT; i++) {
+            buffers[i] = static_cast<uint8_t*>(malloc(OTA_BUFFER_SIZE));
+            if (buffers[i] == nullptr) {
+                LOG_ERROR("Not enough memory for the OTA buffers [%d bytes]", OTA_BUFFER_SIZE * OTA_BUFFER_COUNT);
+                for (auto& buffer : buffers) {
+                    free(buffer);
+                    buffer = nullptr;
+                }
+                return false;
             }
-        } else {
-            incoming_buffer.data[position++] = data[i];
         }
+        for (int8_t i = 0; i < OTA_BUFFER_COUNT; i++) xQueueSend(empty, &i, 0);
+    }
+    if (expected != 0) LOG_WARN("OTA begin after %u of %u bytes", received, expected);
+    if (receiving >= 0 && receive_fill > 0) { // Arrived before the connection dropped, a resume continues after it
+        submitBuffer();
+    } else if (receiving >= 0) {
+        xQueueSend(empty, &receiving, portMAX_DELAY);
+        receiving = -1;
     }
+    xQueueSend(filled, &begin, portMAX_DELAY);
+    uint32_t offset = 0;
+    // After the update task wrote every block before the begin and erased the partition, which takes seconds
+    while (xQueueReceive(resumed, &offset, pdMS_TO_TICKS(OTA_BEGIN_WAIT_SLICE)) != pdTRUE) esp_task_wdt_reset();
+    receive_fill = 0;
+    receive_stalled = 0;
+    if (offset == OTA_REFUSED) { // The update task said why, CENTRAL doesn't send the data
+        received = 0;
+        expected = 0;
+        return false;
+    }
+    received = offset;
+    expected = begin.transferSize();
+    return true;
+}
 
-    incoming_buffer.length = position;
+/**
+ * @return The buffer being filled, waits for the update task to free one if there is none.
+ */
+uint8_t* UpdateHandler::acquireBuffer() {
+    if (receiving < 0) {
+        const auto start = micros();
+        xQueueReceive(empty, &receiving, portMAX_DELAY);
+        receive_stalled += micros() - start;
+    }
+    return buffers[receiving];
+}
 
-    // Send the data to the queue
-    xQueueSend(incomingDataQueue, &incoming_buffer, portMAX_DELAY);
+void UpdateHandler::submitBuffer() {
+    block_t block{};
+    block.kind = OTA_FRAME_DATA;
+    block.buffer = receiving;
+    block.length = receive_fill;
+    xQueueSend(filled, &block, portMAX_DELAY);
+    receiving = -1;
+    receive_fill = 0;
+}
+
+/**
+ * Accounts for data written into the buffer being filled.
+ */
+void UpdateHandler::commit(const size_t length) {
+    receive_fill += length;
+    received += length;
+    if (receive_fill == OTA_BUFFER_SIZE || received == expected) submitBuffer();
+    if (received == expected) {
+        LOG_INFO("OTA transfer received [%u bytes], waited %lu ms for flash", expected,
+            static_cast<unsigned long>(receive_stalled / 1000));
+        expected = 0;
+    }
 }
 
-void UpdateHandler::startUpdate() {
+void UpdateHandler::passData(const uint8_t* data, const size_t length) {
+    if (filled == nullptr) {
+        return; // Queue not initialized
+    }
+    size_t consumed = 0;
+    if (expected == 0) {
+        uint8_t start[4 + OTA_HASH_SIZE];
+        const auto produced = unescape(data, length, &consumed, start, sizeof(start));
+        block_t begin;
+        if (!parseBegin(OTA_FRAME_BEGIN, start, produced, &begin) || consumed != length) {
+            LOG_ERROR("Invalid OTA start message, expecting the image size and its SHA-256 got %zu bytes", length);
+            return;
+        }
+        beginTransfer(begin);
+        return;
+    }
+    while (consumed < length && expected != 0) {
+        auto* buffer = acquireBuffer();
+        const auto room = std::min<size_t>(OTA_BUFFER_SIZE - receive_fill, expected - received);
+        size_t used;
+        const auto produced = unescape(data + consumed, length - consumed, &used, buffer + receive_fill, room);
+        consumed += used;
+        commit(produced);
+    }
+    if (consumed < length) LOG_WARN("Dropped %zu bytes past the end of the OTA image", length - consumed);
+}
+
+bool UpdateHandler::receiveFrame(WiFiClient* client) {
+    uint8_t header[OTA_FRAME_HEADER];
+    if (client->readBytes(header, sizeof(header)) != sizeof(header)) return false;
+    const auto kind = header[0];
+    auto length = readLittleEndian(header + 1);
+    if ((kind == OTA_FRAME_BEGIN || kind == OTA_FRAME_PATCH) && length <= OTA_PATCH_BEGIN_SIZE) {
+        uint8_t start[OTA_PATCH_BEGIN_SIZE];
+        if (client->readBytes(start, length) != length) return false;
+        block_t begin;
+        if (parseBegin(kind, start, length, &begin)) {
+            beginTransfer(begin);
+        } else {
+            LOG_WARN("Dropped malformed OTA begin frame %u [%u bytes]", kind, length);
+        }
+        return true;
+    }
+    if (kind != OTA_FRAME_DATA || expected == 0) {
+        LOG_WARN("Dropped OTA frame %u [%u bytes]%s", kind, length, expected == 0 ? ", no transfer running" : "");
+        return skip(client, length);
+    }
+    while (length > 0 && expected != 0) {
+        auto* buffer = acquireBuffer();
+        const auto room = std::min<uint32_t>(OTA_BUFFER_SIZE - receive_fill, expected - received);
+        const auto want = std::min<uint32_t>(room, length);
+        const auto read = client->readBytes(buffer + receive_fill, want);
+        length -= read;
+        commit(read);
+        if (read < want) {
+            LOG_ERROR("OTA frame cut off, %u bytes missing", length);
+            return false;
+        }
+    }
+    if (length > 0) LOG_WARN("Dropped %u bytes past the end of the OTA image", length);
+    return skip(client, length);
+}
+
+/**
+ * Opens the next app partition for the image, esp_ota_begin erases it.
+ * @return Null once the update is open, otherwise why it failed, for the nack to CENTRAL.
+ */
+const char* UpdateHandler::startUpdate() {
 #ifndef CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE
 #pragma message("Warning: Bootloader rollback is not enabled, OTA will not be enabled")
 #endif
-    DEBUG_PRINT("Starting OTA update with size: %u bytes", otaSize);
+    LOG_INFO("Starting OTA update with size: %u bytes", otaSize);
+    image_size = transfer_size;
+    transfer_done = 0;
+    committed = 0;
+    state = OTA_FAILED; // Until the partition is open
     esp_ota_handle_t otaHandle = 0;
     otaPartition = esp_ota_get_next_update_partition(nullptr);
-    const auto result = esp_ota_begin(otaPartition, otaSize, &otaHandle);
     if (otaPartition == nullptr) {
-        DEBUG_PRINT("No OTA partition found, cannot start update");
-        return; // Exit the function if no partition is available
+        LOG_ERROR("No OTA partition found, cannot start update");
+        return "no OTA partition";
     }
+    const auto result = esp_ota_begin(otaPartition, otaSize, &otaHandle);
     if (result != ESP_OK) {
-        DEBUG_PRINT("Failed to begin OTA update: %s", esp_err_to_name(result));
-        return; // Exit the function on error
+        LOG_ERROR("Failed to begin OTA update: %s", esp_err_to_name(result));
+        return esp_err_to_name(result);
     }
-    DEBUG_PRINT("OTA update started successfully on partition: %s", otaPartition->label);
+    LOG_INFO("OTA update started successfully on partition: %s", otaPartition->label);
     this->otaRemaining = otaSize;
     this->otaHandle = otaHandle;
+    this->logged_progress = 0;
+    mbedtls_sha256_free(&sha256);
+    mbedtls_sha256_init(&sha256);
+    mbedtls_sha256_starts_ret(&sha256, 0);
+    state = OTA_RECEIVING;
+    return nullptr;
 }
 
-void UpdateHandler::handleUpdate() {
-    // Wait for data to be available in the queue
-    updateData_t data{};
-    if (xQueueReceive(incomingDataQueue, &data, portMAX_DELAY) == pdTRUE) {
-        if (otaHandle == 0) {
-            if (data.length != 4) {
-                DEBUG_PRINT("0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X",
-                            data.data[0], data.data[1], data.data[2], data.data[3], data.data[4], data.data[5]);
-                DEBUG_PRINT("Invalid OTA start message, expecting total firmware length got %zu bytes", data.length);
-                vTaskDelay(500);
-                esp_restart();
-            }
-            otaSize = *(reinterpret_cast<const uint32_t*>(data.data));
-            startUpdate();
-            return; // Exit the function after starting the update
+/**
+ * Readies the patch decoder, the patch copies from the running partition.
+ * @return False if there is no memory for the output buffer.
+ */
+bool UpdateHandler::startPatch(const block_t& block) {
+    if (patch_output == nullptr) patch_output = static_cast<uint8_t*>(malloc(OTA_PATCH_OUTPUT));
+    if (patch_output == nullptr) return false;
+    base = esp_ota_get_running_partition();
+    patch_op_fill = 0;
+    patch_insert = 0;
+    patch_staged = 0;
+    patch_output_fill = 0;
+    LOG_INFO("OTA update is a %u byte patch against %s [%.8s]", block.patch_length, base->label,
+        runningImage().hex);
+    return true;
+}
+
+/**
+ * Resumes the open update if the begin is for the same image, starts a new one otherwise. A patch made against
+ * another image is refused and the open update, if any, is left alone.
+ */
+void UpdateHandler::beginUpdate(const block_t& block) {
+    const auto patch = block.kind == OTA_FRAME_PATCH;
+    const auto& running = runningImage();
+    if (patch && (!running.hashed || memcmp(block.patch_base, running.hash, OTA_HASH_SIZE) != 0)) {
+        LOG_WARN("Refused OTA patch made against %02x%02x%02x%02x, running %.8s", block.patch_base[0],
+            block.patch_base[1], block.patch_base[2], block.patch_base[3], running.hashed ? running.hex : "unknown");
+        const uint32_t refused = OTA_REFUSED;
+        xQueueSend(resumed, &refused, portMAX_DELAY);
+        report("refused", "base mismatch");
+        return;
+    }
+    uint32_t offset = 0;
+    if (otaHandle != 0 && hashed && block.hashed && block.length == otaSize && patch == patching &&
+        block.transferSize() == transfer_size && memcmp(block.hash, image_hash, OTA_HASH_SIZE) == 0) {
+        offset = transfer_done;
+        LOG_INFO("Resuming OTA update at %u of %u bytes", offset, transfer_size);
+    } else {
+        if (otaHandle != 0) abortUpdate("another image was started");
+        otaSize = block.length;
+        transfer_size = block.transferSize();
+        hashed = block.hashed;
+        memcpy(image_hash, block.hash, OTA_HASH_SIZE);
+        patching = patch;
+        const auto error = startUpdate();
+        if (error != nullptr) {
+            report("failed", error);
+        } else if (patching && !startPatch(block)) {
+            abortUpdate("no memory for the patch output");
         }
-        // Write the data to the OTA handle
-        const auto writeResult = esp_ota_write(otaHandle, data.data, data.length);
+    }
+    session_started = millis();
+    session_offset = offset;
+    write_time = 0;
+    if (otaHandle == 0) offset = OTA_REFUSED; // Already reported
+    xQueueSend(resumed, &offset, portMAX_DELAY);
+    if (otaHandle != 0) report("receiving");
+}
+
+void UpdateHandler::handleUpdate() {
+    // Wait for a block from the uplink task
+    block_t block{};
+    if (xQueueReceive(filled, &block, portMAX_DELAY) != pdTRUE) return;
+    if (block.kind != OTA_FRAME_DATA) {
+        beginUpdate(block);
+        return;
+    }
+    esp_err_t writeResult = ESP_ERR_INVALID_STATE;
+    if (otaHandle != 0) {
+        writeResult = patching ? applyPatch(buffers[block.buffer], block.length)
+                               : writeImage(buffers[block.buffer], block.length);
+    }
+    xQueueSend(empty, &block.buffer, portMAX_DELAY); // The uplink task can fill it again
+    if (otaHandle == 0) {
+        LOG_DEBUG("No OTA update running, dropped %u bytes", block.length);
+        return;
+    }
+    if (writeResult != ESP_OK) {
+        LOG_ERROR("Failed to write OTA data: %s", esp_err_to_name(writeResult));
+        abortUpdate(esp_err_to_name(writeResult));
+        return; // Exit the function on error
+    }
+    transfer_done += block.length;
+    committed = transfer_done;
+    const auto done = static_cast<uint8_t>(static_cast<uint64_t>(transfer_done) * 100 / transfer_size);
+    if (done >= logged_progress + OTA_PROGRESS_STEP) {
+        logged_progress = done - done % OTA_PROGRESS_STEP;
+        LOG_INFO("OTA %u%% [%u of %u bytes]", logged_progress, transfer_done, transfer_size);
+    }
+    if (transfer_done < transfer_size) return;
+    if (patching) {
+        writeResult = flushPatchOutput();
         if (writeResult != ESP_OK) {
-            DEBUG_PRINT("Failed to write OTA data: %s", esp_err_to_name(writeResult));
-            finishUpdate();
-            return; // Exit the function on error
+            abortUpdate(esp_err_to_name(writeResult));
+            return;
         }
-        otaRemaining -= data.length;
-        // Check if the OTA update is complete
-        if (otaRemaining == 0) {
-            DEBUG_PRINT("OTA update complete, finishing update");
-            finishUpdate();
-            otaHandle = 0; // Reset the handle after finishing
+        if (otaRemaining != 0) {
+            LOG_ERROR("OTA patch ended %u bytes short of the %u byte image", otaRemaining, otaSize);
+            abortUpdate("patch ended early");
+            return;
         }
+        LOG_INFO("OTA patch rebuilt the %u byte image from %u bytes", otaSize, transfer_size);
     }
+    const auto elapsed = millis() - session_started;
+    const auto sent = transfer_size - session_offset;
+    LOG_INFO("OTA update complete, %u bytes in %lu ms [%.1f KB/s], flash writes took %lu ms", sent,
+        static_cast<unsigned long>(elapsed), elapsed == 0 ? 0.0 : sent / 1.024 / elapsed,
+        static_cast<unsigned long>(write_time / 1000));
+    if (!verifyImage()) {
+        abortUpdate("SHA-256 mismatch");
+        return;
+    }
+    finishUpdate();
+    otaHandle = 0; // Reset the handle after finishing
+}
+
+/**
+ * Hashes and writes the next bytes of the image.
+ */
+esp_err_t UpdateHandler::writeImage(const uint8_t* data, const size_t length) {
+    if (hashed) {
+        PROFILE_ZONE("mbedtls_sha256_update");
+        mbedtls_sha256_update_ret(&sha256, data, length);
+    }
+    const auto start = micros();
+    esp_err_t result;
+    {
+        PROFILE_ZONE("esp_ota_write");
+        POWER_LOCK(POWER_LOCK_OTA);
+        result = esp_ota_write(otaHandle, data, length);
+    }
+    write_time += micros() - start;
+    if (result == ESP_OK) otaRemaining -= length;
+    return result;
+}
+
+/**
+ * Runs the next bytes of a patch, an operation or an insert may continue in the next block.
+ */
+esp_err_t UpdateHandler::applyPatch(const uint8_t* data, const size_t length) {
+    PROFILE_ZONE("UpdateHandler::applyPatch");
+    size_t used = 0;
+    while (used < length) {
+        if (patch_insert > 0) {
+            const auto inserted = std::min<size_t>(patch_insert, length - used);
+            const auto result = stagePatchOutput(data + used, inserted);
+            if (result != ESP_OK) return result;
+            used += inserted;
+            patch_insert -= inserted;
+            continue;
+        }
+        patch_op[patch_op_fill++] = data[used++];
+        const uint8_t needed = patch_op[0] == OTA_PATCH_COPY ? 9 : patch_op[0] == OTA_PATCH_INSERT ? 5 : 0;
+        if (needed == 0) {
+            LOG_ERROR("Invalid OTA patch operation %u", patch_op[0]);
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (patch_op_fill < needed) continue;
+        patch_op_fill = 0;
+        if (patch_op[0] == OTA_PATCH_INSERT) {
+            patch_insert = readLittleEndian(patch_op + 1);
+            continue;
+        }
+        const auto result = copyFromBase(readLittleEndian(patch_op + 1), readLittleEndian(patch_op + 5));
+        if (result != ESP_OK) return result;
+    }
+    return ESP_OK;
+}
+
+esp_err_t UpdateHandler::stagePatchOutput(const uint8_t* data, size_t length) {
+    if (patch_staged + length > otaSize) {
+        LOG_ERROR("OTA patch overruns the %u byte image", otaSize);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    patch_staged += length;
+    while (length > 0) {
+        const auto staged = std::min<size_t>(length, OTA_PATCH_OUTPUT - patch_output_fill);
+        memcpy(patch_output + patch_output_fill, data, staged);
+        patch_output_fill += staged;
+        data += staged;
+        length -= staged;
+        if (patch_output_fill == OTA_PATCH_OUTPUT) {
+            const auto result = flushPatchOutput();
+            if (result != ESP_OK) return result;
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * Stages bytes of the running partition, read straight into the output buffer.
+ */
+esp_err_t UpdateHandler::copyFromBase(uint32_t offset, uint32_t length) {
+    if (static_cast<uint64_t>(offset) + length > base->size) {
+        LOG_ERROR("OTA patch copies past the end of %s", base->label);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (patch_staged + length > otaSize) {
+        LOG_ERROR("OTA patch overruns the %u byte image", otaSize);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    patch_staged += length;
+    while (length > 0) {
+        const auto copied = std::min<uint32_t>(length, OTA_PATCH_OUTPUT - patch_output_fill);
+        esp_err_t result;
+        {
+            PROFILE_ZONE("esp_partition_read");
+            result = esp_partition_read(base, offset, patch_output + patch_output_fill, copied);
+        }
+        if (result != ESP_OK) return result;
+        patch_output_fill += copied;
+        offset += copied;
+        length -= copied;
+        if (patch_output_fill == OTA_PATCH_OUTPUT) {
+            result = flushPatchOutput();
+            if (result != ESP_OK) return result;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t UpdateHandler::flushPatchOutput() {
+    if (patch_output_fill == 0) return ESP_OK;
+    const auto result = writeImage(patch_output, patch_output_fill);
+    patch_output_fill = 0;
+    return result;
+}
+
+/**
+ * @return False if the image written doesn't hash to the SHA-256 that came with the begin.
+ */
+bool UpdateHandler::verifyImage() {
+    if (!hashed) {
+        LOG_WARN("No SHA-256 came with the OTA image, only esp_ota_end validates it");
+        return true;
+    }
+    uint8_t digest[OTA_HASH_SIZE];
+    mbedtls_sha256_finish_ret(&sha256, digest);
+    if (memcmp(digest, image_hash, OTA_HASH_SIZE) != 0) {
+        LOG_ERROR("OTA image SHA-256 mismatch, got %02x%02x%02x%02x... expected %02x%02x%02x%02x...", digest[0],
+            digest[1], digest[2], digest[3], image_hash[0], image_hash[1], image_hash[2], image_hash[3]);
+        return false;
+    }
+    LOG_INFO("OTA image SHA-256 verified");
+    return true;
+}
+
+void UpdateHandler::abortUpdate(const char* reason) {
+    LOG_WARN("Aborting OTA update (%s), %u of %u bytes written", reason, otaSize - otaRemaining, otaSize);
+    esp_ota_abort(otaHandle);
+    otaHandle = 0;
+    state = OTA_FAILED;
+    report("failed", reason);
+}
+
+/**
+ * Tells CENTRAL where the transfer stands, the offset is where a resumed transfer continues.
+ */
+void UpdateHandler::report(const char* status, const char* error) const {
+    if (network_interface == nullptr) return;
+    char buffer[192];
+    const auto length = snprintf(buffer, sizeof(buffer),
+        R"({"msg_type":"ota","status":"%s","offset":%lu,"size":%lu%s%s%s})", status,
+        static_cast<unsigned long>(committed.load()), static_cast<unsigned long>(image_size.load()),
+        error == nullptr ? "" : R"(,"error":")", error == nullptr ? "" : error, error == nullptr ? "" : "\"");
+    network_interface->queue_message(buffer, length);
 }
 
 void UpdateHandler::finishUpdate() {
     if (otaHandle == 0) {
-        DEBUG_PRINT("No OTA handle to finish");
+        LOG_ERROR("No OTA handle to finish");
         return; // No update in progress
     }
     const auto result = esp_ota_end(otaHandle);
     if (result != ESP_OK) {
-        DEBUG_PRINT("Failed to end OTA update: %s", esp_err_to_name(result));
+        LOG_ERROR("Failed to end OTA update: %s", esp_err_to_name(result));
         otaHandle = 0; // Reset the handle on error
+        state = OTA_FAILED;
+        report("failed", esp_err_to_name(result));
         return;
     }
-    DEBUG_PRINT("OTA update finished successfully, switching boot partitions");
+    LOG_INFO("OTA update finished successfully, switching boot partitions");
     const auto switchResult = esp_ota_set_boot_partition(otaPartition);
     // Mark the next partition as ESP_OTA_IMG_NEW
     if (switchResult != ESP_OK) {
-        DEBUG_PRINT("Failed to set boot partition: %s", esp_err_to_name(switchResult));
+        LOG_ERROR("Failed to set boot partition: %s", esp_err_to_name(switchResult));
+        state = OTA_FAILED;
+        report("failed", esp_err_to_name(switchResult));
         return; // Exit the function on error
     }
     // Mark the otaPartition as ESP_OTA_IMG_PENDING_VERIF
     esp_ota_img_states_t otaState;
     esp_ota_get_state_partition(otaPartition, &otaState);
     if (otaState != ESP_OTA_IMG_NEW) {
-        DEBUG_PRINT("Warning: OTA partition was not marked as ESP_OTA_IMG_NEW by esp_ota_set_boot_partition, current state: %d", otaState);
+        LOG_WARN("OTA partition was not marked as ESP_OTA_IMG_NEW by esp_ota_set_boot_partition, current state: %d", otaState);
     }
 
+    logFlush();
     esp_restart();
 
-}
\ No newline at end of file
+}
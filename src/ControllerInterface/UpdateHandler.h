@@ -8,50 +8,224 @@
 #include <cstring>
 #include <esp32-hal.h>
 #include <esp_ota_ops.h>
+#include <esp_partition.h>
 #include <HardwareSerial.h>
+#include <WiFi.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
+#include <mbedtls/sha256.h>
 
 #include "debug.h"
+#include "Profile/Profile.h"
+#include "Power/Power.h"
+
+#include <atomic>
 
 #define NULL_TERM_ESCAPE  0x08  // Escape character for null termination in uplink messages
 #define NULL_TERM_REPLACE 0x01  // Replacement character for null termination in uplink messages
 #define NULL_TERM_ESCAPE_REPLACE 0x02  // Replacement character for escaped null termination in uplink messages
 
-
+// Binary OTA frames: OTA_FRAME, kind (1 byte), payload length (4 bytes, little endian), payload. Nothing is escaped,
+// the payload is read from the socket straight into the flash buffers.
+#define OTA_FRAME            0x0E
+#define OTA_FRAME_BEGIN      1      // Payload: the image size (4 bytes, little endian), optionally its SHA-256
+#define OTA_FRAME_DATA       2      // Payload: the next bytes of the image, any length
+#define OTA_FRAME_PATCH      3      // Payload: image size (4), SHA-256, patch length (4), base image SHA-256
+#define OTA_FRAME_HEADER     5      // (bytes) After OTA_FRAME
+#define OTA_HASH_SIZE        32     // (bytes) SHA-256 of the image, after the size in a begin frame
+#define OTA_PATCH_BEGIN_SIZE (8 + 2 * OTA_HASH_SIZE) // (bytes) Payload of OTA_FRAME_PATCH
+
+// Patch operations, each an opcode and its arguments (little endian), the image is their output in order
+#define OTA_PATCH_COPY       1      // Base offset (4), length (4): bytes from the running partition
+#define OTA_PATCH_INSERT     2      // Length (4), then that many bytes of the patch
+#define OTA_PATCH_OUTPUT     4096   // (bytes) A patch's output is written to flash this much at a time
+#define OTA_REFUSED          0xFFFFFFFF // Offset answering a begin that was refused, its data is dropped
+
+#define OTA_BUFFER_SIZE      16384  // (bytes) Flash is written this much at a time
+#define OTA_BUFFER_COUNT     2      // One fills from the network while the other is written to flash
+#define OTA_PROGRESS_STEP    10     // (%) Progress is logged this often
+#define OTA_BEGIN_WAIT_SLICE 1000   // (ms) The uplink task feeds its watchdog this often while the partition is erased
+
+class NetworkInterface;
+
+typedef enum : uint8_t {
+    OTA_IDLE,       // No transfer since boot
+    OTA_RECEIVING,  // Written to flash up to the committed offset
+    OTA_FAILED,     // Aborted, CENTRAL has to start over
+} ota_state_t;
+
+inline const char* otaStateName(const ota_state_t state) {
+    switch (state) {
+        case OTA_IDLE: return "idle";
+        case OTA_RECEIVING: return "receiving";
+        case OTA_FAILED: return "failed";
+    }
+    return "unknown";
+}
+
+/**
+ * Receives an OTA image and writes it to the next app partition, then restarts into it.
+ *
+ * The image comes in binary frames (see OTA_FRAME) or, from an older CENTRAL, as escaped '\t' messages: a first one
+ * with the image size, then the data. Either way the uplink task fills one of OTA_BUFFER_COUNT buffers while the
+ * update task writes the other to flash, the uplink task only waits when both are full, which holds the TCP window
+ * shut until flash catches up. Throughput is logged when the image is complete.
+ *
+ * A transfer survives a dropped connection: the update handle stays open, and a begin frame for the same image (size
+ * and SHA-256) resumes it. The satellite answers every begin with an "ota" message carrying the offset written to
+ * flash so far, CENTRAL sends the image from there. The SHA-256 is computed as the image is written and checked before
+ * the new partition is made the boot partition. A begin without a hash (older CENTRAL) always starts over and skips
+ * the check. Nothing survives a restart, esp_ota_begin erases the partition.
+ *
+ * A delta update (OTA_FRAME_PATCH, made by OtaDelta.py) sends a patch instead of the image: copies from the running
+ * partition and inserted bytes, rebuilt into the next partition as it streams in. It is only taken if it was made
+ * against the running image, named by its SHA-256 (device_info "image_sha256"), otherwise it is refused with
+ * "base mismatch" and CENTRAL sends the full image. The git hash is not enough, two builds of one commit differ.
+ * Offsets are in transfer bytes, the patch for a delta, so a delta resumes like an image does.
+ */
 class UpdateHandler {
 
+    friend struct BenchAccess; // The benchmarks (bench/) drain the buffers without the update task
+
+    // Receiving, only the uplink task touches these
+    int8_t receiving = -1;          // Buffer being filled, -1 for none
+    uint32_t receive_fill = 0;      // (bytes) In the buffer being filled
+    uint32_t received = 0;          // (bytes) Of the transfer
+    uint32_t expected = 0;          // (bytes) Transfer size (image or patch), 0 while no transfer is running
+    uint32_t receive_stalled = 0;   // (us) Spent waiting for flash to free a buffer
+
+    // Writing, only the update task touches these
     esp_ota_handle_t otaHandle = 0;
     uint32_t otaSize = OTA_SIZE_UNKNOWN;
     uint32_t otaRemaining = 0;
+    uint32_t transfer_size = 0;     // (bytes) The image, or the patch for a delta
+    uint32_t transfer_done = 0;     // (bytes) Of the transfer applied
+    uint32_t write_time = 0;        // (us) Spent in esp_ota_write
+    uint32_t session_started = 0;   // (ms) millis() of the last begin, new or resumed
+    uint32_t session_offset = 0;    // (bytes) Of the transfer applied at the last begin
+    uint8_t logged_progress = 0;    // (%) Last logged
+    bool hashed = false;            // A SHA-256 came with the begin, image_hash holds it
+    uint8_t image_hash[OTA_HASH_SIZE] = {};
+    mbedtls_sha256_context sha256 = {};
+
+    // Applying a patch, only the update task touches these
+    bool patching = false;          // The transfer is a patch against base
+    const esp_partition_t* base = nullptr;
+    uint8_t patch_op[9] = {};       // The operation being read, it can span blocks
+    uint8_t patch_op_fill = 0;
+    uint32_t patch_insert = 0;      // (bytes) Left of the insert being applied
+    uint32_t patch_staged = 0;      // (bytes) Of the image the patch has produced
+    uint8_t* patch_output = nullptr; // OTA_PATCH_OUTPUT bytes, staged for the next flash write
+    uint32_t patch_output_fill = 0;
+
+    // Reported in the state updates, written by the update task
+    std::atomic<uint8_t> state{OTA_IDLE};
+    std::atomic<uint32_t> committed{0}; // (bytes) Of the transfer written to flash
+    std::atomic<uint32_t> image_size{0}; // (bytes) Of the transfer
+
+    NetworkInterface* network_interface = nullptr;
 
     const esp_partition_t *otaPartition = nullptr;
 
-    struct updateData_t {
-        size_t length;
-        uint8_t data[1024];
+    struct block_t {
+        uint8_t kind;    // OTA_FRAME_BEGIN, OTA_FRAME_PATCH or OTA_FRAME_DATA
+        int8_t buffer;   // Index into buffers, DATA only
+        uint32_t length; // (bytes) Image size for BEGIN and PATCH, data in the buffer for DATA
+        bool hashed;     // BEGIN and PATCH, hash holds the image's SHA-256
+        uint8_t hash[OTA_HASH_SIZE];
+        uint32_t patch_length;              // (bytes) PATCH only
+        uint8_t patch_base[OTA_HASH_SIZE];  // PATCH only, SHA-256 of the image the patch was made against
+
+        /**
+         * @return (bytes) What CENTRAL sends after the begin.
+         */
+        uint32_t transferSize() const {
+            return kind == OTA_FRAME_PATCH ? patch_length : length;
+        }
     };
 
-    QueueHandle_t incomingDataQueue = xQueueCreate(5, sizeof(updateData_t));
+    uint8_t* buffers[OTA_BUFFER_COUNT] = {};
+    QueueHandle_t filled = xQueueCreate(OTA_BUFFER_COUNT + 1, sizeof(block_t)); // To the update task
+    QueueHandle_t empty = xQueueCreate(OTA_BUFFER_COUNT, sizeof(int8_t));       // Back to the uplink task
+    QueueHandle_t resumed = xQueueCreate(1, sizeof(uint32_t)); // The offset a begin continues from, to the uplink task
 
-    static void updateTask(void* pvParameters);
+    [[noreturn]] static void updateTask(void* pvParameters);
 
     void handleUpdate();
 
-    void startUpdate();
+    void beginUpdate(const block_t& block);
+
+    const char* startUpdate();
 
     void finishUpdate();
 
+    void abortUpdate(const char* reason);
+
+    bool verifyImage();
+
+    bool startPatch(const block_t& block);
+
+    esp_err_t applyPatch(const uint8_t* data, size_t length);
+
+    esp_err_t stagePatchOutput(const uint8_t* data, size_t length);
+
+    esp_err_t copyFromBase(uint32_t offset, uint32_t length);
+
+    esp_err_t flushPatchOutput();
+
+    esp_err_t writeImage(const uint8_t* data, size_t length);
+
+    void report(const char* status, const char* error = nullptr) const;
+
+    static bool parseBegin(uint8_t kind, const uint8_t* payload, uint32_t length, block_t* begin);
+
+    bool beginTransfer(block_t& begin);
+
+    uint8_t* acquireBuffer();
+
+    void submitBuffer();
+
+    void commit(size_t length);
+
 public:
 
     UpdateHandler() = default;
 
-    void begin() {
+    /**
+     * @param network_interface Carries the "ota" messages to CENTRAL.
+     */
+    void begin(NetworkInterface* network_interface) {
+        this->network_interface = network_interface;
         // Create the task to handle OTA updates
         xTaskCreatePinnedToCore(updateTask, "UpdateHandler", 8192, this, 1, nullptr, 1);
     }
 
-    void passData(const uint8_t* data, const size_t length) const;
+    /**
+     * An escaped '\t' message, the first of a transfer carries the image size.
+     */
+    void passData(const uint8_t* data, size_t length);
+
+    /**
+     * Reads one binary frame, the OTA_FRAME byte has already been read.
+     * @return False if the stream broke off mid frame, the framing is lost and the connection must be dropped.
+     */
+    bool receiveFrame(WiFiClient* client);
+
+    struct Progress {
+        ota_state_t state;
+        uint32_t committed; // (bytes) Of the transfer written to flash, where a resumed transfer continues
+        uint32_t size;      // (bytes) Of the transfer, the patch for a delta
+    };
+
+    Progress progress() const {
+        return {static_cast<ota_state_t>(state.load()), committed.load(), image_size.load()};
+    }
+
+    /**
+     * The base a delta patch must be made against. Hashing reads the whole partition, it is done on the first call.
+     * @return Hex SHA-256 of the running image, empty if it could not be hashed.
+     */
+    static const char* runningImageHash();
 
 };
 
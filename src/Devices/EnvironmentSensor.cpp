@@ -2,13 +2,22 @@
 // Created by Jay on 10/16/2024.
 //
 
+#define LOG_MODULE LOG_MODULE_DEVICES
+
 #include "EnvironmentSensor.h"
+#include "Power/Power.h"
 
 
-EnvironmentSensor::EnvironmentSensor() {
+EnvironmentSensor::EnvironmentSensor(RoomInterface* room_interface) : RoomDevice(room_interface) {
     Wire.begin();
     aht20.begin();
     deviceData["actions"] = JsonArray();
+    SavedState saved{};
+    if (restoreState(&saved)) { // Reported until the first read, 15 seconds at most
+        temperature = saved.temperature;
+        humidity = saved.humidity;
+        has_data = saved.has_data;
+    }
 }
 
 void EnvironmentSensor::startTask(TaskHandle_t* taskHandle) {
@@ -24,16 +33,25 @@ float_t EnvironmentSensor::celsiusToFahrenheit(const float_t celsius) {
     auto* self = static_cast<EnvironmentSensor *>(pvParameters);
     TickType_t xLastWakeTime = xTaskGetTickCount();
     for (;;) {
-        if (self->aht20.isConnected() && self->aht20.available()) {
-            const bool first_read = self->temperature == 0 && self->humidity == 0;
-            self->temperature = celsiusToFahrenheit(self->aht20.getTemperature());
-            self->humidity = self->aht20.getHumidity();
+        bool read = false;
+        bool first_read = false;
+        {
+            POWER_LOCK(POWER_LOCK_I2C);
+            if (self->aht20.isConnected() && self->aht20.available()) {
+                first_read = self->temperature == 0 && self->humidity == 0;
+                self->temperature = celsiusToFahrenheit(self->aht20.getTemperature());
+                self->humidity = self->aht20.getHumidity();
+                read = true;
+            }
+        }
+        if (read) {
             self->has_data = true;
+            self->saveState(SavedState{self->temperature, self->humidity, self->has_data});
             if (first_read) self->uplinkNow();
             // Send the event to the RoomInterface
-            const auto event = EnvironmentSensor::getScratchSpace();
+            const auto event = self->getScratchSpace();
             if (event == nullptr) {
-                Serial.println("Failed to get scratch space for event");
+                LOG_ERROR("Failed to get scratch space for event");
                 continue;
             }
             event->objectName = writeStringToScratchSpace(self->getObjectName(), event);
@@ -43,7 +61,7 @@ float_t EnvironmentSensor::celsiusToFahrenheit(const float_t celsius) {
             event->args[0].value.floatVal = self->temperature;
             event->args[1].type = ParsedArg::FLOAT;
             event->args[1].value.floatVal = self->humidity;
-            EnvironmentSensor::sendEvent(event);
+            self->sendEvent(event);
         }
         xTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(15000));
     }
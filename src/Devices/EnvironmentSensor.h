@@ -12,10 +12,20 @@
 
 class EnvironmentSensor final : public RoomDevice {
 
+    struct SavedState {
+        static constexpr uint8_t VERSION = 1;
+        float_t temperature;
+        float_t humidity;
+        boolean has_data;
+    };
+
 public:
 
-    const char* object_type = "EnvironmentSensor";
-    const char* object_name = "LivingRoomSensor";
+    static constexpr const char* OBJECT_TYPE = "EnvironmentSensor";
+    static constexpr const char* OBJECT_NAME = "LivingRoomSensor";
+
+    const char* object_type = OBJECT_TYPE;
+    const char* object_name = OBJECT_NAME;
 
     float_t temperature = 0;
     float_t humidity = 0;
@@ -23,7 +33,7 @@ public:
 
     AHT20 aht20;
 
-    EnvironmentSensor();
+    explicit EnvironmentSensor(RoomInterface* room_interface);
 
     void startTask(TaskHandle_t* taskHandle) override;
 
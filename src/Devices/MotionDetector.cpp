@@ -2,22 +2,25 @@
 // Created by Jay on 10/15/2024.
 //
 
-#include "MotionDetector.h"
+#define LOG_MODULE LOG_MODULE_DEVICES
 
-SemaphoreHandle_t motionEventMutex;
-__NOINIT_ATTR time_t lastMotionTimePreserver;
+#include "MotionDetector.h"
+#include "Power/Power.h"
 
-MotionDetector::MotionDetector() {
-    DEBUG_PRINT("Initializing Motion Detector");
+MotionDetector::MotionDetector(RoomInterface* room_interface) : RoomDevice(room_interface) {
+    LOG_INFO("Initializing Motion Detector");
     pinMode(MOTION_DETECTOR_PIN, INPUT_PULLUP);
-    motionEventMutex = xSemaphoreCreateBinary();
-    attachInterrupt(digitalPinToInterrupt(MOTION_DETECTOR_PIN), MotionDetector::pinISR, CHANGE);
+    motionEvent = xSemaphoreCreateBinary();
+    attachInterruptArg(digitalPinToInterrupt(MOTION_DETECTOR_PIN), MotionDetector::pinISR, this, CHANGE);
     motionDetected = digitalRead(MOTION_DETECTOR_PIN);
-    this->lastMotionTime = lastMotionTimePreserver;
+    powerWakeOnPin(MOTION_DETECTOR_PIN); // The interrupt alone doesn't wake a light sleep
+    SavedState saved{};
+    if (restoreState(&saved)) this->lastMotionTime = saved.last_motion_time;
 }
 
-void MotionDetector::pinISR() {
-    xSemaphoreGiveFromISR(motionEventMutex, nullptr);
+void MotionDetector::pinISR(void* arg) {
+    powerRearmPinFromISR(MOTION_DETECTOR_PIN);
+    xSemaphoreGiveFromISR(static_cast<MotionDetector*>(arg)->motionEvent, nullptr);
 }
 
 void MotionDetector::startTask(TaskHandle_t *taskHandle) {
@@ -27,30 +30,32 @@ void MotionDetector::startTask(TaskHandle_t *taskHandle) {
 
 [[noreturn]] void MotionDetector::RTOSLoop(void* pvParameters) {
     auto* self = static_cast<MotionDetector *>(pvParameters);
-    DEBUG_PRINT("Motion Detector Loop Started");
+    LOG_INFO("Motion Detector Loop Started");
     while (true) {
-        if (xSemaphoreTake(motionEventMutex, portMAX_DELAY) == pdTRUE) {
+        if (xSemaphoreTake(self->motionEvent, portMAX_DELAY) == pdTRUE) {
             // Read the pin state to determine which edge triggered the interrupt
             self->motionDetected = digitalRead(MOTION_DETECTOR_PIN);
-            DEBUG_PRINT("Motion Detected: %d\n", self->motionDetected);
+            LOG_DEBUG("Motion Detected: %d", self->motionDetected);
             if (self->motionDetected) {
                 // Set the last motion time to the current time from the RTC
                 time(&self->lastMotionTime);
-                time(&lastMotionTimePreserver);
+                self->lastMotionUs = clockMicros();
+                self->saveState(SavedState{self->lastMotionTime});
             }
             self->uplinkNow();
             // Send the event to the RoomInterface
-            const auto event = MotionDetector::getScratchSpace();
+            const auto event = self->getScratchSpace();
             if (event == nullptr) {
-                DEBUG_PRINT("Failed to get scratch space for event");
+                LOG_ERROR("Failed to get scratch space for event");
                 continue;
             }
             event->objectName = writeStringToScratchSpace(self->getObjectName(), event);
             event->eventName = writeStringToScratchSpace("motion_detected", event);
+            event->urgent = true; // Occupancy reacts to motion, skip the queue behind the state updates
             event->numArgs = 1;
             event->args[0].type = ParsedArg::BOOL;
             event->args[0].value.boolVal = self->motionDetected;
-            MotionDetector::sendEvent(event);
+            self->sendEvent(event);
         }
     }
 }
@@ -61,6 +66,7 @@ JsonVariant MotionDetector::getDeviceData() {
     deviceData["health"]["reason"] = "";
     deviceData["state"]["motion_detected"] = motionDetected;
     deviceData["state"]["last_motion_time"] = lastMotionTime;
+    deviceData["state"]["last_motion_us"] = lastMotionUs;
     return deviceData;
 }
 
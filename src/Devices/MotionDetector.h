@@ -11,12 +11,22 @@
 
 class MotionDetector final : public RoomDevice {
 
+    struct SavedState {
+        static constexpr uint8_t VERSION = 1;
+        time_t last_motion_time;
+    };
+
 public:
 
-    const char* object_name = "MotionDetector";
-    const char* object_type = "MotionDetector";
+    static constexpr const char* OBJECT_NAME = "MotionDetector";
+    static constexpr const char* OBJECT_TYPE = "MotionDetector";
+
+    const char* object_name = OBJECT_NAME;
+    const char* object_type = OBJECT_TYPE;
+    SemaphoreHandle_t motionEvent = nullptr; // Given by the pin interrupt
     boolean motionDetected = false;
-    time_t lastMotionTime = 0;
+    time_t lastMotionTime = 0;   // Wall clock, only valid once SNTP has synced
+    uint64_t lastMotionUs = 0;   // (us) clockMicros(), CENTRAL adds the clock offset, 0 until motion this boot
 
     char* getObjectName() override {
         return const_cast<char *>(object_name);
@@ -26,13 +36,13 @@ public:
         return const_cast<char *>(object_type);
     }
 
-    MotionDetector();
+    explicit MotionDetector(RoomInterface* room_interface);
 
-    static void IRAM_ATTR pinISR();
+    static void IRAM_ATTR pinISR(void* arg);
 
     void startTask(TaskHandle_t* taskHandle) override;
 
-    static void RTOSLoop(void* pvParameters);
+    [[noreturn]] static void RTOSLoop(void* pvParameters);
 
     JsonVariant getDeviceData() override;
 
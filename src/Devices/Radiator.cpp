@@ -2,167 +2,332 @@
 // Created by Jay on 10/14/2024.
 //
 
+#define LOG_MODULE LOG_MODULE_DEVICES
+
 #include "Radiator.h"
 
-__NOINIT_ATTR uint32_t radiator_state_preserver;
+const Radiator::Transition Radiator::transitions[] = {
+    // Commands, these take priority over everything else
+    {OFF,            CAUSE_ANY, [](const Radiator* self) { return self->on; }, OPENING},
+    {CLOSING,        CAUSE_ANY, [](const Radiator* self) { return self->on; }, OPENING},
+    {COOLDOWN,       CAUSE_ANY, [](const Radiator* self) { return self->on; }, OPENING},
+    {ON,             CAUSE_ANY, [](const Radiator* self) { return !self->on; }, CLOSING},
+    {OPENING,        CAUSE_ANY, [](const Radiator* self) { return !self->on; }, CLOSING},
+    {WARMUP,         CAUSE_ANY, [](const Radiator* self) { return !self->on; }, CLOSING},
+    {STARTUP_FAULT,  CAUSE_SET_ON | CAUSE_HEARTBEAT_TIMEOUT, [](const Radiator* self) { return self->on; }, OPENING},
+    {STARTUP_FAULT,  CAUSE_SET_ON | CAUSE_HEARTBEAT_TIMEOUT, [](const Radiator* self) { return !self->on; }, CLOSING},
+    {SHUTDOWN_FAULT, CAUSE_SET_ON | CAUSE_HEARTBEAT_TIMEOUT, [](const Radiator* self) { return self->on; }, OPENING},
+    {SHUTDOWN_FAULT, CAUSE_SET_ON | CAUSE_HEARTBEAT_TIMEOUT, [](const Radiator* self) { return !self->on; }, CLOSING},
+    // Closing the valve
+    {CLOSING,  CAUSE_ANY, [](const Radiator* self) {
+        return windowExpired(self->cooldown_start, RADIATOR_COOLDOWN_TIME); }, SHUTDOWN_FAULT},
+    {CLOSING,  CAUSE_ANY, [](const Radiator* self) { return self->radiator_temp <= RADIATOR_COOLDOWN_TEMP; }, OFF},
+    {CLOSING,  CAUSE_ANY, [](const Radiator* self) { return self->radiator_temp < self->temp_at_shutdown - 0.5; }, COOLDOWN},
+    // Cooling down
+    {COOLDOWN, CAUSE_ANY, [](const Radiator* self) {
+        return windowExpired(self->cooldown_start, RADIATOR_COOLDOWN_TIME); }, SHUTDOWN_FAULT},
+    {COOLDOWN, CAUSE_ANY, [](const Radiator* self) { return self->radiator_temp <= RADIATOR_COOLDOWN_TEMP; }, OFF},
+    {COOLDOWN, CAUSE_ANY, [](const Radiator* self) {
+        return self->trendCannotReach(RADIATOR_COOLDOWN_TEMP, false); }, SHUTDOWN_FAULT},
+    // Off and cold (and should stay cold)
+    {OFF,      CAUSE_ANY, [](const Radiator* self) {
+        return self->radiator_temp > RADIATOR_COOLDOWN_TEMP + 5 && !self->on; }, SHUTDOWN_FAULT},
+    // Opening the valve
+    {OPENING,  CAUSE_ANY, [](const Radiator* self) {
+        return windowExpired(self->warmup_start, RADIATOR_HEATUP_TIME); }, STARTUP_FAULT},
+    {OPENING,  CAUSE_ANY, [](const Radiator* self) { return self->radiator_temp >= RADIATOR_OPERATING_TEMP; }, ON},
+    {OPENING,  CAUSE_ANY, [](const Radiator* self) { return self->radiator_temp > self->temp_at_startup + 0.5; }, WARMUP},
+    // Warming up
+    {WARMUP,   CAUSE_ANY, [](const Radiator* self) {
+        return windowExpired(self->warmup_start, RADIATOR_HEATUP_TIME); }, STARTUP_FAULT},
+    {WARMUP,   CAUSE_ANY, [](const Radiator* self) { return self->radiator_temp < self->temp_at_startup - 2; }, STARTUP_FAULT},
+    {WARMUP,   CAUSE_ANY, [](const Radiator* self) { return self->radiator_temp >= RADIATOR_OPERATING_TEMP; }, ON},
+    {WARMUP,   CAUSE_ANY, [](const Radiator* self) {
+        return self->trendCannotReach(RADIATOR_OPERATING_TEMP, true); }, STARTUP_FAULT},
+    // On and at operating temperature
+    {ON,       CAUSE_ANY, [](const Radiator* self) {
+        return self->radiator_temp < RADIATOR_OPERATING_TEMP - 5 && self->on; }, STARTUP_FAULT},
+    // Faults
+    {STARTUP_FAULT,  CAUSE_ANY, [](const Radiator* self) { return !self->on; }, OFF},
+    {STARTUP_FAULT,  CAUSE_ANY, [](const Radiator* self) { return self->radiator_temp > RADIATOR_OPERATING_TEMP; }, ON},
+    {SHUTDOWN_FAULT, CAUSE_ANY, [](const Radiator* self) { return self->on; }, ON},
+    {SHUTDOWN_FAULT, CAUSE_ANY, [](const Radiator* self) { return self->radiator_temp < RADIATOR_COOLDOWN_TEMP; }, OFF},
+};
 
-Radiator::Radiator() {
-    DEBUG_PRINT("Initializing Radiator");
+Radiator::Radiator(RoomInterface* room_interface) : RoomDevice(room_interface) {
+    LOG_INFO("Initializing Radiator");
     pinMode(RADIATOR_PIN, OUTPUT);
-    if (radiator_state_preserver != PRESERVER_OFF && radiator_state_preserver != PRESERVER_ON) {
-        DEBUG_PRINT("Radiator state has been reset");
-        radiator_state_preserver = PRESERVER_OFF; // This magic number indicates off
-    }
-    if (radiator_state_preserver == PRESERVER_OFF) {
-        this->setOn(false);
-    } else if (radiator_state_preserver == PRESERVER_ON) {
-        this->setOn(true);
+    SavedState saved{};
+    if (restoreState(&saved)) {
+        state = saved.state;
+        heartbeat_expired = saved.heartbeat_expired;
+        radiator_temp = saved.radiator_temp;
+        temp_at_startup = saved.temp_at_startup;
+        temp_at_shutdown = saved.temp_at_shutdown;
+        warmup_start = xTaskGetTickCount();
+        cooldown_start = xTaskGetTickCount();
+        LOG_INFO("Radiator restored in %s at %.1fF", getStateString(), radiator_temp);
+    } else {
+        LOG_WARN("Radiator state has been reset");
     }
+    this->setOn(saved.on);
     addEventCallback("set_on", [](RoomDevice* self, const ParsedEvent_t* data) {
         const auto radiator = static_cast<Radiator*>(self);
         radiator->setOn(data->args[0].value.boolVal);
     });
     addEventCallback("heartbeat", [](RoomDevice* self, const ParsedEvent_t* data) {
         const auto radiator = static_cast<Radiator*>(self);
-        radiator->lastHeartbeat = xTaskGetTickCount();
+        radiator->heartbeat();
     });
     addEventCallback("radiator_temp_update", [](RoomDevice* self, const ParsedEvent_t* data) {
         const auto radiator = static_cast<Radiator*>(self);
         radiator->updateRadiatorTemp(data->args[0].value.floatVal);
     });
+    addEventCallback("get_transition_log", [](RoomDevice* self, const ParsedEvent_t* data) {
+        const auto radiator = static_cast<Radiator*>(self);
+        radiator->transition_log_requested = true; // Included in the next state_update
+        radiator->uplinkNow();
+    });
     deviceData["actions"][0] = "on";
 }
 
 void Radiator::startTask(TaskHandle_t* taskHandle) {
     xTaskCreate(Radiator::RTOSLoop,
         "Radiator", STACK_SIZE, this, PRIORITY, taskHandle);
+    fsm_task = *taskHandle;
+#ifdef RADIATOR_LOCAL_SENSOR
+    temperature_subscription = roomInterface->localBus().subscribe(RADIATOR_LOCAL_SENSOR, "environment_data_updated",
+        fsm_task);
+#endif
 }
 
+/**
+ * The state machine is evaluated by whichever task delivers an input, this task only exists to
+ * wake up when the nearest heartbeat or warmup/cooldown deadline passes, and to take the local sensor's readings.
+ */
 [[noreturn]] void Radiator::RTOSLoop(void* pvParameters) {
     auto* self = static_cast<Radiator *>(pvParameters);
-    TickType_t xLastWakeTime = xTaskGetTickCount();
     for (;;) {
-        if (self->on) {
-            if (self->lastHeartbeat == 0) {
-                self->lastHeartbeat = xTaskGetTickCount();
-            }
-            if (xTaskGetTickCount() - self->lastHeartbeat > RadiatorTimeout) {
-                self->setOn(false);
-                self->heartbeat_expired = true;
-            }
+        // Inputs notify this task so the deadline is recalculated after every evaluation.
+        ulTaskNotifyTake(pdTRUE, self->ticksUntilDeadline());
+        while (const auto* message = self->roomInterface->localBus().receive(self->temperature_subscription)) {
+            const auto temperature = message->number(0);
+            LocalBus::release(message);
+            if (!isnan(temperature)) self->updateRadiatorTemp(temperature);
         }
-        switch(self->state) {
-            case CLOSING: // Radiator is closing the valve
-                if (self->radiator_temp < self->temp_at_shutdown - 0.5)
-                    self->state = COOLDOWN;
-                if (self->radiator_temp <= RADIATOR_COOLDOWN_TEMP)
-                    self->state = OFF;
-                if (xTaskGetTickCount() - self->cooldown_start > RADIATOR_COOLDOWN_TIME)
-                    self->state = SHUTDOWN_FAULT;
+        self->checkTimeouts();
+    }
+}
+
+bool Radiator::windowExpired(const uint32_t start, const uint32_t window) {
+    return xTaskGetTickCount() - start > window;
+}
+
+/**
+ * Only checked once the temperature has started moving (WARMUP/COOLDOWN), the valve takes
+ * a while to open or close so a flat trend in OPENING/CLOSING is expected.
+ * @return True if the fitted temperature trend won't reach the target within RADIATOR_TREND_HORIZON.
+ */
+bool Radiator::trendCannotReach(const float_t target, const bool rising) const {
+    return trend.valid() && trend.secondsToReach(target, rising) * 1000 > RADIATOR_TREND_HORIZON;
+}
+
+/**
+ * Takes transitions out of the current state until none match.
+ * @param cause The input that triggered the evaluation.
+ * @return The number of transitions taken.
+ */
+uint8_t Radiator::evaluate(const RadiatorCause cause) {
+    xSemaphoreTake(fsm_mutex, portMAX_DELAY);
+    const auto entered_from = state;
+    uint8_t taken = 0;
+    bool matched = true;
+    while (matched && taken < RADIATOR_MAX_CHAINED_TRANSITIONS) {
+        matched = false;
+        for (const auto& transition : transitions) {
+            if (transition.from != state || (transition.causes & cause) == 0) continue;
+            if (!transition.guard(this)) continue;
+            enterState(transition.to, cause);
+            matched = true;
+            taken++;
+            break;
+        }
+    }
+    saveState(); // Every input passes through here
+    const bool faulted = state != entered_from && (state == STARTUP_FAULT || state == SHUTDOWN_FAULT);
+    const auto fault_state = state;
+    const auto fault_temp = radiator_temp;
+    xSemaphoreGive(fsm_mutex);
+    if (faulted) sendFault(fault_state, fault_temp);
+    if (fsm_task != nullptr && xTaskGetCurrentTaskHandle() != fsm_task) {
+        xTaskNotifyGive(fsm_task); // The deadlines may have moved
+    }
+    if (taken > 0) uplinkNow(); // Push every state change immediately
+    return taken;
+}
+
+/**
+ * Records the transition and runs the entry actions of the new state.
+ * @note Must be called with the fsm_mutex held.
+ */
+void Radiator::enterState(const RadiatorState new_state, const RadiatorCause cause) {
+    auto& entry = transition_log[transition_count % RADIATOR_TRANSITION_LOG_SIZE];
+    entry.timestamp = millis();
+    entry.from = state;
+    entry.to = new_state;
+    entry.cause = cause;
+    entry.radiator_temp = radiator_temp;
+    transition_count++;
+    LOG_INFO("Radiator %s -> %s (%s)", getStateString(state), getStateString(new_state), getCauseString(cause));
+    switch (new_state) {
+        case OPENING:
+            temp_at_startup = radiator_temp;
+            warmup_start = xTaskGetTickCount();
+            break;
+        case CLOSING:
+            temp_at_shutdown = radiator_temp;
+            cooldown_start = xTaskGetTickCount();
             break;
-            case COOLDOWN:
-                if (self->radiator_temp <= RADIATOR_COOLDOWN_TEMP)
-                    self->state = OFF;
-                // Check if the temperature is currently decreasing
-                if (self->radiator_temp < self->last_radiator_temp)
-                    self->cooldown_start = xTaskGetTickCount();
-                if (xTaskGetTickCount() - self->cooldown_start > RADIATOR_COOLDOWN_TIME)
-                    self->state = SHUTDOWN_FAULT;
+        case WARMUP:
+        case COOLDOWN:
+            // Samples from before the temperature started moving would drag the fitted slope towards zero
+            trend.reset();
             break;
-            case OFF: // Radiator is off and cold (and should stay cold)
-                if (self->radiator_temp > RADIATOR_COOLDOWN_TEMP + 5 && !self->on)
-                    self->state = SHUTDOWN_FAULT;
-                if (self->on) self->state = WARMUP; // Edge case check
-                break;
-            case OPENING:
-                if (self->radiator_temp > self->temp_at_startup + 0.5)
-                    self->state = WARMUP;
-                if (self->radiator_temp >= RADIATOR_OPERATING_TEMP)
-                    self->state = ON;
-                if (xTaskGetTickCount() - self->warmup_start > RADIATOR_HEATUP_TIME)
-                    self->state = STARTUP_FAULT;
-                break;
-            case WARMUP:
-                if (self->radiator_temp >= RADIATOR_OPERATING_TEMP)
-                    self->state = ON;
-                // Check if the temperature is currently increasing
-                if (self->radiator_temp > self->last_radiator_temp)
-                    self->warmup_start = xTaskGetTickCount();
-                if (self->radiator_temp < self->temp_at_startup - 2)
-                    self->state = STARTUP_FAULT;
-                if (xTaskGetTickCount() - self->warmup_start > RADIATOR_HEATUP_TIME)
-                    self->state = STARTUP_FAULT;
-                break;
-            case ON: // Radiator is on and at operating temperature
-                if (self->radiator_temp < RADIATOR_OPERATING_TEMP - 5 && self->on)
-                    self->state = STARTUP_FAULT;
-                if (!self->on) self->state = COOLDOWN; // Edge case check
-                break;
-            case STARTUP_FAULT:
-                if (self->radiator_temp > RADIATOR_OPERATING_TEMP)
-                    self->state = ON;
-                if (!self->on) self->state = OFF;
-                break;
-            case SHUTDOWN_FAULT:
-                if (self->radiator_temp < RADIATOR_COOLDOWN_TEMP)
-                    self->state = OFF;
-                if (self->on) self->state = ON;
-                break;
+        default: break;
+    }
+    state = new_state;
+}
 
-        }
-        xTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(1000));
+/**
+ * Faults go out as an urgent event ahead of the state update, CENTRAL may need to act on them (e.g. alert).
+ * @note Must be called without the fsm_mutex held, sending can block on the downlink.
+ */
+void Radiator::sendFault(const RadiatorState fault, const float_t temp) const {
+    const auto event = getScratchSpace();
+    if (event == nullptr) {
+        LOG_ERROR("Failed to get scratch space for fault event");
+        return;
     }
+    event->objectName = writeStringToScratchSpace(object_name, event);
+    event->eventName = writeStringToScratchSpace("radiator_fault", event);
+    event->urgent = true;
+    event->numArgs = 2;
+    event->args[0].type = ParsedArg::STRING;
+    event->args[0].value.stringVal = writeStringToScratchSpace(getStateString(fault), event);
+    event->args[1].type = ParsedArg::FLOAT;
+    event->args[1].value.floatVal = temp;
+    sendEvent(event);
 }
 
-void Radiator::setOn(const boolean on) {
-    // Determine the new radiator state
-    switch (state) { // The state before action
-        case OFF:
+/**
+ * @note Must be called with the fsm_mutex held.
+ */
+void Radiator::saveState() {
+    RoomDevice::saveState(SavedState{on, state, heartbeat_expired, radiator_temp, temp_at_startup, temp_at_shutdown});
+}
+
+/**
+ * Runs the timer evaluation only when a deadline passed, inputs evaluate the state machine themselves.
+ */
+void Radiator::checkTimeouts() {
+    xSemaphoreTake(fsm_mutex, portMAX_DELAY);
+    bool heartbeat_timed_out = false;
+    if (on) {
+        if (lastHeartbeat == 0) {
+            lastHeartbeat = xTaskGetTickCount();
+        }
+        if (xTaskGetTickCount() - lastHeartbeat > RadiatorTimeout) {
+            heartbeat_expired = true;
+            heartbeat_timed_out = true;
+        }
+    }
+    bool window_expired = false;
+    switch (state) {
+        case OPENING:
+        case WARMUP:
+            window_expired = windowExpired(warmup_start, RADIATOR_HEATUP_TIME);
+            break;
         case CLOSING:
         case COOLDOWN:
-            if (on) {
-                state = OPENING;
-                this->temp_at_startup = radiator_temp;
-                warmup_start = xTaskGetTickCount();
-                radiator_state_preserver = PRESERVER_ON;
-            }
-        break;
-        case ON:
+            window_expired = windowExpired(cooldown_start, RADIATOR_COOLDOWN_TIME);
+            break;
+        default: break;
+    }
+    xSemaphoreGive(fsm_mutex);
+    if (heartbeat_timed_out) {
+        setOn(false, CAUSE_HEARTBEAT_TIMEOUT);
+    } else if (window_expired) {
+        evaluate(CAUSE_TIMER);
+    }
+}
+
+/**
+ * @return The number of ticks until the nearest heartbeat or warmup/cooldown window expires.
+ */
+TickType_t Radiator::ticksUntilDeadline() const {
+    xSemaphoreTake(fsm_mutex, portMAX_DELAY);
+    const auto now = xTaskGetTickCount();
+    TickType_t wait = portMAX_DELAY;
+    const auto until = [now, &wait](const uint32_t start, const uint32_t window) {
+        const auto elapsed = now - start;
+        const TickType_t remaining = elapsed > window ? 1 : window - elapsed + 1;
+        if (remaining < wait) wait = remaining;
+    };
+    if (on && lastHeartbeat == 0) wait = 1;
+    if (on) until(lastHeartbeat, RadiatorTimeout);
+    switch (state) {
         case OPENING:
         case WARMUP:
-            if (!on) {
-                state = CLOSING;
-                this->temp_at_shutdown = radiator_temp;
-                cooldown_start = xTaskGetTickCount();
-                radiator_state_preserver = PRESERVER_OFF;
-            }
-        break;
-        case STARTUP_FAULT:
-        case SHUTDOWN_FAULT:
-            if (on)  state = OPENING;
-            if (on)  warmup_start = xTaskGetTickCount();
-            // if (on)  state = ON;
-            if (!on) state = CLOSING;
-            if (!on) cooldown_start = xTaskGetTickCount();
+            until(warmup_start, RADIATOR_HEATUP_TIME);
+            break;
+        case CLOSING:
+        case COOLDOWN:
+            until(cooldown_start, RADIATOR_COOLDOWN_TIME);
+            break;
+        default: break;
     }
+    xSemaphoreGive(fsm_mutex);
+    return wait;
+}
+
+void Radiator::setOn(const boolean on, const RadiatorCause cause) {
+    xSemaphoreTake(fsm_mutex, portMAX_DELAY);
     this->on = on;
-    DEBUG_PRINT("Radiator has been set %s", on ? "on" : "off");
+    xSemaphoreGive(fsm_mutex);
+    LOG_INFO("Radiator has been set %s", on ? "on" : "off");
     digitalWrite(RADIATOR_PIN, on ? LOW : HIGH);
-    uplinkNow(); // Force a transmission of the device data.
+    // Transitions push their own state update, force one if the command didn't change the state.
+    if (evaluate(cause) == 0) uplinkNow();
 }
 
 void Radiator::updateRadiatorTemp(const float temp) {
     // This function is called by the environment sensor to update the radiator temperature.
     // This is used to determine if the radiator should be turned on or off.
+    xSemaphoreTake(fsm_mutex, portMAX_DELAY);
     this->last_radiator_temp = radiator_temp;
     if (isnan(radiator_temp)) {
         radiator_temp = temp;
-        return;
+    } else if (40 < temp && temp < 120) {
+        radiator_temp = temp;
+        trend.addSample(xTaskGetTickCount(), temp);
     }
-    if (40 < temp && temp < 120) radiator_temp = temp;
+    // Restart the fault windows while the temperature is still moving in the right direction
+    if (state == WARMUP && radiator_temp > last_radiator_temp)
+        warmup_start = xTaskGetTickCount();
+    if (state == COOLDOWN && radiator_temp < last_radiator_temp)
+        cooldown_start = xTaskGetTickCount();
+    xSemaphoreGive(fsm_mutex);
+    evaluate(CAUSE_TEMP_UPDATE);
 }
 
-const char* Radiator::getStateString() const {
+void Radiator::heartbeat() {
+    xSemaphoreTake(fsm_mutex, portMAX_DELAY);
+    lastHeartbeat = xTaskGetTickCount();
+    xSemaphoreGive(fsm_mutex);
+    evaluate(CAUSE_HEARTBEAT);
+}
+
+const char* Radiator::getStateString(const RadiatorState state) {
     switch(state) {
         case OFF:                   return "IDLE";
         case WARMUP:                return "WARMUP";
@@ -176,16 +341,53 @@ const char* Radiator::getStateString() const {
     return "UNKNOWN";
 }
 
+const char* Radiator::getCauseString(const RadiatorCause cause) {
+    switch (cause) {
+        case CAUSE_SET_ON:            return "set_on";
+        case CAUSE_TEMP_UPDATE:       return "temp_update";
+        case CAUSE_HEARTBEAT:         return "heartbeat";
+        case CAUSE_HEARTBEAT_TIMEOUT: return "heartbeat_timeout";
+        case CAUSE_TIMER:             return "timer";
+        default: break;
+    }
+    return "unknown";
+}
+
+const char* Radiator::getStateString() const {
+    return getStateString(state);
+}
+
 JsonVariant Radiator::getDeviceData(){
     // Update the device data with the current state of the device.
+    xSemaphoreTake(fsm_mutex, portMAX_DELAY);
     deviceData["state"]["on"] = on;
     deviceData["state"]["radiator_temp"] = radiator_temp;
     deviceData["state"]["state"] = getStateString();
+    deviceData["state"]["radiator_slope"] = trend.slopePerMinute(); // (F/min)
     deviceData["health"]["online"] = true;
     // If the heartbeat is expired, set fault and reason.
     deviceData["health"]["fault"] = heartbeat_expired;
     deviceData["health"]["reason"] = heartbeat_expired ? "Heartbeat expired" : "";
     deviceData["info"]["last_heartbeat"] = lastHeartbeat;
+    deviceData["info"]["transition_count"] = transition_count;
+    if (transition_log_requested) {
+        // Oldest entry first
+        const auto log = deviceData["info"]["transitions"].to<JsonArray>();
+        const uint32_t entries = transition_count < RADIATOR_TRANSITION_LOG_SIZE ?
+            transition_count : RADIATOR_TRANSITION_LOG_SIZE;
+        for (uint32_t i = transition_count - entries; i < transition_count; i++) {
+            const auto& entry = transition_log[i % RADIATOR_TRANSITION_LOG_SIZE];
+            const auto item = log.add<JsonObject>();
+            item["time"] = entry.timestamp;
+            item["from"] = getStateString(entry.from);
+            item["to"] = getStateString(entry.to);
+            item["cause"] = getCauseString(entry.cause);
+            item["radiator_temp"] = entry.radiator_temp;
+        }
+        transition_log_requested = false;
+    } else {
+        deviceData["info"].remove("transitions");
+    }
+    xSemaphoreGive(fsm_mutex);
     return deviceData;
 }
-
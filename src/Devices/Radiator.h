@@ -5,6 +5,7 @@
 #ifndef RADIATOR_H
 #define RADIATOR_H
 #include <ControllerInterface/RoomDevice.h>
+#include "TemperatureTrend.h"
 
 #define RADIATOR_PIN 5
 #define RadiatorTimeout 120000  // Disable the radiator after 2 minutes no server heartbeat
@@ -16,13 +17,22 @@
 #define RADIATOR_OPERATING_TEMP 83.0  // (F) if the radiator is above this temp, it is considered on
 #define RADIATOR_COOLDOWN_TEMP  72.0  // (F) if the radiator is below this temp, it is considered off
 
+// Fault early if the temperature trend can't reach the target temperature within this time
+#define RADIATOR_TREND_HORIZON 600000  // (ms) 10 minutes
 
-#define PRESERVER_ON  0x4321
-#define PRESERVER_OFF 0x1234
+#define RADIATOR_TRANSITION_LOG_SIZE 16 // Number of state transitions kept for CENTRAL to fetch
+#define RADIATOR_MAX_CHAINED_TRANSITIONS 8 // Upper bound on transitions taken for a single input
 
-class Radiator : RoomDevice {
+// A temperature sensor on this board clamped to the radiator, e.g. -DRADIATOR_LOCAL_SENSOR=\"PipeSensor\". Its
+// environment_data_updated events (over the local bus) then feed the radiator temperature, CENTRAL no longer has to
+// relay it with radiator_temp_update.
+// #define RADIATOR_LOCAL_SENSOR "PipeSensor"
 
-    enum RadiatorState {
+class Radiator final : public RoomDevice {
+
+public:
+
+    enum RadiatorState : uint8_t {
         OFF,            // Radiator is off and cold
         OPENING,        // Radiator is opening the valve
         WARMUP,         // Radiator is warming up to operating temperature
@@ -33,6 +43,44 @@ class Radiator : RoomDevice {
         SHUTDOWN_FAULT  // Radiator has been commanded off but is still at operating temperature
     };
 
+    // The input that caused the state machine to be evaluated, used as a bitmask in the transition table.
+    enum RadiatorCause : uint8_t {
+        CAUSE_SET_ON            = 1 << 0, // set_on command (or restored state at boot)
+        CAUSE_TEMP_UPDATE       = 1 << 1, // radiator_temp_update
+        CAUSE_HEARTBEAT         = 1 << 2, // heartbeat from CENTRAL
+        CAUSE_HEARTBEAT_TIMEOUT = 1 << 3, // No heartbeat within RadiatorTimeout
+        CAUSE_TIMER             = 1 << 4, // A warmup/cooldown window expired
+        CAUSE_ANY               = 0xFF
+    };
+
+private:
+
+    struct Transition {
+        RadiatorState from;
+        uint8_t causes; // Mask of the causes this transition is checked on
+        bool (*guard)(const Radiator* self);
+        RadiatorState to;
+    };
+
+    // Checked top to bottom, the first matching transition out of the current state is taken.
+    static const Transition transitions[];
+
+    struct TransitionLogEntry {
+        uint32_t timestamp; // millis() at the time of the transition
+        RadiatorState from;
+        RadiatorState to;
+        RadiatorCause cause;
+        float_t radiator_temp;
+    };
+
+    TransitionLogEntry transition_log[RADIATOR_TRANSITION_LOG_SIZE] = {};
+    uint32_t transition_count = 0;
+    boolean transition_log_requested = false;
+
+    SemaphoreHandle_t fsm_mutex = xSemaphoreCreateMutex();
+    TaskHandle_t fsm_task = nullptr;
+    int8_t temperature_subscription = -1; // Local bus subscription to RADIATOR_LOCAL_SENSOR
+
     RadiatorState state = COOLDOWN;
     uint32_t lastHeartbeat = 0;
     uint32_t warmup_start = 0;
@@ -42,11 +90,42 @@ class Radiator : RoomDevice {
     float_t  temp_at_startup = NAN;
     float_t  temp_at_shutdown = NAN;
     boolean heartbeat_expired = false;
+    TemperatureTrend trend; // Fitted over the temperature updates since entering WARMUP/COOLDOWN
+
+    // Survives a restart, the warmup/cooldown windows and the heartbeat are tick based and start over instead.
+    struct SavedState {
+        static constexpr uint8_t VERSION = 1;
+        boolean on;
+        RadiatorState state;
+        boolean heartbeat_expired;
+        float_t radiator_temp;
+        float_t temp_at_startup;
+        float_t temp_at_shutdown;
+    };
+
+    void saveState();
+
+    void sendFault(RadiatorState fault, float_t temp) const;
+
+    static bool windowExpired(uint32_t start, uint32_t window);
+
+    bool trendCannotReach(float_t target, bool rising) const;
+
+    void enterState(RadiatorState new_state, RadiatorCause cause);
+
+    uint8_t evaluate(RadiatorCause cause);
+
+    void checkTimeouts();
+
+    TickType_t ticksUntilDeadline() const;
 
 public:
 
-    const char* object_name = "Radiator";
-    const char* object_type = "Radiator";
+    static constexpr const char* OBJECT_NAME = "Radiator";
+    static constexpr const char* OBJECT_TYPE = "Radiator";
+
+    const char* object_name = OBJECT_NAME;
+    const char* object_type = OBJECT_TYPE;
     boolean on = false;
 
     char* getObjectName() override {
@@ -57,12 +136,18 @@ public:
         return const_cast<char *>(object_type);
     }
 
-    Radiator();
+    explicit Radiator(RoomInterface* room_interface);
 
-    void setOn(boolean on);
+    void setOn(boolean on, RadiatorCause cause = CAUSE_SET_ON);
 
     void updateRadiatorTemp(float temp);
 
+    void heartbeat();
+
+    static const char* getStateString(RadiatorState state);
+
+    static const char* getCauseString(RadiatorCause cause);
+
     const char *getStateString() const;
 
     void startTask(TaskHandle_t* taskHandle) override;
@@ -0,0 +1,65 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#include "TemperatureTrend.h"
+
+void TemperatureTrend::reset() {
+    count = 0;
+    head = 0;
+    slope = NAN;
+    fitted = NAN;
+    span = 0;
+}
+
+void TemperatureTrend::addSample(const uint32_t tick, const float_t temp) {
+    samples[head] = {tick, temp};
+    head = (head + 1) % TREND_WINDOW_SIZE;
+    if (count < TREND_WINDOW_SIZE) count++;
+    fit();
+}
+
+void TemperatureTrend::fit() {
+    const auto oldest = samples[(head + TREND_WINDOW_SIZE - count) % TREND_WINDOW_SIZE];
+    const auto newest = samples[(head + TREND_WINDOW_SIZE - 1) % TREND_WINDOW_SIZE];
+    span = (newest.tick - oldest.tick) * portTICK_PERIOD_MS;
+    if (count < 2 || span == 0) {
+        slope = NAN;
+        fitted = newest.temp;
+        return;
+    }
+    // x is seconds since the oldest sample to keep the sums small
+    float_t sum_x = 0, sum_y = 0, sum_xy = 0, sum_xx = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        const auto& sample = samples[(head + TREND_WINDOW_SIZE - count + i) % TREND_WINDOW_SIZE];
+        const float_t x = (sample.tick - oldest.tick) * portTICK_PERIOD_MS / 1000.0f;
+        sum_x += x;
+        sum_y += sample.temp;
+        sum_xy += x * sample.temp;
+        sum_xx += x * x;
+    }
+    const float_t denominator = count * sum_xx - sum_x * sum_x;
+    if (denominator == 0) {
+        slope = NAN;
+        fitted = newest.temp;
+        return;
+    }
+    slope = (count * sum_xy - sum_x * sum_y) / denominator;
+    const float_t intercept = (sum_y - slope * sum_x) / count;
+    fitted = intercept + slope * (span / 1000.0f);
+}
+
+bool TemperatureTrend::valid() const {
+    return count >= TREND_MIN_SAMPLES && span >= TREND_MIN_SPAN && !isnan(slope);
+}
+
+float_t TemperatureTrend::slopePerMinute() const {
+    return valid() ? slope * 60 : NAN;
+}
+
+float_t TemperatureTrend::secondsToReach(const float_t target, const bool rising) const {
+    if (!valid()) return INFINITY;
+    if (rising ? fitted >= target : fitted <= target) return 0;
+    if (rising ? slope <= 0 : slope >= 0) return INFINITY;
+    return (target - fitted) / slope;
+}
@@ -0,0 +1,59 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#ifndef TEMPERATURETREND_H
+#define TEMPERATURETREND_H
+
+#include <Arduino.h>
+
+#define TREND_WINDOW_SIZE 12     // Number of samples the slope is fitted over
+#define TREND_MIN_SAMPLES 5      // Samples required before the fit is trusted
+#define TREND_MIN_SPAN    60000  // (ms) Time the samples have to cover before the fit is trusted
+
+/**
+ * Least-squares slope over a rolling window of temperature samples,
+ * used to predict how long it will take a temperature to reach a threshold.
+ */
+class TemperatureTrend {
+
+    struct Sample {
+        uint32_t tick;
+        float_t temp;
+    };
+
+    Sample samples[TREND_WINDOW_SIZE] = {};
+    uint8_t count = 0;
+    uint8_t head = 0; // Index the next sample is written to
+
+    float_t slope = NAN;   // (degrees per second)
+    float_t fitted = NAN;  // Value of the fit at the newest sample
+    uint32_t span = 0;     // (ms) Time between the oldest and newest sample
+
+    void fit();
+
+public:
+
+    TemperatureTrend() = default;
+
+    void reset();
+
+    void addSample(uint32_t tick, float_t temp);
+
+    bool valid() const;
+
+    float_t slopePerMinute() const;
+
+    /**
+     * @param target The temperature to reach.
+     * @param rising True if the target is expected to be reached from below.
+     * @return Seconds until the fitted line crosses the target, 0 if it already has and INFINITY if it is
+     * flat, moving the wrong way or the fit is not valid yet.
+     */
+    float_t secondsToReach(float_t target, bool rising) const;
+
+};
+
+
+
+#endif //TEMPERATURETREND_H
@@ -0,0 +1,266 @@
+//
+// Created by Jay on 10/18/2026.
+//
+// The ring buffer is a bounded multi-producer queue (Vyukov): every slot has a sequence number that says whether it
+// is free for the position being claimed or holds a published record, so producers never block each other and the
+// log task never sees a half written record.
+//
+
+#include "Log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+static_assert((LOG_SLOTS & (LOG_SLOTS - 1)) == 0, "LOG_SLOTS must be a power of two");
+
+namespace {
+
+struct Slot {
+    std::atomic<uint32_t> sequence{0}; // Stored minus the slot index, so a zeroed buffer is a free one
+    log_detail::Record record;
+};
+
+Slot slots[LOG_SLOTS];
+std::atomic<uint32_t> enqueue_position{0};
+std::atomic<uint32_t> dequeue_position{0};
+std::atomic<uint32_t> dropped{0};
+
+TaskHandle_t log_task = nullptr;
+SemaphoreHandle_t drain_mutex = nullptr; // Serializes the log task and logFlush, both consume
+
+constexpr const char LEVELS[] = {'-', 'E', 'W', 'I', 'D'};
+constexpr const char* MODULES[] = {"MAIN", "INTERFACE", "NETWORK", "UPDATE", "DEVICES"};
+
+uint32_t slotIndex(const log_detail::Record* record) {
+    return reinterpret_cast<const Slot*>(reinterpret_cast<const uint8_t*>(record) - offsetof(Slot, record)) - slots;
+}
+
+/**
+ * Pulls the next argument out of a record's payload.
+ */
+struct ArgReader {
+    const uint8_t* data;
+    size_t length;
+    size_t position = 0;
+
+    bool next(log_detail::arg_type_t* type, uint64_t* value, const char** string, uint8_t* string_length) {
+        if (position >= length) return false;
+        *type = static_cast<log_detail::arg_type_t>(data[position++]);
+        if (*type == log_detail::ARG_STRING) {
+            *string_length = data[position++];
+            *string = reinterpret_cast<const char*>(data + position);
+            position += *string_length;
+        } else {
+            memcpy(value, data + position, sizeof(*value));
+            position += sizeof(*value);
+        }
+        return true;
+    }
+
+    int64_t nextInt() {
+        log_detail::arg_type_t type;
+        uint64_t value = 0;
+        const char* string;
+        uint8_t string_length;
+        if (!next(&type, &value, &string, &string_length) || type == log_detail::ARG_STRING) return 0;
+        if (type == log_detail::ARG_DOUBLE) {
+            double converted;
+            memcpy(&converted, &value, sizeof(converted));
+            return static_cast<int64_t>(converted);
+        }
+        return static_cast<int64_t>(value);
+    }
+};
+
+/**
+ * printf with the arguments taken from the payload. Every conversion is formatted on its own with the length
+ * modifier replaced to match the stored type, missing or mismatched arguments print as "?".
+ */
+size_t formatRecord(char* out, const size_t size, const char* format, const uint8_t* payload,
+                    const size_t payload_length) {
+    ArgReader reader{payload, payload_length};
+    size_t length = 0;
+    const auto append = [&](const int written) {
+        if (written > 0) length = std::min(size - 1, length + written);
+    };
+    for (const char* p = format; *p != '\0' && length < size - 1; p++) {
+        if (*p != '%') {
+            out[length++] = *p;
+            continue;
+        }
+        if (*(p + 1) == '%') {
+            out[length++] = '%';
+            p++;
+            continue;
+        }
+        char spec[24] = "%";
+        size_t spec_length = 1;
+        p++;
+        // Flags, width and precision are kept, a '*' is replaced by its argument
+        while (*p != '\0' && strchr("-+ #0123456789.*", *p) != nullptr && spec_length < sizeof(spec) - 8) {
+            if (*p == '*') {
+                spec_length += snprintf(spec + spec_length, sizeof(spec) - spec_length, "%d",
+                    static_cast<int>(reader.nextInt()));
+            } else {
+                spec[spec_length++] = *p;
+            }
+            p++;
+        }
+        while (*p != '\0' && strchr("hlLqjzt", *p) != nullptr) p++; // Length modifiers, replaced below
+        if (*p == '\0') break;
+        const char conversion = *p;
+        log_detail::arg_type_t type;
+        uint64_t value = 0;
+        const char* string = nullptr;
+        uint8_t string_length = 0;
+        if (!reader.next(&type, &value, &string, &string_length)) {
+            append(snprintf(out + length, size - length, "?"));
+            continue;
+        }
+        double floating;
+        memcpy(&floating, &value, sizeof(floating));
+        if (conversion == 's') {
+            if (type != log_detail::ARG_STRING) {
+                append(snprintf(out + length, size - length, "?"));
+                continue;
+            }
+            // The copied string is not null terminated, its length is the precision (or caps the one asked for)
+            int precision = string_length;
+            if (auto* dot = strchr(spec, '.')) {
+                precision = std::min(precision, atoi(dot + 1));
+                *dot = '\0';
+                spec_length = dot - spec;
+            }
+            strcpy(spec + spec_length, ".*s");
+            append(snprintf(out + length, size - length, spec, precision, string));
+        } else if (type == log_detail::ARG_STRING) {
+            append(snprintf(out + length, size - length, "?"));
+        } else if (strchr("fFeEgGaA", conversion) != nullptr) {
+            spec[spec_length++] = conversion;
+            spec[spec_length] = '\0';
+            const double argument = type == log_detail::ARG_DOUBLE ? floating :
+                type == log_detail::ARG_INT ? static_cast<double>(static_cast<int64_t>(value)) :
+                static_cast<double>(value);
+            append(snprintf(out + length, size - length, spec, argument));
+        } else if (conversion == 'p') {
+            spec[spec_length++] = 'p';
+            spec[spec_length] = '\0';
+            const auto pointer = reinterpret_cast<void*>(static_cast<uintptr_t>(value));
+            append(snprintf(out + length, size - length, spec, pointer));
+        } else if (conversion == 'c') {
+            spec[spec_length++] = 'c';
+            spec[spec_length] = '\0';
+            append(snprintf(out + length, size - length, spec, static_cast<int>(value)));
+        } else {
+            // Integer conversions (d, i, u, x, X, o) on 64 bits
+            const auto integer = type == log_detail::ARG_DOUBLE ? static_cast<uint64_t>(floating) : value;
+            spec[spec_length++] = 'l';
+            spec[spec_length++] = 'l';
+            spec[spec_length++] = conversion;
+            spec[spec_length] = '\0';
+            if (conversion == 'd' || conversion == 'i') {
+                append(snprintf(out + length, size - length, spec, static_cast<long long>(integer)));
+            } else {
+                append(snprintf(out + length, size - length, spec, static_cast<unsigned long long>(integer)));
+            }
+        }
+    }
+    out[length] = '\0';
+    return length;
+}
+
+void writeRecord(const log_detail::Record& record) {
+    char line[LOG_LINE_SIZE];
+    const auto level = record.level < sizeof(LEVELS) ? LEVELS[record.level] : '?';
+    const auto* module = record.module < sizeof(MODULES) / sizeof(MODULES[0]) ? MODULES[record.module] : "?";
+    auto length = snprintf(line, sizeof(line), "%010lu %c [%s] %s - ",
+        static_cast<unsigned long>(record.timestamp), level, module, record.function);
+    length = std::min<int>(length, sizeof(line) - 2);
+    length += formatRecord(line + length, sizeof(line) - length - 1, record.format, record.payload, record.length);
+    line[length++] = '\n';
+    Serial.write(reinterpret_cast<const uint8_t*>(line), length);
+}
+
+/**
+ * Writes out every published record.
+ * @return False if a record was claimed but not published yet.
+ */
+bool drain() {
+    auto position = dequeue_position.load(std::memory_order_relaxed);
+    while (true) {
+        auto& slot = slots[position & (LOG_SLOTS - 1)];
+        const auto index = position & (LOG_SLOTS - 1);
+        if (slot.sequence.load(std::memory_order_acquire) + index != position + 1) {
+            dequeue_position.store(position, std::memory_order_release);
+            return enqueue_position.load(std::memory_order_acquire) == position;
+        }
+        writeRecord(slot.record);
+        slot.sequence.store(position + LOG_SLOTS - index, std::memory_order_release);
+        position++;
+        dequeue_position.store(position, std::memory_order_release);
+        const auto lost = dropped.exchange(0);
+        if (lost > 0) {
+            char line[48];
+            const auto length = snprintf(line, sizeof(line), "%u log messages dropped\n", lost);
+            Serial.write(reinterpret_cast<const uint8_t*>(line), length);
+        }
+    }
+}
+
+[[noreturn]] void logTask(void*) {
+    while (true) {
+        xSemaphoreTake(drain_mutex, portMAX_DELAY);
+        const bool empty = drain();
+        xSemaphoreGive(drain_mutex);
+        if (empty) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY); // The first message after the buffer ran empty wakes us
+        } else {
+            vTaskDelay(1); // A producer is still writing its record
+        }
+    }
+}
+
+}
+
+log_detail::Record* log_detail::claim(uint32_t* position) {
+    auto claimed = enqueue_position.load(std::memory_order_relaxed);
+    while (true) {
+        auto& slot = slots[claimed & (LOG_SLOTS - 1)];
+        const auto sequence = slot.sequence.load(std::memory_order_acquire) + (claimed & (LOG_SLOTS - 1));
+        const auto difference = static_cast<int32_t>(sequence - claimed);
+        if (difference == 0) {
+            if (enqueue_position.compare_exchange_weak(claimed, claimed + 1, std::memory_order_relaxed)) {
+                *position = claimed;
+                return &slot.record;
+            }
+        } else if (difference < 0) {
+            dropped.fetch_add(1, std::memory_order_relaxed); // Full
+            return nullptr;
+        } else {
+            claimed = enqueue_position.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void log_detail::publish(Record* record, const uint32_t position) {
+    const auto index = slotIndex(record);
+    slots[index].sequence.store(position + 1 - index, std::memory_order_release);
+    // Only the first message after the buffer ran empty has to wake the log task
+    if (log_task != nullptr && dequeue_position.load(std::memory_order_acquire) == position) {
+        xTaskNotifyGive(log_task);
+    }
+}
+
+void logBegin() {
+    if (log_task != nullptr) return;
+    drain_mutex = xSemaphoreCreateMutex();
+    xTaskCreate(logTask, "log", LOG_TASK_STACK, nullptr, LOG_TASK_PRIORITY, &log_task);
+}
+
+void logFlush() {
+    if (drain_mutex != nullptr) xSemaphoreTake(drain_mutex, portMAX_DELAY);
+    drain();
+    if (drain_mutex != nullptr) xSemaphoreGive(drain_mutex);
+    Serial.flush();
+}
@@ -0,0 +1,199 @@
+//
+// Created by Jay on 10/18/2026.
+//
+// Deferred logging. A LOG_* call copies the format string pointer and its raw arguments into a lock-free ring
+// buffer and returns, a low priority task formats the messages and writes them to Serial. The calling task never
+// waits on the UART, when the buffer is full the message is dropped and counted instead.
+//
+// Levels are compile-time: -DLOG_LEVEL=LOG_LEVEL_WARN removes every info and debug call from the binary,
+// -DLOG_LEVEL_NETWORK=LOG_LEVEL_DEBUG turns one module back up. A .cpp picks its module by defining LOG_MODULE
+// before its includes, files that don't are LOG_MODULE_MAIN.
+//
+// Format strings must be literals (only the pointer is stored). String arguments are copied, long ones are cut to
+// what fits in the record.
+//
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <Arduino.h>
+#include <type_traits>
+
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+#ifndef LOG_LEVEL_MAIN
+#define LOG_LEVEL_MAIN LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_INTERFACE
+#define LOG_LEVEL_INTERFACE LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_NETWORK
+#define LOG_LEVEL_NETWORK LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_UPDATE
+#define LOG_LEVEL_UPDATE LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_DEVICES
+#define LOG_LEVEL_DEVICES LOG_LEVEL
+#endif
+
+#ifndef LOG_MODULE
+#define LOG_MODULE LOG_MODULE_MAIN
+#endif
+
+#define LOG_SLOTS          64  // Must be a power of two
+#define LOG_PAYLOAD_SIZE   100 // (bytes) Packed arguments per message
+#define LOG_LINE_SIZE      256 // (bytes) Longest formatted line
+#define LOG_TASK_STACK     4096
+#define LOG_TASK_PRIORITY  0   // Below everything else, logs are written when there is nothing better to do
+
+typedef enum : uint8_t {
+    LOG_MODULE_MAIN,
+    LOG_MODULE_INTERFACE,
+    LOG_MODULE_NETWORK,
+    LOG_MODULE_UPDATE,
+    LOG_MODULE_DEVICES,
+} log_module_t;
+
+constexpr uint8_t logModuleLevel(const log_module_t module) {
+    switch (module) {
+        case LOG_MODULE_MAIN: return LOG_LEVEL_MAIN;
+        case LOG_MODULE_INTERFACE: return LOG_LEVEL_INTERFACE;
+        case LOG_MODULE_NETWORK: return LOG_LEVEL_NETWORK;
+        case LOG_MODULE_UPDATE: return LOG_LEVEL_UPDATE;
+        case LOG_MODULE_DEVICES: return LOG_LEVEL_DEVICES;
+        default: return LOG_LEVEL;
+    }
+}
+
+/**
+ * Starts the task that writes the buffered messages to Serial. Messages logged before this are kept until the
+ * buffer fills up.
+ */
+void logBegin();
+
+/**
+ * Writes every buffered message from the calling task, for use right before a restart.
+ */
+void logFlush();
+
+namespace log_detail {
+
+typedef enum : uint8_t {
+    ARG_INT,
+    ARG_UINT,
+    ARG_DOUBLE,
+    ARG_STRING,
+    ARG_POINTER,
+} arg_type_t;
+
+struct Record {
+    uint32_t timestamp; // (us)
+    const char* format;
+    const char* function;
+    uint8_t level;
+    uint8_t module;
+    uint8_t length; // Bytes used in payload
+    uint8_t payload[LOG_PAYLOAD_SIZE];
+};
+
+/**
+ * Claims a free record, nullptr if the buffer is full.
+ */
+Record* claim(uint32_t* position);
+
+/**
+ * Hands a claimed record to the log task.
+ */
+void publish(Record* record, uint32_t position);
+
+inline bool put(Record* record, const arg_type_t type, const void* value, const size_t size) {
+    if (record->length + 1 + size > sizeof(record->payload)) return false;
+    record->payload[record->length++] = type;
+    memcpy(record->payload + record->length, value, size);
+    record->length += size;
+    return true;
+}
+
+inline bool pack(Record* record, const char* string) {
+    if (string == nullptr) string = "(null)";
+    if (sizeof(record->payload) - record->length < 2) return false;
+    const size_t room = sizeof(record->payload) - record->length - 2;
+    // Not strnlen, the bound may run past the end of a short string literal or a fixed size array
+    size_t length = 0;
+    while (length < room && string[length] != '\0') length++;
+    record->payload[record->length++] = ARG_STRING;
+    record->payload[record->length++] = length;
+    memcpy(record->payload + record->length, string, length);
+    record->length += length;
+    return true;
+}
+
+inline bool pack(Record* record, char* string) {
+    return pack(record, static_cast<const char*>(string));
+}
+
+template<typename T>
+bool pack(Record* record, const T value) {
+    if constexpr (std::is_floating_point_v<T>) {
+        const double converted = value;
+        return put(record, ARG_DOUBLE, &converted, sizeof(converted));
+    } else if constexpr (std::is_pointer_v<T>) {
+        const uint64_t converted = reinterpret_cast<uintptr_t>(value);
+        return put(record, ARG_POINTER, &converted, sizeof(converted));
+    } else if constexpr (std::is_enum_v<T>) {
+        return pack(record, static_cast<std::underlying_type_t<T>>(value));
+    } else if constexpr (std::is_signed_v<T>) {
+        const int64_t converted = value;
+        return put(record, ARG_INT, &converted, sizeof(converted));
+    } else {
+        const uint64_t converted = value;
+        return put(record, ARG_UINT, &converted, sizeof(converted));
+    }
+}
+
+/**
+ * Never called, lets the compiler check the format string against the arguments like it did for Serial.printf.
+ */
+inline void checkFormat(const char*, ...) __attribute__((format(printf, 1, 2)));
+inline void checkFormat(const char*, ...) {}
+
+}
+
+template<typename... Args>
+void logWrite(const uint8_t level, const log_module_t module, const char* function, const char* format,
+              const Args... args) {
+    uint32_t position;
+    auto* record = log_detail::claim(&position);
+    if (record == nullptr) return;
+    record->timestamp = micros();
+    record->format = format;
+    record->function = function;
+    record->level = level;
+    record->module = module;
+    record->length = 0;
+    (void) (log_detail::pack(record, args) && ...); // Stops at the first argument that doesn't fit
+    log_detail::publish(record, position);
+}
+
+#define LOG_AT(level, ...) do { \
+    if constexpr ((level) <= logModuleLevel(LOG_MODULE)) { \
+        if (false) log_detail::checkFormat(__VA_ARGS__); \
+        logWrite(level, LOG_MODULE, __func__, __VA_ARGS__); \
+    } \
+} while (0)
+
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARN(...)  LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_INFO(...)  LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+#endif //LOG_H
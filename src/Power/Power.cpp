@@ -0,0 +1,196 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#include "Power.h"
+#include "debug.h"
+
+#ifndef NATIVE_BUILD
+#include <driver/gpio.h>
+#include <esp_sleep.h>
+#include <hal/gpio_ll.h>
+#endif
+
+namespace {
+
+struct LockState {
+    const char* name;
+    esp_pm_lock_type_t type;
+    esp_pm_lock_handle_t handle;
+    uint32_t holders;  // Nested and concurrent acquisitions, the ESP-IDF lock counts the same way
+    uint32_t since;    // (us) When holders went from 0 to 1
+    uint32_t count;    // Acquisitions since the last report
+    uint64_t held_us;  // Time with at least one holder since the last report
+};
+
+LockState locks[POWER_LOCK_COUNT] = {
+    {"network", ESP_PM_CPU_FREQ_MAX, nullptr, 0, 0, 0, 0},
+    {"i2c", ESP_PM_APB_FREQ_MAX, nullptr, 0, 0, 0, 0},
+    {"ota", ESP_PM_CPU_FREQ_MAX, nullptr, 0, 0, 0, 0},
+};
+
+constexpr const char* STATE_NAMES[] = {"cpu_max", "apb_max", "unlocked"};
+
+static_assert(sizeof(locks) / sizeof(locks[0]) == POWER_LOCK_COUNT, "Every power lock needs a state");
+static_assert(sizeof(STATE_NAMES) / sizeof(STATE_NAMES[0]) == POWER_STATE_COUNT, "Every power state needs a name");
+
+const char* mode = "off";
+bool light_sleep = false; // Set once by powerBegin(), before any pin is armed
+power_state_t state = POWER_STATE_UNLOCKED;
+uint32_t state_since = 0;                   // (us)
+uint64_t residency_us[POWER_STATE_COUNT] = {};
+uint32_t last_report = 0;                   // (ms)
+
+// The bookkeeping is a few additions, a critical section is cheaper than a mutex and works before the scheduler starts
+portMUX_TYPE busy = portMUX_INITIALIZER_UNLOCKED;
+
+void lockStats() {
+    portENTER_CRITICAL(&busy);
+}
+
+void unlockStats() {
+    portEXIT_CRITICAL(&busy);
+}
+
+/**
+ * The state the held locks allow, must be called with the stats locked.
+ */
+power_state_t heldState() {
+    auto held = POWER_STATE_UNLOCKED;
+    for (const auto& lock : locks) {
+        if (lock.holders == 0) continue;
+        if (lock.type == ESP_PM_CPU_FREQ_MAX) return POWER_STATE_CPU_MAX;
+        if (lock.type == ESP_PM_APB_FREQ_MAX) held = POWER_STATE_APB_MAX;
+    }
+    return held;
+}
+
+/**
+ * Charges the time since the last change to the current state, must be called with the stats locked.
+ */
+void accountState(const uint32_t now) {
+    residency_us[state] += now - state_since;
+    state_since = now;
+    state = heldState();
+}
+
+}
+
+void powerBegin() {
+    esp_pm_config_esp32_t config = {};
+    config.max_freq_mhz = POWER_MAX_FREQ_MHZ;
+    config.min_freq_mhz = POWER_MIN_FREQ_MHZ;
+    config.light_sleep_enable = POWER_LIGHT_SLEEP;
+    auto result = esp_pm_configure(&config);
+    if (result == ESP_ERR_NOT_SUPPORTED && config.light_sleep_enable) {
+        LOG_WARN("Light sleep is not supported by this build (no tickless idle), using DFS only");
+        config.light_sleep_enable = false;
+        result = esp_pm_configure(&config);
+    }
+    if (result == ESP_OK) {
+        mode = config.light_sleep_enable ? "light_sleep" : "dfs";
+        light_sleep = config.light_sleep_enable;
+        LOG_INFO("Power management on, %d-%dMHz%s", POWER_MIN_FREQ_MHZ, POWER_MAX_FREQ_MHZ,
+            config.light_sleep_enable ? " with light sleep" : "");
+    } else {
+        LOG_WARN("Power management is not available: %s", esp_err_to_name(result));
+    }
+    for (auto& lock : locks) {
+        if (esp_pm_lock_create(lock.type, 0, lock.name, &lock.handle) != ESP_OK) lock.handle = nullptr;
+    }
+    lockStats();
+    state_since = micros();
+    last_report = millis();
+    unlockStats();
+}
+
+void powerAcquire(const power_lock_t lock) {
+    auto& entry = locks[lock];
+    if (entry.handle != nullptr) esp_pm_lock_acquire(entry.handle);
+    lockStats();
+    if (entry.holders++ == 0) {
+        entry.since = micros();
+        entry.count++;
+        accountState(entry.since);
+    }
+    unlockStats();
+}
+
+void powerRelease(const power_lock_t lock) {
+    auto& entry = locks[lock];
+    lockStats();
+    if (entry.holders == 0) {
+        unlockStats();
+        LOG_ERROR("Power lock %s released without being held", entry.name);
+        return;
+    }
+    uint32_t held = 0;
+    if (--entry.holders == 0) {
+        const auto now = micros();
+        held = now - entry.since;
+        entry.held_us += held;
+        accountState(now);
+    }
+    unlockStats();
+    if (entry.handle != nullptr) esp_pm_lock_release(entry.handle);
+    if (held > POWER_LOCK_HOLD_WARN * 1000UL) {
+        LOG_WARN("Power lock %s was held for %lums", entry.name, static_cast<unsigned long>(held / 1000));
+    }
+}
+
+void powerWakeOnPin([[maybe_unused]] const uint8_t pin) {
+#ifndef NATIVE_BUILD
+    if (!light_sleep) return; // The edge interrupt is left alone when the CPU never sleeps
+    const auto gpio = static_cast<gpio_num_t>(pin);
+    gpio_wakeup_enable(gpio, gpio_get_level(gpio) ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+    esp_sleep_enable_gpio_wakeup();
+#endif
+}
+
+void IRAM_ATTR powerRearmPinFromISR([[maybe_unused]] const uint8_t pin) {
+#ifndef NATIVE_BUILD
+    if (!light_sleep) return;
+    // Straight to the register, the driver calls are not safe in an ISR. A change between the read and the write
+    // fires the interrupt again at once, so no edge is lost.
+    const auto gpio = static_cast<gpio_num_t>(pin);
+    gpio_ll_set_intr_type(&GPIO, gpio, gpio_ll_get_level(&GPIO, gpio) ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+#endif
+}
+
+size_t powerReport(char* buffer, const size_t size) {
+    uint64_t residency[POWER_STATE_COUNT];
+    LockState stats[POWER_LOCK_COUNT];
+    lockStats();
+    const auto now = micros();
+    accountState(now);
+    const auto interval = millis() - last_report;
+    last_report = millis();
+    memcpy(residency, residency_us, sizeof(residency));
+    memset(residency_us, 0, sizeof(residency_us));
+    for (uint8_t i = 0; i < POWER_LOCK_COUNT; i++) {
+        auto& lock = locks[i];
+        if (lock.holders > 0) { // Split the current hold between the reports
+            lock.held_us += now - lock.since;
+            lock.since = now;
+        }
+        stats[i] = lock;
+        lock.count = 0;
+        lock.held_us = 0;
+    }
+    unlockStats();
+
+    auto length = snprintf(buffer, size, R"({"msg_type":"power","mode":"%s","interval_ms":%lu,"residency_ms":{)",
+        mode, static_cast<unsigned long>(interval));
+    for (uint8_t i = 0; i < POWER_STATE_COUNT && static_cast<size_t>(length) < size; i++) {
+        length += snprintf(buffer + length, size - length, R"(%s"%s":%lu)", i == 0 ? "" : ",", STATE_NAMES[i],
+            static_cast<unsigned long>(residency[i] / 1000));
+    }
+    if (static_cast<size_t>(length) < size) length += snprintf(buffer + length, size - length, R"(},"locks":{)");
+    for (uint8_t i = 0; i < POWER_LOCK_COUNT && static_cast<size_t>(length) < size; i++) {
+        length += snprintf(buffer + length, size - length, R"(%s"%s":{"count":%lu,"held_ms":%lu})",
+            i == 0 ? "" : ",", stats[i].name, static_cast<unsigned long>(stats[i].count),
+            static_cast<unsigned long>(stats[i].held_us / 1000));
+    }
+    if (static_cast<size_t>(length) < size) length += snprintf(buffer + length, size - length, "}}");
+    return static_cast<size_t>(length) < size ? length : 0;
+}
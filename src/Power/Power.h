@@ -0,0 +1,103 @@
+//
+// Created by Jay on 10/18/2026.
+//
+// Power management. powerBegin() turns on dynamic frequency scaling (POWER_MIN_FREQ_MHZ to POWER_MAX_FREQ_MHZ) and,
+// with POWER_LIGHT_SLEEP, automatic light sleep whenever every task is blocked. That needs a framework built with
+// CONFIG_PM_ENABLE and CONFIG_FREERTOS_USE_TICKLESS_IDLE, without them it falls back to DFS only or leaves the clock
+// alone. WiFi stays associated through light sleep in modem sleep.
+//
+// The code that can't run slow holds a power lock while it works: POWER_LOCK(POWER_LOCK_NETWORK) keeps the CPU at
+// full clock for the rest of the scope. The time spent in each state the locks allow (cpu_max, apb_max, unlocked,
+// where unlocked only means no lock was held, the CPU was free to run at the DFS minimum or light sleep) and the time
+// each lock was held are sent to CENTRAL as a "power" message
+// every POWER_REPORT_INTERVAL, see powerReport(). Locks taken by the WiFi driver itself are not counted.
+//
+// Waits anywhere else should block (on a queue, semaphore or notification, with a timeout in ms via pdMS_TO_TICKS)
+// rather than poll, every wakeup ends a light sleep.
+//
+
+#ifndef POWER_H
+#define POWER_H
+
+#include <Arduino.h>
+#include <esp_pm.h>
+
+#define POWER_MAX_FREQ_MHZ    240
+#define POWER_MIN_FREQ_MHZ    80     // (MHz) The lowest DFS step WiFi keeps working at
+#ifndef POWER_LIGHT_SLEEP
+#define POWER_LIGHT_SLEEP     1
+#endif
+#define POWER_LOCK_HOLD_WARN  5000   // (ms) Releasing a lock held longer than this logs a warning
+#ifndef POWER_REPORT_INTERVAL
+#define POWER_REPORT_INTERVAL 300000 // (ms)
+#endif
+
+typedef enum : uint8_t {
+    POWER_LOCK_NETWORK, // CPU at full clock, socket writes and the processing of received messages
+    POWER_LOCK_I2C,     // APB at full clock, sensor transactions
+    POWER_LOCK_OTA,     // CPU at full clock, flash writes of an update
+    POWER_LOCK_COUNT
+} power_lock_t;
+
+typedef enum : uint8_t {
+    POWER_STATE_CPU_MAX,
+    POWER_STATE_APB_MAX,
+    POWER_STATE_UNLOCKED,
+    POWER_STATE_COUNT
+} power_state_t;
+
+/**
+ * Configures power management and creates the locks, call it once early in setup(). Locks taken before that are
+ * counted but have no effect.
+ */
+void powerBegin();
+
+void powerAcquire(power_lock_t lock);
+
+void powerRelease(power_lock_t lock);
+
+/**
+ * Lets a change of the pin wake the CPU from light sleep, which otherwise misses GPIO interrupts. Does nothing unless
+ * light sleep is on. Light sleep only wakes on a level, so the pin's interrupt becomes a level interrupt on the level
+ * opposite the pin's, call powerRearmPinFromISR() first thing in its ISR to flip it after every change. Call it after
+ * attaching the interrupt.
+ */
+void powerWakeOnPin(uint8_t pin);
+
+/**
+ * Flips the wakeup level of a pin armed with powerWakeOnPin() to the opposite of the pin's level, so the level
+ * interrupt acts as an edge interrupt rather than firing for as long as the level lasts.
+ */
+void IRAM_ATTR powerRearmPinFromISR(uint8_t pin);
+
+/**
+ * Serializes the residency and the lock statistics since the last report and resets them:
+ * {"msg_type":"power","mode":"light_sleep","interval_ms":300000,"residency_ms":{"cpu_max":812,...},
+ *  "locks":{"network":{"count":214,"held_ms":790},...}}
+ * @return The length written, 0 if the buffer was too small.
+ */
+size_t powerReport(char* buffer, size_t size);
+
+/**
+ * Holds the lock for the life of the scope.
+ */
+class PowerLock {
+    const power_lock_t lock;
+public:
+    explicit PowerLock(const power_lock_t lock) : lock(lock) {
+        powerAcquire(lock);
+    }
+
+    ~PowerLock() {
+        powerRelease(lock);
+    }
+
+    PowerLock(const PowerLock&) = delete;
+    PowerLock& operator=(const PowerLock&) = delete;
+};
+
+#define POWER_CONCAT_INNER(a, b) a##b
+#define POWER_CONCAT(a, b) POWER_CONCAT_INNER(a, b)
+#define POWER_LOCK(lock) const PowerLock POWER_CONCAT(power_lock_, __LINE__)(lock)
+
+#endif //POWER_H
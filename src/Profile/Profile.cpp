@@ -0,0 +1,116 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#include "Profile.h"
+#include "debug.h"
+
+#ifdef PROFILE
+
+#include <algorithm>
+
+static_assert((PROFILE_SUB_BUCKETS & (PROFILE_SUB_BUCKETS - 1)) == 0, "PROFILE_SUB_BUCKETS must be a power of two");
+
+namespace {
+
+constexpr uint32_t SUB_BITS = __builtin_ctz(PROFILE_SUB_BUCKETS);
+
+ProfileZone zones[PROFILE_MAX_ZONES];
+std::atomic<uint8_t> zone_count{0};
+std::atomic_flag registering = ATOMIC_FLAG_INIT;
+bool zones_full = false; // Logged, guarded by registering
+uint32_t last_report = 0;
+
+/**
+ * Log-linear bucket: values below PROFILE_SUB_BUCKETS get their own bucket, above that every power of two is split
+ * into PROFILE_SUB_BUCKETS equal parts.
+ */
+uint32_t bucketIndex(const uint32_t cycles) {
+    if (cycles < PROFILE_SUB_BUCKETS) return cycles;
+    const uint32_t exponent = 31 - __builtin_clz(cycles);
+    return (exponent - SUB_BITS + 1) * PROFILE_SUB_BUCKETS +
+        ((cycles >> (exponent - SUB_BITS)) & (PROFILE_SUB_BUCKETS - 1));
+}
+
+/**
+ * @return The largest value that falls into the bucket.
+ */
+uint32_t bucketUpperBound(const uint32_t index) {
+    if (index < PROFILE_SUB_BUCKETS) return index;
+    const uint32_t shift = index / PROFILE_SUB_BUCKETS - 1;
+    const uint64_t lower = static_cast<uint64_t>(PROFILE_SUB_BUCKETS + index % PROFILE_SUB_BUCKETS) << shift;
+    return static_cast<uint32_t>(std::min<uint64_t>(lower + (1ULL << shift) - 1, UINT32_MAX));
+}
+
+}
+
+ProfileZone* profileZone(const char* name) {
+    while (registering.test_and_set(std::memory_order_acquire)) taskYIELD();
+    ProfileZone* zone = nullptr;
+    const auto count = zone_count.load(std::memory_order_relaxed);
+    for (uint8_t i = 0; i < count && zone == nullptr; i++) {
+        if (strcmp(zones[i].name, name) == 0) zone = &zones[i];
+    }
+    if (zone == nullptr && count < PROFILE_MAX_ZONES) {
+        zone = &zones[count];
+        zone->name = name;
+        zone_count.store(count + 1, std::memory_order_release);
+    }
+    const auto turned_away = zone == nullptr && !zones_full;
+    if (turned_away) zones_full = true;
+    registering.clear(std::memory_order_release);
+    if (turned_away) LOG_WARN("Profile zone %s not measured, all %u zones are taken", name, PROFILE_MAX_ZONES);
+    return zone;
+}
+
+void profileAdd(ProfileZone* zone, const uint32_t cycles) {
+    zone->count.fetch_add(1, std::memory_order_relaxed);
+    zone->total.fetch_add(cycles, std::memory_order_relaxed);
+    zone->buckets[bucketIndex(cycles)].fetch_add(1, std::memory_order_relaxed);
+    auto current = zone->min.load(std::memory_order_relaxed);
+    while (cycles < current && !zone->min.compare_exchange_weak(current, cycles, std::memory_order_relaxed)) {}
+    current = zone->max.load(std::memory_order_relaxed);
+    while (cycles > current && !zone->max.compare_exchange_weak(current, cycles, std::memory_order_relaxed)) {}
+}
+
+size_t profileReport(char* buffer, const size_t size) {
+    const auto now = millis();
+    auto length = snprintf(buffer, size,
+        R"({"msg_type":"diagnostics","uptime":%lu,"interval_ms":%lu,"clock_hz":%lu,"zones":[)",
+        now / 1000, now - last_report, static_cast<unsigned long>(PROFILE_CLOCK_HZ));
+    last_report = now;
+    const auto count = zone_count.load(std::memory_order_acquire);
+    for (uint8_t i = 0; i < count && static_cast<size_t>(length) < size; i++) {
+        auto& zone = zones[i];
+        uint32_t buckets[PROFILE_BUCKETS];
+        uint32_t histogram_count = 0;
+        for (size_t bucket = 0; bucket < PROFILE_BUCKETS; bucket++) {
+            buckets[bucket] = zone.buckets[bucket].exchange(0, std::memory_order_relaxed);
+            histogram_count += buckets[bucket];
+        }
+        const auto calls = zone.count.exchange(0, std::memory_order_relaxed);
+        const auto total = zone.total.exchange(0, std::memory_order_relaxed);
+        const auto min = zone.min.exchange(UINT32_MAX, std::memory_order_relaxed);
+        const auto max = zone.max.exchange(0, std::memory_order_relaxed);
+        // The p99 is the upper bound of the bucket holding the 99th percentile call, capped by the real maximum
+        uint32_t p99 = 0;
+        const uint32_t rank = histogram_count - histogram_count / 100;
+        uint32_t seen = 0;
+        for (size_t bucket = 0; bucket < PROFILE_BUCKETS && histogram_count > 0; bucket++) {
+            seen += buckets[bucket];
+            if (seen >= rank) {
+                p99 = std::min(bucketUpperBound(bucket), max);
+                break;
+            }
+        }
+        length += snprintf(buffer + length, size - length,
+            R"(%s{"name":"%s","count":%lu,"total":%llu,"min":%lu,"max":%lu,"p99":%lu})", i == 0 ? "" : ",",
+            zone.name, static_cast<unsigned long>(calls), static_cast<unsigned long long>(total),
+            static_cast<unsigned long>(calls == 0 ? 0 : min), static_cast<unsigned long>(max),
+            static_cast<unsigned long>(p99));
+    }
+    if (static_cast<size_t>(length) < size) length += snprintf(buffer + length, size - length, "]}");
+    return static_cast<size_t>(length) < size ? length : 0;
+}
+
+#endif
@@ -0,0 +1,115 @@
+//
+// Created by Jay on 10/18/2026.
+//
+// Profiling zones, enabled with -DPROFILE. PROFILE_ZONE("name") measures the rest of the enclosing scope with the
+// CPU cycle counter (CCOUNT, nanoseconds on the host build) and adds it to the zone's aggregates: call count, total,
+// min, max and a log-linear histogram for the p99. Zones with the same name share their aggregates.
+// Without PROFILE the macro compiles to nothing.
+//
+// The aggregates are sent to CENTRAL as a "diagnostics" message every PROFILE_REPORT_INTERVAL and reset, so every
+// report covers one interval, see profileReport().
+//
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <Arduino.h>
+
+#define PROFILE_MAX_ZONES       16    // The firmware has 13 zones, a zone past this is not measured (logged once)
+#define PROFILE_SUB_BUCKETS     4     // Histogram buckets per power of two, the p99 is at most 25% high
+#define PROFILE_BUCKETS         (32 * PROFILE_SUB_BUCKETS)
+#ifndef PROFILE_REPORT_INTERVAL
+#define PROFILE_REPORT_INTERVAL 60000 // (ms)
+#endif
+
+#ifdef PROFILE
+
+#include <atomic>
+#ifdef NATIVE_BUILD
+#include <chrono>
+#define PROFILE_CLOCK_HZ 1000000000UL
+#else
+#define PROFILE_CLOCK_HZ (getCpuFrequencyMhz() * 1000000UL)
+#endif
+
+struct ProfileZone {
+    const char* name;
+    std::atomic<uint32_t> count{0};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint32_t> min{UINT32_MAX};
+    std::atomic<uint32_t> max{0};
+    std::atomic<uint32_t> buckets[PROFILE_BUCKETS] = {};
+};
+
+/**
+ * Finds the zone with this name, adding it on first use.
+ * @return nullptr once PROFILE_MAX_ZONES different zones exist, the first name turned away is logged.
+ */
+ProfileZone* profileZone(const char* name);
+
+void profileAdd(ProfileZone* zone, uint32_t cycles);
+
+/**
+ * Serializes the aggregates of every zone and resets them:
+ * {"msg_type":"diagnostics","uptime":S,"interval_ms":I,"clock_hz":F,
+ *  "zones":[{"name":"eventParse","count":N,"total":T,"min":A,"max":B,"p99":P},...]}
+ * Times are in clock_hz ticks. Calls made while the report is written may land in either interval.
+ * @return The length written, 0 if the buffer was too small.
+ */
+size_t profileReport(char* buffer, size_t size);
+
+inline uint32_t profileNow() {
+#ifdef NATIVE_BUILD
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#else
+    return ESP.getCycleCount();
+#endif
+}
+
+/**
+ * Measures its own lifetime.
+ */
+class ProfileScope {
+
+    ProfileZone* zone;
+    uint32_t start;
+#ifndef NATIVE_BUILD
+    BaseType_t core;
+#endif
+
+public:
+
+    explicit ProfileScope(ProfileZone* zone) : zone(zone) {
+#ifndef NATIVE_BUILD
+        core = xPortGetCoreID();
+#endif
+        start = profileNow();
+    }
+
+    ~ProfileScope() {
+        const auto cycles = profileNow() - start;
+#ifndef NATIVE_BUILD
+        if (xPortGetCoreID() != core) return; // The task moved cores, their counters are not in sync
+#endif
+        if (zone != nullptr) profileAdd(zone, cycles);
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) \
+    static ProfileZone* const PROFILE_CONCAT(profile_zone_, __LINE__) = profileZone(name); \
+    const ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(PROFILE_CONCAT(profile_zone_, __LINE__))
+
+#else
+
+#define PROFILE_ZONE(name)
+
+#endif
+
+#endif //PROFILE_H
@@ -0,0 +1,584 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#define LOG_MODULE LOG_MODULE_INTERFACE
+
+#include "RuleEngine.h"
+#include "ControllerInterface/RoomInterface.h"
+#include "Profile/Profile.h"
+#include "debug.h"
+
+#include <Preferences.h>
+#include <cmath>
+
+namespace {
+
+// Rules fired by the actions of rules, actions run on the task that raised the event
+thread_local uint8_t depth = 0;
+
+enum token_t : uint8_t {
+    T_END, T_NAME, T_NUMBER, T_STRING, T_DOT, T_ARROW, T_LPAREN, T_RPAREN, T_COMMA,
+    T_NOT, T_AND, T_OR, T_EQ, T_NE, T_LT, T_LE, T_GT, T_GE, T_ERROR
+};
+
+/**
+ * Recursive descent over the rule source, the condition is emitted in postfix order as it is parsed.
+ */
+class Compiler {
+
+    const char* cursor;
+    RuleEngine::Rule* rule;
+    token_t token = T_END;
+    const char* token_start = nullptr;
+    size_t token_length = 0;
+    float number = 0;
+    bool integer = false;
+    uint8_t constants = 0;
+    uint8_t strings = 0;
+    uint8_t depth = 0;   // Values on the stack when the condition runs
+    uint8_t nesting = 0; // Parentheses and !
+
+    void next() {
+        while (*cursor == ' ' || *cursor == '\t') cursor++;
+        token_start = cursor;
+        const char c = *cursor;
+        if (c == '\0') {
+            token = T_END;
+        } else if (isalpha(c) || c == '_') {
+            while (isalnum(*cursor) || *cursor == '_') cursor++;
+            token = T_NAME;
+        } else if (isdigit(c) || (c == '-' && isdigit(cursor[1]))) {
+            char* end;
+            number = strtof(cursor, &end);
+            integer = true;
+            for (auto* i = cursor; i < end; i++) if (*i == '.' || *i == 'e' || *i == 'E') integer = false;
+            cursor = end;
+            token = T_NUMBER;
+        } else if (c == '"') {
+            const char* end = strchr(cursor + 1, '"');
+            token = end == nullptr ? T_ERROR : T_STRING;
+            cursor = end == nullptr ? cursor + 1 : end + 1;
+        } else {
+            const char n = cursor[1];
+            cursor++;
+            switch (c) {
+                case '.': token = T_DOT; break;
+                case '(': token = T_LPAREN; break;
+                case ')': token = T_RPAREN; break;
+                case ',': token = T_COMMA; break;
+                case '-': token = n == '>' ? (cursor++, T_ARROW) : T_ERROR; break;
+                case '!': token = n == '=' ? (cursor++, T_NE) : T_NOT; break;
+                case '=': token = n == '=' ? (cursor++, T_EQ) : T_ERROR; break;
+                case '<': token = n == '=' ? (cursor++, T_LE) : T_LT; break;
+                case '>': token = n == '=' ? (cursor++, T_GE) : T_GT; break;
+                case '&': token = n == '&' ? (cursor++, T_AND) : T_ERROR; break;
+                case '|': token = n == '|' ? (cursor++, T_OR) : T_ERROR; break;
+                default: token = T_ERROR; break;
+            }
+        }
+        token_length = cursor - token_start;
+    }
+
+    bool fail(const char* message) {
+        if (error == nullptr) error = message;
+        return false;
+    }
+
+    bool isName(const char* name) const {
+        return token == T_NAME && token_length == strlen(name) && strncmp(token_start, name, token_length) == 0;
+    }
+
+    /**
+     * @return The argument index if the current token is arg0..arg9, -1 otherwise.
+     */
+    int8_t argIndex() const {
+        if (token != T_NAME || token_length != 4 || strncmp(token_start, "arg", 3) != 0) return -1;
+        return isdigit(token_start[3]) ? static_cast<int8_t>(token_start[3] - '0') : -1;
+    }
+
+    bool copyName(char* out) {
+        if (token != T_NAME) return fail("expected a name");
+        if (token_length >= RULES_NAME_LENGTH) return fail("name too long");
+        memcpy(out, token_start, token_length);
+        out[token_length] = '\0';
+        next();
+        return true;
+    }
+
+    /**
+     * Copies the current string token (without the quotes) into the string pool.
+     */
+    bool addString(uint8_t* offset) {
+        const size_t length = token_length - 2;
+        if (strings + length + 1 > RULES_STRING_POOL) return fail("too many strings");
+        memcpy(rule->strings + strings, token_start + 1, length);
+        rule->strings[strings + length] = '\0';
+        *offset = strings;
+        strings += length + 1;
+        next();
+        return true;
+    }
+
+    bool emit(const uint8_t op) {
+        if (rule->code_length >= RULES_MAX_CODE) return fail("condition too long");
+        rule->code[rule->code_length++] = op;
+        return true;
+    }
+
+    bool push(const uint8_t op) {
+        if (++depth > RULES_STACK_DEPTH) return fail("condition nested too deep");
+        return emit(op);
+    }
+
+    bool push(const uint8_t op, const uint8_t operand) {
+        return push(op) && emit(operand);
+    }
+
+    bool operand() {
+        const auto index = argIndex();
+        if (index >= 0) {
+            next();
+            return push(RuleEngine::OP_ARG, index);
+        }
+        if (isName("true") || isName("false")) {
+            const bool value = isName("true");
+            next();
+            return push(value ? RuleEngine::OP_TRUE : RuleEngine::OP_FALSE);
+        }
+        if (token == T_NUMBER) {
+            if (constants == RULES_MAX_CONSTANTS) return fail("too many numbers");
+            rule->constants[constants] = number;
+            next();
+            return push(RuleEngine::OP_NUMBER, constants++);
+        }
+        if (token == T_STRING) {
+            uint8_t offset;
+            return addString(&offset) && push(RuleEngine::OP_STRING, offset);
+        }
+        return fail("expected argN, a number, true, false or a string");
+    }
+
+    bool comparison() {
+        if (!operand()) return false;
+        uint8_t op;
+        switch (token) {
+            case T_EQ: op = RuleEngine::OP_EQ; break;
+            case T_NE: op = RuleEngine::OP_NE; break;
+            case T_LT: op = RuleEngine::OP_LT; break;
+            case T_LE: op = RuleEngine::OP_LE; break;
+            case T_GT: op = RuleEngine::OP_GT; break;
+            case T_GE: op = RuleEngine::OP_GE; break;
+            default: return true; // A lone operand is tested for truth
+        }
+        next();
+        if (!operand()) return false;
+        depth--;
+        return emit(op);
+    }
+
+    bool unary() {
+        if (token != T_NOT && token != T_LPAREN) return comparison();
+        // Bounds the recursion, the source length alone would allow a deep one on the event task's stack
+        if (++nesting > RULES_STACK_DEPTH) return fail("condition nested too deep");
+        bool valid;
+        if (token == T_NOT) {
+            next();
+            valid = unary() && emit(RuleEngine::OP_NOT);
+        } else {
+            next();
+            valid = expression();
+            if (valid && token != T_RPAREN) valid = fail("expected )");
+            if (valid) next();
+        }
+        nesting--;
+        return valid;
+    }
+
+    bool conjunction() {
+        if (!unary()) return false;
+        while (token == T_AND) {
+            next();
+            if (!unary()) return false;
+            depth--;
+            if (!emit(RuleEngine::OP_AND)) return false;
+        }
+        return true;
+    }
+
+    bool expression() {
+        if (!conjunction()) return false;
+        while (token == T_OR) {
+            next();
+            if (!conjunction()) return false;
+            depth--;
+            if (!emit(RuleEngine::OP_OR)) return false;
+        }
+        return true;
+    }
+
+    bool actionArg(RuleEngine::ActionArg& arg) {
+        const auto index = argIndex();
+        if (index >= 0) {
+            arg.kind = RuleEngine::ActionArg::TRIGGER;
+            arg.value.index = index;
+        } else if (isName("true") || isName("false")) {
+            arg.kind = RuleEngine::ActionArg::BOOL;
+            arg.value.boolVal = isName("true");
+        } else if (token == T_NUMBER && integer) {
+            arg.kind = RuleEngine::ActionArg::INT;
+            arg.value.intVal = static_cast<int>(number);
+        } else if (token == T_NUMBER) {
+            arg.kind = RuleEngine::ActionArg::FLOAT;
+            arg.value.floatVal = number;
+        } else if (token == T_STRING) {
+            arg.kind = RuleEngine::ActionArg::STRING;
+            return addString(&arg.value.index);
+        } else {
+            return fail("expected argN, a number, true, false or a string");
+        }
+        next();
+        return true;
+    }
+
+public:
+
+    const char* error = nullptr;
+
+    Compiler(const char* source, RuleEngine::Rule* rule) : cursor(source), rule(rule) {}
+
+    bool compile() {
+        next();
+        if (!copyName(rule->trigger_object)) return false;
+        if (token != T_DOT) return fail("expected . after the trigger object");
+        next();
+        if (!copyName(rule->trigger_event)) return false;
+        if (isName("if")) {
+            next();
+            if (!expression()) return false;
+        }
+        if (token != T_ARROW) return fail("expected ->");
+        next();
+        if (!copyName(rule->action_object)) return false;
+        if (token != T_DOT) return fail("expected . after the action object");
+        next();
+        if (!copyName(rule->action_event)) return false;
+        if (token != T_LPAREN) return fail("expected ( after the action event");
+        next();
+        while (token != T_RPAREN) {
+            if (rule->action_arg_count == RULES_MAX_ARGS) return fail("too many action arguments");
+            if (!actionArg(rule->action_args[rule->action_arg_count++])) return false;
+            if (token == T_COMMA) {
+                next();
+            } else if (token != T_RPAREN) {
+                return fail("expected , or )");
+            }
+        }
+        next();
+        if (token != T_END) return fail("unexpected text after the action");
+        rule->trigger_hash = LocalBus::topic(rule->trigger_object, rule->trigger_event);
+        return true;
+    }
+
+};
+
+struct Value {
+    const char* string; // Null for numbers
+    float number;
+};
+
+Value argValue(const ParsedEvent_t* event, const uint8_t index) {
+    if (index >= event->numArgs) return {nullptr, NAN};
+    const auto& arg = event->args[index];
+    switch (arg.type) {
+        case ParsedArg::BOOL: return {nullptr, arg.value.boolVal ? 1.0f : 0.0f};
+        case ParsedArg::INT: return {nullptr, static_cast<float>(arg.value.intVal)};
+        case ParsedArg::FLOAT: return {nullptr, arg.value.floatVal};
+        case ParsedArg::STRING: return {arg.value.stringVal, NAN};
+        default: return {nullptr, NAN};
+    }
+}
+
+bool truthy(const Value& value) {
+    return value.string != nullptr ? value.string[0] != '\0' : value.number != 0 && !std::isnan(value.number);
+}
+
+bool compare(const Value& a, const Value& b, const uint8_t op) {
+    int order;
+    if (a.string != nullptr || b.string != nullptr) {
+        if (a.string == nullptr || b.string == nullptr) return op == RuleEngine::OP_NE; // Never equal to a number
+        order = strcmp(a.string, b.string);
+    } else {
+        if (std::isnan(a.number) || std::isnan(b.number)) return op == RuleEngine::OP_NE; // A missing argument
+        order = a.number < b.number ? -1 : a.number > b.number ? 1 : 0;
+    }
+    switch (op) {
+        case RuleEngine::OP_EQ: return order == 0;
+        case RuleEngine::OP_NE: return order != 0;
+        case RuleEngine::OP_LT: return order < 0;
+        case RuleEngine::OP_LE: return order <= 0;
+        case RuleEngine::OP_GT: return order > 0;
+        default: return order >= 0;
+    }
+}
+
+/**
+ * Appends a JSON string body, the sources contain quotes.
+ */
+size_t appendEscaped(char* buffer, const size_t size, size_t length, const char* string) {
+    for (; *string != '\0' && length + 2 < size; string++) {
+        if (*string == '"' || *string == '\\') buffer[length++] = '\\';
+        buffer[length++] = *string;
+    }
+    return length;
+}
+
+}
+
+bool RuleEngine::compile(const char* source, Rule* rule, const char** error) {
+    *rule = {};
+    if (strlen(source) >= RULES_SOURCE_LENGTH) {
+        *error = "source too long";
+        return false;
+    }
+    Compiler compiler(source, rule);
+    if (!compiler.compile()) {
+        *error = compiler.error;
+        return false;
+    }
+    strcpy(rule->source, source);
+    return true;
+}
+
+/**
+ * Runs the condition bytecode, the compiler already checked the stack depth.
+ */
+bool RuleEngine::condition(const Rule& rule, const ParsedEvent_t* event) const {
+    if (rule.code_length == 0) return true;
+    Value stack[RULES_STACK_DEPTH];
+    uint8_t top = 0;
+    for (uint8_t pc = 0; pc < rule.code_length; pc++) {
+        const auto op = rule.code[pc];
+        switch (op) {
+            case OP_ARG: stack[top++] = argValue(event, rule.code[++pc]); break;
+            case OP_NUMBER: stack[top++] = {nullptr, rule.constants[rule.code[++pc]]}; break;
+            case OP_STRING: stack[top++] = {rule.strings + rule.code[++pc], NAN}; break;
+            case OP_TRUE: stack[top++] = {nullptr, 1.0f}; break;
+            case OP_FALSE: stack[top++] = {nullptr, 0.0f}; break;
+            case OP_NOT: stack[top - 1] = {nullptr, truthy(stack[top - 1]) ? 0.0f : 1.0f}; break;
+            case OP_AND:
+                top--;
+                stack[top - 1] = {nullptr, truthy(stack[top - 1]) && truthy(stack[top]) ? 1.0f : 0.0f};
+                break;
+            case OP_OR:
+                top--;
+                stack[top - 1] = {nullptr, truthy(stack[top - 1]) || truthy(stack[top]) ? 1.0f : 0.0f};
+                break;
+            default:
+                top--;
+                stack[top - 1] = {nullptr, compare(stack[top - 1], stack[top], op) ? 1.0f : 0.0f};
+                break;
+        }
+    }
+    return truthy(stack[0]);
+}
+
+RuleEngine::Rule* RuleEngine::find(const uint16_t id) {
+    for (uint8_t i = 0; i < count; i++) {
+        if (rules[i].id == id) return &rules[i];
+    }
+    return nullptr;
+}
+
+/**
+ * Writes the sources to NVS as [id (2 bytes), length (1 byte), source]..., must be called with the mutex held.
+ */
+void RuleEngine::store() const {
+    uint8_t blob[RULES_MAX * (3 + RULES_SOURCE_LENGTH)];
+    size_t length = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        const auto source_length = strlen(rules[i].source);
+        memcpy(blob + length, &rules[i].id, 2);
+        blob[length + 2] = static_cast<uint8_t>(source_length);
+        memcpy(blob + length + 3, rules[i].source, source_length);
+        length += 3 + source_length;
+    }
+    Preferences preferences;
+    if (!preferences.begin(RULES_NAMESPACE, false)) {
+        LOG_WARN("Failed to open NVS, the rules are lost on restart");
+        return;
+    }
+    if (length == 0) {
+        preferences.remove("sources");
+    } else {
+        preferences.putBytes("sources", blob, length);
+    }
+    preferences.end();
+}
+
+void RuleEngine::begin() {
+    uint8_t blob[RULES_MAX * (3 + RULES_SOURCE_LENGTH)];
+    Preferences preferences;
+    if (!preferences.begin(RULES_NAMESPACE, true)) return;
+    const auto length = preferences.getBytes("sources", blob, sizeof(blob));
+    preferences.end();
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    count = 0;
+    for (size_t offset = 0; offset + 3 <= length && count < RULES_MAX;) {
+        uint16_t id;
+        memcpy(&id, blob + offset, 2);
+        const uint8_t source_length = blob[offset + 2];
+        if (offset + 3 + source_length > length || source_length >= RULES_SOURCE_LENGTH) break;
+        char source[RULES_SOURCE_LENGTH];
+        memcpy(source, blob + offset + 3, source_length);
+        source[source_length] = '\0';
+        offset += 3 + source_length;
+        const char* error = nullptr;
+        if (!compile(source, &rules[count], &error)) { // The syntax changed since it was stored
+            LOG_WARN("Stored rule %u doesn't compile: %s", id, error);
+            continue;
+        }
+        rules[count++].id = id;
+    }
+    xSemaphoreGive(mutex);
+    if (count > 0) LOG_INFO("Loaded %d rule(s)", count);
+}
+
+command_status_t RuleEngine::execute(const ParsedEvent_t* event, bool* report) {
+    const bool has_id = event->numArgs > 0 && event->args[0].type == ParsedArg::INT &&
+        event->args[0].value.intVal >= 0 && event->args[0].value.intVal <= UINT16_MAX;
+    const auto id = has_id ? static_cast<uint16_t>(event->args[0].value.intVal) : 0;
+    if (strcmp(event->eventName, "add") == 0) {
+        if (!has_id || event->numArgs < 2 || event->args[1].type != ParsedArg::STRING) return COMMAND_MALFORMED;
+        Rule rule;
+        const char* error = nullptr;
+        if (!compile(event->args[1].value.stringVal, &rule, &error)) {
+            LOG_WARN("Rule %u doesn't compile: %s", id, error);
+            return COMMAND_MALFORMED;
+        }
+        rule.id = id;
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        auto* slot = find(id);
+        if (slot == nullptr && count == RULES_MAX) {
+            xSemaphoreGive(mutex);
+            LOG_WARN("Rule table is full, rejecting rule %u", id);
+            return COMMAND_BUSY;
+        }
+        if (slot == nullptr) slot = &rules[count++];
+        *slot = rule;
+        store();
+        xSemaphoreGive(mutex);
+        LOG_INFO("Rule %u: %s", id, rule.source);
+        return COMMAND_OK;
+    }
+    if (strcmp(event->eventName, "remove") == 0) {
+        if (!has_id) return COMMAND_MALFORMED;
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        if (auto* rule = find(id)) {
+            *rule = rules[--count]; // Order doesn't matter, fill the hole with the last rule
+            store();
+        }
+        xSemaphoreGive(mutex);
+        return COMMAND_OK;
+    }
+    if (strcmp(event->eventName, "clear") == 0) {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        count = 0;
+        store();
+        xSemaphoreGive(mutex);
+        return COMMAND_OK;
+    }
+    if (strcmp(event->eventName, "list") == 0) {
+        *report = true;
+        return COMMAND_OK;
+    }
+    return COMMAND_UNKNOWN_EVENT;
+}
+
+void RuleEngine::evaluate(const ParsedEvent_t* event, RoomInterface* room_interface) {
+    if (count == 0 || event->objectName == nullptr || event->eventName == nullptr) return;
+    if (depth >= RULES_MAX_DEPTH) {
+        LOG_WARN("Rules chained %d deep, not evaluating %s.%s", depth, event->objectName, event->eventName);
+        return;
+    }
+    PROFILE_ZONE("RuleEngine::evaluate");
+    const auto hash = LocalBus::topic(event->objectName, event->eventName);
+    ParsedEvent_t* actions[RULES_MAX];
+    uint16_t ids[RULES_MAX];
+    uint8_t fired = 0;
+    // The actions are filled under the mutex and executed after it, they may raise events that come back here
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (uint8_t i = 0; i < count; i++) {
+        auto& rule = rules[i];
+        if (rule.trigger_hash != hash || strcmp(rule.trigger_object, event->objectName) != 0 ||
+            strcmp(rule.trigger_event, event->eventName) != 0 || !condition(rule, event)) {
+            continue;
+        }
+        auto* action = room_interface->get_free_scratch_space();
+        if (action == nullptr) {
+            rule.failed++;
+            LOG_WARN("No scratch space for the action of rule %u", rule.id);
+            continue;
+        }
+        action->timestamp = event->timestamp;
+        action->urgent = false;
+        action->objectName = RoomInterface::write_string_to_scratch_space(rule.action_object, action);
+        action->eventName = RoomInterface::write_string_to_scratch_space(rule.action_event, action);
+        action->numArgs = rule.action_arg_count;
+        for (uint8_t a = 0; a < rule.action_arg_count; a++) {
+            const auto& arg = rule.action_args[a];
+            auto& out = action->args[a];
+            switch (arg.kind) {
+                case ActionArg::TRIGGER:
+                    if (arg.value.index >= event->numArgs) {
+                        out.type = ParsedArg::UNKNOWN;
+                    } else if (event->args[arg.value.index].type == ParsedArg::STRING) {
+                        out.type = ParsedArg::STRING;
+                        out.value.stringVal = RoomInterface::write_string_to_scratch_space(
+                            event->args[arg.value.index].value.stringVal, action);
+                    } else {
+                        out = event->args[arg.value.index];
+                    }
+                    break;
+                case ActionArg::BOOL: out.type = ParsedArg::BOOL; out.value.boolVal = arg.value.boolVal; break;
+                case ActionArg::INT: out.type = ParsedArg::INT; out.value.intVal = arg.value.intVal; break;
+                case ActionArg::FLOAT: out.type = ParsedArg::FLOAT; out.value.floatVal = arg.value.floatVal; break;
+                case ActionArg::STRING:
+                    out.type = ParsedArg::STRING;
+                    out.value.stringVal =
+                        RoomInterface::write_string_to_scratch_space(rule.strings + arg.value.index, action);
+                    break;
+            }
+        }
+        actions[fired] = action;
+        ids[fired++] = rule.id;
+    }
+    xSemaphoreGive(mutex);
+
+    depth++;
+    for (uint8_t i = 0; i < fired; i++) {
+        LOG_DEBUG("Rule %u fired on %s.%s: %s.%s", ids[i], event->objectName, event->eventName,
+            actions[i]->objectName, actions[i]->eventName);
+        const auto status = room_interface->eventExecute(actions[i]);
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        if (auto* rule = find(ids[i])) status == COMMAND_OK ? rule->fired++ : rule->failed++;
+        xSemaphoreGive(mutex);
+    }
+    depth--;
+}
+
+size_t RuleEngine::report(char* buffer, const size_t size) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    auto length = static_cast<size_t>(snprintf(buffer, size, R"({"msg_type":"rules","rules":[)"));
+    for (uint8_t i = 0; i < count && length < size; i++) {
+        const auto& rule = rules[i];
+        length += snprintf(buffer + length, size - length, R"(%s{"id":%u,"source":")", i == 0 ? "" : ",", rule.id);
+        if (length >= size) break;
+        length = appendEscaped(buffer, size, length, rule.source);
+        length += snprintf(buffer + length, size - length, R"(","fired":%lu,"failed":%lu})",
+            static_cast<unsigned long>(rule.fired), static_cast<unsigned long>(rule.failed));
+    }
+    xSemaphoreGive(mutex);
+    if (length < size) length += snprintf(buffer + length, size - length, "]}");
+    return length < size ? length : 0;
+}
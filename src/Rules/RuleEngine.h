@@ -0,0 +1,142 @@
+//
+// Created by Jay on 10/18/2026.
+//
+// Local automation, rules react to device events on the satellite instead of a round trip through CENTRAL and keep
+// working while the link is down. A rule is uploaded as text and compiled to a few bytes of stack bytecode:
+//
+//   <object>.<event> [if <condition>] -> <object>.<event>(<args>)
+//
+//   MotionDetector.motion_detected if arg0 -> Radiator.set_on(true)
+//   LivingRoomSensor.environment_data_updated if arg0 < 65 && !(arg1 > 80) -> Radiator.set_on(true)
+//   Radiator.radiator_fault if arg0 == "STARTUP_FAULT" -> Radiator.set_on(false)
+//
+// A condition compares the trigger's arguments (arg0..arg9) with numbers, true/false and "strings" using
+// == != < <= > >=, combined with ! && || and parentheses. The action is executed like a command from CENTRAL, its
+// arguments are literals or the trigger's arguments. Conditions only see the event, not device state, the state is
+// behind the device's own locks.
+//
+// Every device event (RoomInterface::sendEvent) is checked against the rules before it goes to CENTRAL. The code
+// size, stack depth and rule count are bounded so an event costs at most RULES_MAX * RULES_MAX_CODE instructions, and
+// actions that raise events of their own only chain RULES_MAX_DEPTH deep.
+//
+// Commands go to the "Rules" object: add [id, source], remove [id], clear [], list []. The rules are kept in NVS.
+//
+
+#ifndef RULEENGINE_H
+#define RULEENGINE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "ControllerInterface/RoomInterfaceDatastructures.h"
+
+#define RULES_OBJECT_NAME   "Rules"
+#define RULES_NAMESPACE     "rules"  // NVS namespace
+#define RULES_MAX           16
+#define RULES_SOURCE_LENGTH 128      // Including the null terminator
+#define RULES_NAME_LENGTH   24       // Object and event names, including the null terminator
+#define RULES_MAX_CODE      32       // (bytes) Condition bytecode per rule
+#define RULES_MAX_CONSTANTS 8        // Numbers per condition
+#define RULES_STRING_POOL   48       // (bytes) Strings per rule, condition and action
+#define RULES_MAX_ARGS      4        // Action arguments
+#define RULES_STACK_DEPTH   8
+#define RULES_MAX_DEPTH     2        // Rules fired by the actions of rules
+
+class RoomInterface;
+
+class RuleEngine {
+
+public:
+
+    enum rule_op_t : uint8_t {
+        OP_ARG,    // Push the trigger's argument [operand]
+        OP_NUMBER, // Push constants[operand]
+        OP_STRING, // Push the string at strings[operand]
+        OP_TRUE,
+        OP_FALSE,
+        OP_EQ,
+        OP_NE,
+        OP_LT,
+        OP_LE,
+        OP_GT,
+        OP_GE,
+        OP_AND,
+        OP_OR,
+        OP_NOT
+    };
+
+    struct ActionArg {
+        enum : uint8_t { TRIGGER, BOOL, INT, FLOAT, STRING } kind;
+        union {
+            uint8_t index;  // TRIGGER: the trigger's argument, STRING: the offset in the string pool
+            bool boolVal;
+            int intVal;
+            float floatVal;
+        } value;
+    };
+
+    struct Rule {
+        uint16_t id;
+        uint32_t trigger_hash; // LocalBus::topic of the trigger, checked before the names
+        char trigger_object[RULES_NAME_LENGTH];
+        char trigger_event[RULES_NAME_LENGTH];
+        uint8_t code[RULES_MAX_CODE];
+        uint8_t code_length;   // 0 for a rule without a condition
+        float constants[RULES_MAX_CONSTANTS];
+        char strings[RULES_STRING_POOL];
+        char action_object[RULES_NAME_LENGTH];
+        char action_event[RULES_NAME_LENGTH];
+        ActionArg action_args[RULES_MAX_ARGS];
+        uint8_t action_arg_count;
+        uint32_t fired;        // Actions executed
+        uint32_t failed;       // Actions that found no scratch space or weren't handled
+        char source[RULES_SOURCE_LENGTH];
+    };
+
+private:
+
+    Rule rules[RULES_MAX] = {};
+    uint8_t count = 0;
+    SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
+
+    bool condition(const Rule& rule, const ParsedEvent_t* event) const;
+
+    Rule* find(uint16_t id);
+
+    void store() const;
+
+public:
+
+    /**
+     * Compiles a rule.
+     * @param error Set to what is wrong with the source if it doesn't compile.
+     * @return False if the source doesn't compile.
+     */
+    static bool compile(const char* source, Rule* rule, const char** error);
+
+    /**
+     * Loads the rules stored by the previous boot.
+     */
+    void begin();
+
+    /**
+     * Runs an add, remove, clear or list command.
+     * @param report Set if the command asks for the rules report (list).
+     */
+    command_status_t execute(const ParsedEvent_t* event, bool* report);
+
+    /**
+     * Runs the actions of the rules the event triggers, on the calling task.
+     */
+    void evaluate(const ParsedEvent_t* event, RoomInterface* room_interface);
+
+    /**
+     * Serializes {"msg_type":"rules","rules":[{"id","source","fired","failed"},...]}.
+     * @return The length written, 0 if the buffer was too small.
+     */
+    size_t report(char* buffer, size_t size);
+
+};
+
+#endif //RULEENGINE_H
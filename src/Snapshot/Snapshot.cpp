@@ -0,0 +1,159 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#define LOG_MODULE LOG_MODULE_DEVICES
+
+#include "Snapshot.h"
+#include "debug.h"
+
+namespace {
+
+struct RecordHeader {
+    uint32_t key; // FNV-1a of the name
+    uint8_t version;
+    uint8_t reserved;
+    uint16_t length;
+};
+
+struct SnapshotArea {
+    uint32_t magic;
+    uint32_t crc; // Over used and the used part of records
+    uint16_t used;
+    uint16_t reserved;
+    alignas(4) uint8_t records[SNAPSHOT_SIZE];
+};
+
+__NOINIT_ATTR SnapshotArea area;
+
+// What the previous boot left, reads are served from this copy so a record written during this boot (or by another
+// RoomInterface in the fleet simulation) is never mistaken for a restored one.
+alignas(4) uint8_t restored[SNAPSHOT_SIZE];
+uint16_t restored_used = 0;
+
+portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+bool initialized = false;
+bool warm = false;
+bool unreported = false; // The outcome of initialize() is logged by release(), never inside the critical section
+
+uint32_t keyHash(const char* key) {
+    uint32_t hash = 2166136261UL;
+    while (*key != '\0') {
+        hash ^= static_cast<uint8_t>(*key++);
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+uint32_t crc32(uint32_t crc, const uint8_t* data, size_t length) {
+    crc = ~crc;
+    while (length-- > 0) {
+        crc ^= *data++;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+uint32_t areaCrc() {
+    const auto crc = crc32(0, reinterpret_cast<const uint8_t*>(&area.used), sizeof(area.used));
+    return crc32(crc, area.records, area.used);
+}
+
+size_t recordSize(const RecordHeader* header) {
+    return sizeof(RecordHeader) + ((header->length + 3) & ~3);
+}
+
+/**
+ * @return The offset of the record stored under key, -1 if there is none.
+ */
+int32_t findRecord(const uint8_t* records, const uint16_t used, const uint32_t key) {
+    size_t offset = 0;
+    while (offset + sizeof(RecordHeader) <= used) {
+        const auto* header = reinterpret_cast<const RecordHeader*>(records + offset);
+        if (header->key == key) return static_cast<int32_t>(offset);
+        offset += recordSize(header);
+    }
+    return -1;
+}
+
+/**
+ * Validates the area left by the previous boot, must be called with the lock held.
+ */
+void initialize() {
+    if (initialized) return;
+    initialized = true;
+    unreported = true;
+    if (area.magic == SNAPSHOT_MAGIC && area.used <= SNAPSHOT_SIZE && area.crc == areaCrc()) {
+        memcpy(restored, area.records, area.used);
+        restored_used = area.used;
+        warm = true;
+        return;
+    }
+    area.magic = SNAPSHOT_MAGIC;
+    area.used = 0;
+    area.reserved = 0;
+    area.crc = areaCrc();
+}
+
+void acquire() {
+    portENTER_CRITICAL(&lock);
+    initialize();
+}
+
+void release() {
+    const bool report = unreported;
+    unreported = false;
+    portEXIT_CRITICAL(&lock);
+    if (!report) return;
+    if (warm) {
+        LOG_INFO("Warm restart, restoring %u bytes of device state", restored_used);
+    } else {
+        LOG_INFO("No valid device state snapshot, starting cold");
+    }
+}
+
+}
+
+bool snapshotRead(const char* key, const uint8_t version, void* data, const size_t size) {
+    acquire();
+    const auto offset = findRecord(restored, restored_used, keyHash(key));
+    const auto* header = offset < 0 ? nullptr : reinterpret_cast<const RecordHeader*>(restored + offset);
+    const bool found = header != nullptr && header->version == version && header->length == size;
+    if (found) memcpy(data, restored + offset + sizeof(RecordHeader), size);
+    release();
+    return found;
+}
+
+bool snapshotWrite(const char* key, const uint8_t version, const void* data, const size_t size) {
+    const auto hash = keyHash(key);
+    acquire();
+    auto offset = findRecord(area.records, area.used, hash);
+    auto* header = offset < 0 ? nullptr : reinterpret_cast<RecordHeader*>(area.records + offset);
+    if (header != nullptr && header->length != size) { // Resized, drop it and append the new one
+        const auto removed = recordSize(header);
+        memmove(area.records + offset, area.records + offset + removed, area.used - offset - removed);
+        area.used -= removed;
+        header = nullptr;
+    }
+    if (header == nullptr) {
+        const auto needed = sizeof(RecordHeader) + ((size + 3) & ~3);
+        if (area.used + needed > SNAPSHOT_SIZE) {
+            release();
+            LOG_ERROR("Snapshot area full, %s is not saved", key);
+            return false;
+        }
+        offset = area.used;
+        header = reinterpret_cast<RecordHeader*>(area.records + offset);
+        header->key = hash;
+        header->reserved = 0;
+        header->length = size;
+        area.used += needed;
+    }
+    header->version = version;
+    memcpy(area.records + offset + sizeof(RecordHeader), data, size);
+    area.crc = areaCrc();
+    release();
+    return true;
+}
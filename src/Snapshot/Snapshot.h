@@ -0,0 +1,46 @@
+//
+// Created by Jay on 10/18/2026.
+//
+// Warm restart snapshot. Devices write their state into a checksummed area of no-init memory whenever it changes,
+// the area survives esp_restart(), watchdog and panic resets (not power loss) and is read back by the device
+// constructors on the next boot so the first state_update is accurate straight away.
+//
+// Every record is keyed by a name (the device's object name) and carries a layout version, a record whose version
+// or size doesn't match what the reader expects is ignored. A corrupt area (power-on garbage, a reset in the middle
+// of a write) fails the checksum and the boot starts cold.
+//
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <Arduino.h>
+#include <type_traits>
+
+#define SNAPSHOT_SIZE  256        // (bytes) Record area, every record costs 8 bytes plus its size rounded up to 4
+#define SNAPSHOT_MAGIC 0x534E4150 // "SNAP"
+
+/**
+ * Copies the record stored under key by the previous boot.
+ * @return False if there is none, or it has a different version or size.
+ */
+bool snapshotRead(const char* key, uint8_t version, void* data, size_t size);
+
+/**
+ * Replaces the record stored under key.
+ * @return False if the area is full.
+ */
+bool snapshotWrite(const char* key, uint8_t version, const void* data, size_t size);
+
+template<typename T>
+bool snapshotRead(const char* key, const uint8_t version, T* state) {
+    static_assert(std::is_trivially_copyable_v<T>, "Snapshot records are copied byte for byte");
+    return snapshotRead(key, version, state, sizeof(T));
+}
+
+template<typename T>
+bool snapshotWrite(const char* key, const uint8_t version, const T& state) {
+    static_assert(std::is_trivially_copyable_v<T>, "Snapshot records are copied byte for byte");
+    return snapshotWrite(key, version, &state, sizeof(T));
+}
+
+#endif //SNAPSHOT_H
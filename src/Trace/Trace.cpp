@@ -0,0 +1,121 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#include "Trace.h"
+
+#ifdef TRACE
+
+#include <algorithm>
+#include <atomic>
+
+static_assert((TRACE_BUFFER_SIZE & (TRACE_BUFFER_SIZE - 1)) == 0, "TRACE_BUFFER_SIZE must be a power of two");
+
+namespace {
+
+TraceRecord records[TRACE_BUFFER_SIZE];
+std::atomic<uint32_t> recorded{0}; // Total records ever claimed, the next slot is recorded % TRACE_BUFFER_SIZE
+std::atomic<uint32_t> next_message_id{1};
+std::atomic<bool> paused{false};
+
+struct TraceTask {
+    std::atomic<TaskHandle_t> handle{nullptr};
+    char name[16];
+};
+
+TraceTask tasks[TRACE_MAX_TASKS];
+std::atomic<uint8_t> task_count{0};
+
+char dump_buffer[4096]; // Only used under the paused flag
+
+/**
+ * Finds the calling task in the task table, adding it on first use.
+ * A task only ever registers itself, so a slot can't be claimed twice for the same task.
+ */
+uint8_t taskIndex() {
+    const auto handle = xTaskGetCurrentTaskHandle();
+    const auto count = std::min<uint8_t>(task_count.load(std::memory_order_acquire), TRACE_MAX_TASKS);
+    for (uint8_t i = 0; i < count; i++) {
+        if (tasks[i].handle.load(std::memory_order_acquire) == handle) return i;
+    }
+    const auto index = task_count.fetch_add(1);
+    if (index >= TRACE_MAX_TASKS) {
+        task_count = TRACE_MAX_TASKS;
+        return UINT8_MAX;
+    }
+    strncpy(tasks[index].name, pcTaskGetName(nullptr), sizeof(tasks[index].name) - 1);
+    tasks[index].handle.store(handle, std::memory_order_release);
+    return index;
+}
+
+size_t hexEncode(const uint8_t* data, const size_t length, char* out) {
+    static constexpr char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < length; i++) {
+        out[i * 2] = digits[data[i] >> 4];
+        out[i * 2 + 1] = digits[data[i] & 0x0f];
+    }
+    return length * 2;
+}
+
+void serialWriter(const char* data, const size_t length, void*) {
+    Serial.print("TRACE ");
+    Serial.write(reinterpret_cast<const uint8_t*>(data), length);
+    Serial.println();
+}
+
+}
+
+void traceRecord(const trace_type_t type, const trace_object_t object, const uint32_t id, const uint32_t value) {
+    if (paused.load(std::memory_order_relaxed)) return;
+    auto& record = records[recorded.fetch_add(1, std::memory_order_relaxed) & (TRACE_BUFFER_SIZE - 1)];
+    record.timestamp = micros();
+    record.type = type;
+    record.task = taskIndex();
+    record.object = object;
+    record.id = id;
+    record.value = value;
+}
+
+uint32_t traceNextMessageId() {
+    auto id = next_message_id.fetch_add(1, std::memory_order_relaxed);
+    if (id == 0) id = next_message_id.fetch_add(1, std::memory_order_relaxed); // Skip 0 after wrapping
+    return id;
+}
+
+void traceDump(const trace_writer_t writer, void* context) {
+    if (paused.exchange(true)) return; // Another dump is running
+    const uint32_t total = recorded.load();
+    const uint32_t available = std::min<uint32_t>(total, TRACE_BUFFER_SIZE);
+    const uint32_t first = total - available;
+    const uint32_t chunks = 1 + (available + TRACE_CHUNK_RECORDS - 1) / TRACE_CHUNK_RECORDS;
+
+    auto length = snprintf(dump_buffer, sizeof(dump_buffer),
+        R"({"msg_type":"trace","seq":0,"chunks":%u,"recorded":%u,"tasks":[)", chunks, total);
+    const auto count = std::min<uint8_t>(task_count.load(), TRACE_MAX_TASKS);
+    for (uint8_t i = 0; i < count; i++) {
+        length += snprintf(dump_buffer + length, sizeof(dump_buffer) - length, "%s\"%s\"", i == 0 ? "" : ",",
+            tasks[i].handle.load() == nullptr ? "?" : tasks[i].name);
+    }
+    length += snprintf(dump_buffer + length, sizeof(dump_buffer) - length, "]}");
+    writer(dump_buffer, length, context);
+
+    for (uint32_t chunk = 1; chunk < chunks; chunk++) {
+        length = snprintf(dump_buffer, sizeof(dump_buffer),
+            R"({"msg_type":"trace","seq":%u,"chunks":%u,"data":")", chunk, chunks);
+        const uint32_t start = (chunk - 1) * TRACE_CHUNK_RECORDS;
+        const uint32_t end = std::min<uint32_t>(start + TRACE_CHUNK_RECORDS, available);
+        for (uint32_t i = start; i < end; i++) {
+            const auto& record = records[(first + i) & (TRACE_BUFFER_SIZE - 1)];
+            length += hexEncode(reinterpret_cast<const uint8_t*>(&record), sizeof(record), dump_buffer + length);
+        }
+        length += snprintf(dump_buffer + length, sizeof(dump_buffer) - length, "\"}");
+        writer(dump_buffer, length, context);
+    }
+    paused = false;
+}
+
+void traceDumpSerial() {
+    traceDump(serialWriter, nullptr);
+}
+
+#endif
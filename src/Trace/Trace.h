@@ -0,0 +1,104 @@
+//
+// Created by Jay on 10/18/2026.
+//
+// Binary trace of the message pipeline, enabled with -DTRACE. Every trace point is a 16 byte record in a ring
+// buffer, recording one costs an atomic increment and a handful of stores instead of a Serial.printf.
+// Without TRACE the TRACE_* macros compile to nothing.
+//
+// The buffer is dumped as "trace" messages over the datalink or as "TRACE {json}" lines over serial, see
+// traceDump(). TraceConverter.py turns either into a Chrome/Perfetto trace.
+//
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <Arduino.h>
+
+#define TRACE_BUFFER_SIZE   1024 // Records, must be a power of two (16 KB)
+#define TRACE_MAX_TASKS     32
+#define TRACE_CHUNK_RECORDS 96   // Records per dump message, keeps the hex payload under the 4 KB downlink buffer
+#define TRACE_OBJECT_NAME   "trace" // sub_device_id CENTRAL sends the dump command to
+
+/**
+ * What a record describes, the decoder (TraceConverter.py) keeps the same numbering.
+ */
+typedef enum : uint8_t {
+    TRACE_WAIT_BEGIN = 1,  // Task blocks on object
+    TRACE_WAIT_END,        // Task unblocked, value is 1 if it got the object, 0 on timeout
+    TRACE_QUEUE_SEND,      // Message id put on a queue, value is 0 if the queue was full
+    TRACE_QUEUE_RECEIVE,   // Message id taken off a queue
+    TRACE_MSG_QUEUED,      // Downlink message id created, value is its length
+    TRACE_MSG_SENT,        // Downlink message id written to the socket, value is the write time in us
+    TRACE_MSG_RECEIVED,    // Uplink message id read from the socket, value is its length
+    TRACE_MSG_PARSED,      // Uplink message id parsed into an event
+    TRACE_MSG_EXECUTED,    // Uplink message id executed on the devices
+    TRACE_OTA_CHUNK,       // OTA data passed to the update handler, value is its length
+} trace_type_t;
+
+/**
+ * The queues and locks the trace points refer to, kept as small numbers so a record stays 16 bytes.
+ */
+typedef enum : uint16_t {
+    TRACE_OBJ_NONE = 0,
+    TRACE_OBJ_DOWNLINK_QUEUE,
+    TRACE_OBJ_UPLINK_QUEUE,
+    TRACE_OBJ_UPDATE_QUEUE,
+    TRACE_OBJ_DOWNLINK_BUFFER_MUTEX,
+    TRACE_OBJ_EXCLUSIVE_DOWNLINK_MUTEX,
+    TRACE_OBJ_DOWNLINK_SEMAPHORE,
+} trace_object_t;
+
+struct TraceRecord {
+    uint32_t timestamp; // (us) micros(), wraps after ~71 minutes
+    uint8_t type;       // trace_type_t
+    uint8_t task;       // Index into the task table sent with the dump
+    uint16_t object;    // trace_object_t
+    uint32_t id;        // Message id, 0 if the record is not about a message
+    uint32_t value;
+};
+
+static_assert(sizeof(TraceRecord) == 16, "Trace records are decoded as 16 bytes");
+
+/**
+ * Receives one serialized dump message (JSON, without a null terminator).
+ */
+typedef void (*trace_writer_t)(const char* data, size_t length, void* context);
+
+#ifdef TRACE
+
+void traceRecord(trace_type_t type, trace_object_t object, uint32_t id, uint32_t value);
+
+/**
+ * @return A new message id, never 0.
+ */
+uint32_t traceNextMessageId();
+
+/**
+ * Serializes the task table and then the buffer, oldest record first, as "trace" messages:
+ * {"msg_type":"trace","seq":0,"chunks":N,"recorded":R,"tasks":["loopTask",...]}
+ * {"msg_type":"trace","seq":1,"chunks":N,"data":"<hex of up to TRACE_CHUNK_RECORDS records>"} ...
+ * Recording is paused while dumping, a dump requested during another one is dropped.
+ * @param writer Called once per message.
+ */
+void traceDump(trace_writer_t writer, void* context);
+
+/**
+ * Dumps the buffer as "TRACE {json}" lines to Serial.
+ */
+void traceDumpSerial();
+
+#define TRACE_EVENT(type, object, id, value) traceRecord(type, object, id, value)
+#define TRACE_WAIT_BEGIN(object) traceRecord(TRACE_WAIT_BEGIN, object, 0, 0)
+#define TRACE_WAIT_END(object, result) traceRecord(TRACE_WAIT_END, object, 0, (result) == pdTRUE)
+#define TRACE_MESSAGE_ID() traceNextMessageId()
+
+#else
+
+#define TRACE_EVENT(type, object, id, value)
+#define TRACE_WAIT_BEGIN(object)
+#define TRACE_WAIT_END(object, result)
+#define TRACE_MESSAGE_ID() 0
+
+#endif
+
+#endif //TRACE_H
@@ -0,0 +1,210 @@
+//
+// Created by Jay on 10/18/2026.
+//
+
+#define LOG_MODULE LOG_MODULE_NETWORK
+
+#include "WifiJoin.h"
+#include "debug.h"
+#include "secrets.h"
+
+#include <Preferences.h>
+#include <WiFi.h>
+#include <atomic>
+#include <ctime>
+#ifndef NATIVE_BUILD
+#include <esp_netif.h>
+#include <esp_netif_net_stack.h>
+#include <lwip/dhcp.h>
+#endif
+
+namespace {
+
+struct CachedLease {
+    static constexpr uint8_t VERSION = 2;
+    uint8_t version;
+    uint8_t channel;
+    uint8_t bssid[6];
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+    uint16_t reuse;   // Fast joins since the lease was handed out
+    uint32_t seconds; // (s) Length of the lease, 0 if unknown
+    uint32_t expires; // (s) Wall clock time it runs out at, 0 until the wall clock was set
+};
+
+constexpr const char* JOIN_NAMES[] = {"fast", "fast_dhcp", "full", "fallback"};
+constexpr time_t WALL_CLOCK_SET = 1600000000; // (s) Any earlier time means SNTP hasn't set the clock yet
+
+CachedLease lease = {};
+wifi_join_t join = WIFI_JOIN_FULL;
+uint32_t join_started = 0;  // (ms) When the current attempt was started
+uint32_t first_started = 0; // (ms) When wifiJoinStart was called, the connect time includes any fallback
+uint32_t connect_ms = 0;
+uint32_t leased_at = 0;     // (ms) When DHCP handed out the current lease, for its expiry once the wall clock is set
+bool connected = false;
+std::atomic<bool> started{false}; // The downlink task may poll before setup() has started the join
+
+bool loadLease() {
+    Preferences preferences;
+    if (!preferences.begin(WIFI_JOIN_NAMESPACE, true)) return false;
+    const auto read = preferences.getBytes("lease", &lease, sizeof(lease));
+    preferences.end();
+    return read == sizeof(lease) && lease.version == CachedLease::VERSION && lease.channel != 0 && lease.ip != 0;
+}
+
+void storeLease() {
+    Preferences preferences;
+    if (!preferences.begin(WIFI_JOIN_NAMESPACE, false)) {
+        LOG_WARN("Failed to open NVS, the WiFi lease is not cached");
+        return;
+    }
+    preferences.putBytes("lease", &lease, sizeof(lease));
+    preferences.end();
+}
+
+void forgetLease() {
+    Preferences preferences;
+    if (!preferences.begin(WIFI_JOIN_NAMESPACE, false)) return;
+    preferences.remove("lease");
+    preferences.end();
+}
+
+/**
+ * @return (s) The length of the lease DHCP handed out, 0 if unknown.
+ */
+uint32_t leaseSeconds() {
+#ifdef NATIVE_BUILD
+    return 0;
+#else
+    auto* station = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    if (station == nullptr) return 0;
+    const auto* dhcp = netif_dhcp_data(static_cast<netif*>(esp_netif_get_netif_impl(station)));
+    return dhcp != nullptr ? dhcp->offered_t0_lease : 0;
+#endif
+}
+
+/**
+ * Works out when the lease runs out once the wall clock is set, and caches it.
+ */
+void recordExpiry() {
+    const auto now = time(nullptr);
+    if (lease.expires != 0 || lease.seconds == 0 || now < WALL_CLOCK_SET) return;
+    lease.expires = now - (millis() - leased_at) / 1000 + lease.seconds;
+    storeLease();
+}
+
+/**
+ * @return True if the cached lease can be used as a static address for a while longer.
+ */
+bool leaseValid() {
+    const auto now = time(nullptr);
+    return lease.expires != 0 && now >= WALL_CLOCK_SET && now + WIFI_LEASE_MARGIN < lease.expires;
+}
+
+void beginFullJoin(const wifi_join_t kind) {
+    join = kind;
+    WiFi.config(IPAddress(), IPAddress(), IPAddress()); // An unset address turns DHCP back on
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+    join_started = millis();
+}
+
+/**
+ * Gives up the current association, waiting (briefly) for the driver to report it so the next poll doesn't see the
+ * old connection.
+ */
+void disconnect() {
+    WiFi.disconnect();
+    const auto since = millis();
+    while (WiFi.status() == WL_CONNECTED && millis() - since < 1000) vTaskDelay(10 / portTICK_PERIOD_MS);
+}
+
+}
+
+void wifiJoinStart() {
+    first_started = millis();
+    if (loadLease()) {
+        join = leaseValid() ? WIFI_JOIN_FAST : WIFI_JOIN_FAST_DHCP;
+        LOG_INFO("Fast joining %02X:%02X:%02X:%02X:%02X:%02X on channel %u as %s",
+            lease.bssid[0], lease.bssid[1], lease.bssid[2], lease.bssid[3], lease.bssid[4], lease.bssid[5],
+            lease.channel, join == WIFI_JOIN_FAST ? IPAddress(lease.ip).toString().c_str() : "DHCP");
+        if (join == WIFI_JOIN_FAST) {
+            WiFi.config(IPAddress(lease.ip), IPAddress(lease.gateway), IPAddress(lease.subnet), IPAddress(lease.dns));
+        } else {
+            WiFi.config(IPAddress(), IPAddress(), IPAddress()); // An unset address turns DHCP back on
+        }
+        WiFi.begin(WIFI_SSID, WIFI_PASSWORD, lease.channel, lease.bssid);
+        join_started = millis();
+    } else {
+        beginFullJoin(WIFI_JOIN_FULL);
+    }
+    started.store(true, std::memory_order_release);
+}
+
+bool wifiJoinPoll() {
+    if (!started.load(std::memory_order_acquire)) return false;
+    if (WiFi.status() != WL_CONNECTED) {
+        const uint32_t elapsed = millis() - join_started;
+        if ((join == WIFI_JOIN_FAST && elapsed > WIFI_FAST_JOIN_TIMEOUT) ||
+            (join == WIFI_JOIN_FAST_DHCP && elapsed > WIFI_FAST_DHCP_TIMEOUT)) {
+            LOG_WARN("Fast join failed to connect in %lums [%d], falling back to a full join",
+                static_cast<unsigned long>(elapsed), WiFi.status());
+            forgetLease();
+            disconnect();
+            beginFullJoin(WIFI_JOIN_FALLBACK);
+        } else if (elapsed > WIFI_CONNECT_TIMEOUT) {
+            LOG_WARN("WiFi failed to connect [%d], attempting again...", WiFi.status());
+            WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+            join_started = millis();
+        }
+        return false;
+    }
+    if (connected) return true;
+    connected = true;
+    connect_ms = millis() - first_started;
+    if (join == WIFI_JOIN_FAST) {
+        lease.reuse++;
+    } else {
+        lease.version = CachedLease::VERSION;
+        lease.channel = WiFi.channel();
+        memcpy(lease.bssid, WiFi.BSSID(), sizeof(lease.bssid));
+        lease.ip = WiFi.localIP();
+        lease.gateway = WiFi.gatewayIP();
+        lease.subnet = WiFi.subnetMask();
+        lease.dns = WiFi.dnsIP();
+        lease.reuse = 0;
+        lease.seconds = leaseSeconds();
+        lease.expires = 0;
+        leased_at = millis();
+    }
+    storeLease();
+    recordExpiry();
+    LOG_INFO("WiFi connected (%s join) in %lums with IP: %s, channel %u, RSSI %d",
+        JOIN_NAMES[join], static_cast<unsigned long>(connect_ms), WiFi.localIP().toString().c_str(),
+        lease.channel, WiFi.RSSI());
+    return true;
+}
+
+bool wifiJoinUsedCache() {
+    return connected && join == WIFI_JOIN_FAST;
+}
+
+void wifiJoinFallback(const char* reason) {
+    LOG_WARN("%s over the cached WiFi lease, falling back to a full join", reason);
+    forgetLease();
+    connected = false;
+    disconnect();
+    beginFullJoin(WIFI_JOIN_FALLBACK);
+}
+
+size_t wifiJoinReport(char* buffer, const size_t size) {
+    recordExpiry();
+    const auto now = time(nullptr);
+    const long left = lease.expires != 0 && now >= WALL_CLOCK_SET ? static_cast<long>(lease.expires - now) : -1;
+    const auto length = snprintf(buffer, size,
+        R"({"msg_type":"wifi","join":"%s","connect_ms":%lu,"channel":%u,"rssi":%d,"lease_reuse":%u,)"
+        R"("lease_left_s":%ld})", JOIN_NAMES[join], static_cast<unsigned long>(connect_ms), lease.channel,
+        WiFi.RSSI(), lease.reuse, left);
+    return length > 0 && static_cast<size_t>(length) < size ? length : 0;
+}
@@ -0,0 +1,60 @@
+//
+// Created by Jay on 10/18/2026.
+//
+// WiFi join with a fast path. After every successful join the AP's BSSID and channel and the DHCP lease are cached
+// in NVS, the next boot associates straight to that AP (no scan). While the lease has not expired (by the wall clock,
+// with WIFI_LEASE_MARGIN to spare) it is used as a static address, otherwise the fast join asks DHCP. The expiry is
+// only known once the wall clock is set, which a restart keeps but a power cycle doesn't. If the fast join doesn't
+// connect within WIFI_FAST_JOIN_TIMEOUT, or CENTRAL can't be reached over it, the cache is dropped and a full join
+// (scan and DHCP) is done instead.
+//
+
+#ifndef WIFIJOIN_H
+#define WIFIJOIN_H
+
+#include <Arduino.h>
+
+#define WIFI_CONNECT_TIMEOUT   60000 // (ms) Before a full join is started over
+#define WIFI_FAST_JOIN_TIMEOUT 3000  // (ms) Before the fast join is given up for a full join
+#define WIFI_FAST_DHCP_TIMEOUT 6000  // (ms) The same for a fast join that waits for DHCP
+#define WIFI_LEASE_MARGIN      300   // (s) A lease this close to its expiry is renewed with DHCP rather than reused
+#define WIFI_JOIN_NAMESPACE    "wifi_join"
+
+typedef enum : uint8_t {
+    WIFI_JOIN_FAST,      // Cached BSSID, channel and address
+    WIFI_JOIN_FAST_DHCP, // Cached BSSID and channel with DHCP, the lease expired or its expiry is unknown
+    WIFI_JOIN_FULL,      // Scan and DHCP, nothing (usable) was cached
+    WIFI_JOIN_FALLBACK,  // Scan and DHCP after the fast join failed
+} wifi_join_t;
+
+/**
+ * Starts joining the network without waiting for it, the fast path is used when a lease is cached.
+ */
+void wifiJoinStart();
+
+/**
+ * Drives the join, call it until it returns true. Falls back to a full join when the fast one takes too long and
+ * starts a full join over after WIFI_CONNECT_TIMEOUT. On the first poll that sees the connection the connect time is
+ * recorded and the cache is refreshed.
+ * @return True once connected.
+ */
+bool wifiJoinPoll();
+
+/**
+ * @return True if the current connection uses the cached static address rather than a DHCP lease.
+ */
+bool wifiJoinUsedCache();
+
+/**
+ * Drops the cache and starts a full join, for when the network is up but unusable over the cached address.
+ */
+void wifiJoinFallback(const char* reason);
+
+/**
+ * Serializes the last join, and records the lease expiry if the wall clock was set after the join:
+ * {"msg_type":"wifi","join":"fast","connect_ms":412,"channel":6,"rssi":-61,"lease_reuse":3,"lease_left_s":3120}
+ * @return The length written, 0 if the buffer was too small.
+ */
+size_t wifiJoinReport(char* buffer, size_t size);
+
+#endif //WIFIJOIN_H
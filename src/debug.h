@@ -5,9 +5,7 @@
 #ifndef DEBUG_H
 #define DEBUG_H
 
-#define PRINT_TIME() Serial.printf("%010lu - ", micros())
-#define PRINT_FUNCTION() Serial.print(__PRETTY_FUNCTION__); Serial.print(" - ")
-#define PRINT_HEADER() PRINT_TIME(); PRINT_FUNCTION()
-#define DEBUG_PRINT(...) PRINT_HEADER(); Serial.printf(__VA_ARGS__); Serial.println()
+// Logging moved to Log/Log.h (LOG_ERROR, LOG_WARN, LOG_INFO, LOG_DEBUG), this header is kept for its includers.
+#include "Log/Log.h"
 
 #endif //DEBUG_H
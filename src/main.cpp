@@ -4,6 +4,9 @@
 #include <Devices/Radiator.h>
 
 #include "ControllerInterface/RoomInterface.h"
+#include "ControllerInterface/DeviceRegistry.h"
+#include "WifiJoin/WifiJoin.h"
+#include "Power/Power.h"
 // #include "Devices/Radiator.h"
 // #include <esp_system.h>
 #include <esp_task_wdt.h>
@@ -13,13 +16,19 @@
 // #include <esp32/rom/ets_sys.h>
 
 // #define DEBUG 0
+// #define STATIC_DEVICE_REGISTRY // Use the compile-time device registry instead of the runtime device list
 
-extern RoomInterface MainRoomInterface;
+RoomInterface roomInterface;
 
 Radiator* radiator;
 MotionDetector* motionDetector;
 EnvironmentSensor* environmentSensor;
 
+#ifdef STATIC_DEVICE_REGISTRY
+static constexpr char DEVICE_NAME[] = BUILD_GIT_BRANCH;
+StaticDeviceRegistry<DEVICE_NAME, Radiator, MotionDetector, EnvironmentSensor> deviceRegistry;
+#endif
+
 const char* task_state_to_string(const eTaskState state) {
     switch (state) {
         case eRunning: return "Running";
@@ -69,25 +78,17 @@ void current_time(char* buffer) {
     strftime(buffer, 80, "%m/%d/%Y %H:%M:%S", &timeinfo);
 }
 
-void connect_wifi() {
-    DEBUG_PRINT("Starting WiFi...");
+/**
+ * Starts connecting to WiFi without waiting for it, the network interface waits for the connection in its own task.
+ */
+void start_wifi() {
+    LOG_INFO("Starting WiFi...");
     WiFi.mode(WIFI_MODE_STA);  // Setup wifi to connect to an access point
-    WiFi.begin(WIFI_SSID, WIFI_PASSWORD); // Pass the SSID and Password to the WiFi.begin function
-    WiFi.setAutoReconnect(true); // Enable auto reconnect
     WiFi.setHostname("RoomDevice"); // Set the hostname of the device (doesn't seem to work)
-    DEBUG_PRINT("Wi-FI MAC Address: %s", WiFi.macAddress().c_str());
-    DEBUG_PRINT("Attempting to connect to WiFi SSID: \"%s\" with Password: \"%s\"", WIFI_SSID, WIFI_PASSWORD);
-    auto wifi_status = WiFi.waitForConnectResult();
-    if (wifi_status != WL_CONNECTED) {
-        DEBUG_PRINT("WiFi failed to connect [%s], attempting again...", wifi_status_to_string(static_cast<wl_status_t>(wifi_status)));
-        vTaskDelay(5000);
-        connect_wifi(); // Retry connecting to WiFi
-        return;
-    }
-    DEBUG_PRINT("WiFi connected [%s] with IP: %s",
-        wifi_status_to_string(static_cast<wl_status_t>(wifi_status)),
-        WiFi.localIP().toString().c_str());
-
+    wifiJoinStart(); // Cached AP and address when there is one, see WifiJoin.h
+    WiFi.setAutoReconnect(true); // Enable auto reconnect
+    LOG_INFO("Wi-FI MAC Address: %s", WiFi.macAddress().c_str());
+    LOG_INFO("Attempting to connect to WiFi SSID: \"%s\" with Password: \"%s\"", WIFI_SSID, WIFI_PASSWORD);
 }
 
 void check_partition_states() {
@@ -95,38 +96,48 @@ void check_partition_states() {
     const auto partition = esp_ota_get_running_partition();
     esp_ota_img_states_t ota_state = ESP_OTA_IMG_UNDEFINED;
     esp_ota_get_state_partition(partition, &ota_state);
-    DEBUG_PRINT("Running Partition: %s - State: %d (%s)",
+    LOG_INFO("Running Partition: %s - State: %d (%s)",
         partition->label, ota_state, ota_state_to_string(ota_state));
     const auto next_partition = esp_ota_get_next_update_partition(partition);
     esp_ota_get_state_partition(next_partition, &ota_state);
-    DEBUG_PRINT("Next Partition: %s - State: %d (%s)",
+    LOG_INFO("Next Partition: %s - State: %d (%s)",
         next_partition->label, ota_state, ota_state_to_string(ota_state));
 }
 
 void setup() {
+    bootMark(BOOT_SETUP);
     Serial.begin(115200); // Initialize serial communication at 115200 baud rate
+    logBegin();
+    powerBegin();
     const auto  partition = esp_ota_get_running_partition();
-    DEBUG_PRINT("Starting RoomDevice [%s] on %s - Partition: %s",
+    LOG_INFO("Starting RoomDevice [%s] on %s - Partition: %s",
         BUILD_VERSION, BUILD_GIT_BRANCH, partition->label);
     check_partition_states();
     esp_ota_mark_app_invalid_rollback_and_reboot();
     check_partition_states();
-    ledcSetup(LEDC_CHANNEL, LEDC_FREQUENCY_NO_WIFI, LEDC_TIMER);
-    ledcAttachPin(ACTIVITY_LED, LEDC_CHANNEL);
-    ledcWrite(LEDC_CHANNEL, 4096); // Turn off the activity LED initially
-    connect_wifi();
-    ledcDetachPin(ACTIVITY_LED); // Detach the LED pin after connecting to WiFi
-    // Set the time using the NTP protocol
-    configTime(0, 0, "time.mtu.edu", "pool.ntp.org", "time.nist.gov");
-    radiator = new Radiator();
-    motionDetector = new MotionDetector();
-    environmentSensor = new EnvironmentSensor();
+#ifdef STATIC_DEVICE_REGISTRY
+    roomInterface.setDeviceRegistry(&deviceRegistry);
+    deviceRegistry.construct(&roomInterface);
+    radiator = deviceRegistry.get<Radiator>();
+    motionDetector = deviceRegistry.get<MotionDetector>();
+    environmentSensor = deviceRegistry.get<EnvironmentSensor>();
+#else
+    radiator = new Radiator(&roomInterface);
+    motionDetector = new MotionDetector(&roomInterface);
+    environmentSensor = new EnvironmentSensor(&roomInterface);
+#endif
+    bootMark(BOOT_DEVICES_CREATED);
     // delay(1000);
-    DEBUG_PRINT("Starting up all Tasks...");
-    MainRoomInterface.begin(BUILD_GIT_BRANCH);
-    DEBUG_PRINT("Task startup complete.");
+    LOG_INFO("Starting up all Tasks...");
+    roomInterface.begin(BUILD_GIT_BRANCH);
+    LOG_INFO("Task startup complete.");
+    // The devices are already running, the network interface waits for WiFi in its own task
+    start_wifi();
+    // Set the time using the NTP protocol, SNTP syncs on its own once WiFi is up
+    configTime(0, 0, "time.mtu.edu", "pool.ntp.org", "time.nist.gov");
     esp_task_wdt_init(20, true);
-    DEBUG_PRINT("Remaining Free Heap: %d bytes", esp_get_free_heap_size());
+    LOG_INFO("Remaining Free Heap: %d bytes", esp_get_free_heap_size());
+    bootMark(BOOT_SETUP_DONE);
 }
 
 void loop() {